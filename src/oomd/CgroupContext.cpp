@@ -16,8 +16,10 @@
  */
 #include "oomd/CgroupContext.h"
 #include <unistd.h>
+#include <algorithm>
 
 #include "oomd/OomdContext.h"
+#include "oomd/util/ScopeGuard.h"
 
 namespace Oomd {
 
@@ -31,6 +33,13 @@ std::optional<CgroupContext> CgroupContext::make(
   return CgroupContext(ctx, cgroup, std::move(*fd));
 }
 
+CgroupContext CgroupContext::make(
+    OomdContext& ctx,
+    const CgroupPath& cgroup,
+    Fs::DirFd&& dirfd) {
+  return CgroupContext(ctx, cgroup, std::move(dirfd));
+}
+
 CgroupContext::CgroupContext(
     OomdContext& ctx,
     const CgroupPath& path,
@@ -50,13 +59,236 @@ std::optional<CgroupContext> CgroupContext::createChildCgroupCtx(
   return std::nullopt;
 }
 
+CgroupContext::~CgroupContext() {
+  for (int wd : {watch_.wd, watch_.parent_wd}) {
+    if (wd >= 0) {
+      ctx_.removeCgroupWatch(wd);
+    }
+  }
+  for (int wd : watch_.config_wds) {
+    if (wd >= 0) {
+      ctx_.removeCgroupWatch(wd);
+    }
+  }
+  closeControlFiles();
+}
+
 bool CgroupContext::refresh() {
-  archive_ = {
-      .average_usage = data_->average_usage,
-      .io_cost_cumulative = data_->io_cost_cumulative,
-      .pg_scan_cumulative = data_->pg_scan_cumulative};
-  *data_ = {};
-  return Fs::isCgroupValid(cgroup_dir_);
+  uint8_t events = 0;
+  if (watch_.wd >= 0) {
+    events |= ctx_.getCgroupEvents(watch_.wd);
+  }
+  if (watch_.parent_wd >= 0) {
+    events |= ctx_.getChildCgroupEvents(
+        watch_.parent_wd, cgroup_.name());
+  }
+  bool watched = ensureWatch();
+
+  CgroupData next;
+  auto keep = [&](auto CgroupData::*field) {
+    if (auto val = data_->get(*data_.*field)) {
+      next.set(next.*field, val);
+    }
+  };
+  // The dir fd never changes, neither does its inode
+  keep(&CgroupData::id);
+  // Configuration rarely changes. Keep it as long as it was read under a
+  // watch and no write was reported since.
+  if (!ctx_.isConfigRefresh()) {
+    auto keep_config = [&](auto CgroupData::*field, ControlFile file) {
+      int wd = watch_.config_wds[static_cast<size_t>(file)];
+      if (wd >= 0 && ctx_.isCgroupWatched(wd) &&
+          !(ctx_.getCgroupEvents(wd) & OomdContext::CGROUP_MODIFY)) {
+        keep(field);
+      }
+    };
+    keep_config(&CgroupData::memory_low, ControlFile::MEM_LOW);
+    keep_config(&CgroupData::memory_min, ControlFile::MEM_MIN);
+    keep_config(&CgroupData::memory_high, ControlFile::MEM_HIGH);
+    keep_config(&CgroupData::memory_max, ControlFile::MEM_MAX);
+    keep_config(&CgroupData::swap_max, ControlFile::MEM_SWAP_MAX);
+    keep_config(&CgroupData::oom_group, ControlFile::MEM_OOM_GROUP);
+    if (watched && !kill_preference_unwatched_ &&
+        !(events & OomdContext::CGROUP_ATTRIB)) {
+      keep(&CgroupData::kill_preference);
+    }
+  }
+  kill_preference_unwatched_ = false;
+  // Wide parents would otherwise be listed again every tick. Children
+  // created or removed since the listing are reported by the dir's watch.
+  bool keep_children = watched && !children_unwatched_ &&
+      !(events & OomdContext::CGROUP_CHILDREN) && !ctx_.isValiditySweep();
+  children_unwatched_ = false;
+
+  recordHistory();
+  archive_.average_usage = data_->get(data_->average_usage);
+  archive_.io_cost_cumulative = data_->get(data_->io_cost_cumulative);
+  archive_.pg_scan_cumulative = data_->get(data_->pg_scan_cumulative);
+  // Hand this interval's buffers, and the cold block itself, to the next one
+  // rather than freeing them
+  if (auto cold = std::move(data_->cold)) {
+    std::optional<std::vector<std::string>> children;
+    if (cold->children) {
+      if (keep_children) {
+        children = std::move(cold->children);
+      } else {
+        spare_.dirents.dirs = std::move(*cold->children);
+      }
+    }
+    if (cold->io_stat) {
+      spare_.io_stat = std::move(*cold->io_stat);
+    }
+    if (cold->io_cost_stat) {
+      spare_.io_cost_stat = std::move(*cold->io_cost_stat);
+    }
+    *cold = CgroupData::Cold{};
+    cold->children = std::move(children);
+    next.cold = std::move(cold);
+  }
+  *data_ = std::move(next);
+
+  // Removal is normally reported by the watch, so only touch the fs if there
+  // is none, it hinted at removal, or it's time for a sweep
+  if (!watched || !watch_.verified ||
+      (events & OomdContext::CGROUP_RECHECK) || ctx_.isValiditySweep()) {
+    if (!Fs::isCgroupValid(cgroup_dir_)) {
+      // Cached fds may still read from the removed cgroup, so drop them now
+      closeControlFiles();
+      return false;
+    }
+    watch_.verified = true;
+  }
+  return true;
+}
+
+const char* CgroupContext::controlFileName(ControlFile file) {
+  switch (file) {
+    case ControlFile::MEM_CURRENT:
+      return Fs::kMemCurrentFile;
+    case ControlFile::MEM_PRESSURE:
+      return Fs::kMemPressureFile;
+    case ControlFile::MEM_STAT:
+      return Fs::kMemStatFile;
+    case ControlFile::MEM_LOW:
+      return Fs::kMemLowFile;
+    case ControlFile::MEM_MIN:
+      return Fs::kMemMinFile;
+    case ControlFile::MEM_HIGH:
+      return Fs::kMemHighFile;
+    case ControlFile::MEM_HIGH_TMP:
+      return Fs::kMemHighTmpFile;
+    case ControlFile::MEM_MAX:
+      return Fs::kMemMaxFile;
+    case ControlFile::MEM_SWAP_CURRENT:
+      return Fs::kMemSwapCurrentFile;
+    case ControlFile::MEM_SWAP_MAX:
+      return Fs::kMemSwapMaxFile;
+    case ControlFile::MEM_OOM_GROUP:
+      return Fs::kMemOomGroupFile;
+    case ControlFile::IO_PRESSURE:
+      return Fs::kIoPressureFile;
+    case ControlFile::IO_STAT:
+      return Fs::kIoStatFile;
+    case ControlFile::CGROUP_STAT:
+      return Fs::kCgroupStatFile;
+    case ControlFile::CGROUP_EVENTS:
+      return Fs::kEventsFile;
+    case ControlFile::COUNT:
+      break;
+  }
+  __builtin_unreachable();
+}
+
+SystemMaybe<std::string_view> CgroupContext::readControlFile(
+    ControlFile file) const {
+  auto& cached = control_fds_[static_cast<size_t>(file)];
+  if (cached.fd() != -1) {
+    return Fs::readFileAt(cached);
+  }
+
+  auto fd = Fs::Fd::openat(cgroup_dir_, controlFileName(file));
+  if (!fd) {
+    return SYSTEM_ERROR(fd.error());
+  }
+  auto content = Fs::readFileAt(*fd);
+  // Keep the fd for next interval if we are still within budget, otherwise
+  // it's closed on return and we open it again next time.
+  if (content && ctx_.reserveControlFileFd()) {
+    cached = std::move(*fd);
+  }
+  return content;
+}
+
+template <typename Parse>
+auto CgroupContext::readControlFile(ControlFile file, Parse&& parse) const
+    -> decltype(parse(std::string_view())) {
+  auto content = readControlFile(file);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
+  }
+  return parse(*content);
+}
+
+template <typename Parse>
+auto CgroupContext::readConfigFile(ControlFile file, Parse&& parse) const
+    -> decltype(parse(std::string_view())) {
+  // Watch before reading so a concurrent write can't be missed. Without a
+  // watch, refresh() doesn't keep the value.
+  auto& wd = watch_.config_wds[static_cast<size_t>(file)];
+  if (wd >= 0 && !ctx_.isCgroupWatched(wd)) {
+    wd = -1;
+  }
+  // A failed add, eg. over the watch budget, is only retried once some watch
+  // was freed. Until then the file is simply re-read every tick.
+  auto& failed = watch_.config_failed[static_cast<size_t>(file)];
+  if (wd < 0 && failed != ctx_.getWatchesFreed()) {
+    wd = ctx_.addConfigWatch(cgroup_dir_, controlFileName(file));
+    failed = wd < 0 ? std::make_optional(ctx_.getWatchesFreed())
+                    : std::nullopt;
+  }
+  return readControlFile(file, std::forward<Parse>(parse));
+}
+
+bool CgroupContext::ensureWatch() const {
+  // Re-add watches the kernel dropped
+  if (watch_.wd >= 0 && !ctx_.isCgroupWatched(watch_.wd)) {
+    watch_.wd = -1;
+  }
+  if (watch_.parent_wd >= 0 && !ctx_.isCgroupWatched(watch_.parent_wd)) {
+    watch_.parent_wd = -1;
+  }
+  auto complete = [&]() {
+    return watch_.wd >= 0 && (watch_.parent_wd >= 0 || cgroup_.isRoot());
+  };
+  // The cgroup is polled meanwhile, so failed adds, eg. over the watch
+  // budget, are only retried on validity sweeps
+  if (complete() || (watch_.add_failed && !ctx_.isValiditySweep())) {
+    return complete();
+  }
+  if (watch_.wd < 0) {
+    watch_.wd = ctx_.addCgroupWatch(cgroup_dir_);
+    watch_.verified = false;
+  }
+  // Root cgroup can't be removed, so needs no parent watch
+  if (watch_.parent_wd < 0 && !cgroup_.isRoot()) {
+    watch_.parent_wd = ctx_.addCgroupWatch(cgroup_dir_, true);
+    watch_.verified = false;
+  }
+  watch_.add_failed = !complete();
+  return !watch_.add_failed;
+}
+
+void CgroupContext::closeControlFiles() {
+  size_t closed = 0;
+  for (auto& fd : control_fds_) {
+    if (fd.fd() != -1) {
+      fd = Fs::Fd();
+      closed++;
+    }
+  }
+  if (closed) {
+    ctx_.releaseControlFileFds(closed);
+  }
 }
 
 /*
@@ -91,55 +323,119 @@ void proxy(T val, S& field, CgroupContext::Error* err) {
     *err = CgroupContext::Error::INVALID_CGROUP;
   }
 }
-} // namespace
 
-#define __PROXY(field, expr, rettype)              \
-  rettype CgroupContext::field(Error* err) const { \
-    if (!data_->field) {                           \
-      proxy((expr), data_->field, err);            \
-    }                                              \
-    return data_->field;                           \
+template <typename T>
+std::optional<T> to_opt(SystemMaybe<T> maybe) {
+  if (maybe) {
+    return std::move(*maybe);
   }
+  return std::nullopt;
+}
+
+template <typename T>
+std::optional<T> to_opt(std::optional<T> opt) {
+  return opt;
+}
+} // namespace
 
 #define FIELD_TYPE(field) decltype(CgroupContext::CgroupData::field)
-#define PROXY(field, expr) __PROXY(field, expr, FIELD_TYPE(field))
-#define PROXY_CONST_REF(field, expr) \
-  __PROXY(field, expr, const FIELD_TYPE(field)&)
+
+#define PROXY_CONST_REF(field, expr)                                  \
+  const FIELD_TYPE(Cold::field) & CgroupContext::field(Error* err) \
+      const {                                                       \
+    auto& cold = data_->getCold();                                  \
+    if (!cold.field) {                                              \
+      proxy((expr), cold.field, err);                               \
+    }                                                               \
+    return cold.field;                                              \
+  }
 
 PROXY_CONST_REF(children, getChildren())
 PROXY_CONST_REF(mem_pressure, getMemPressure(Fs::PressureType::FULL))
 PROXY_CONST_REF(mem_pressure_some, getMemPressure(Fs::PressureType::SOME))
 PROXY_CONST_REF(io_pressure, getIoPressure(Fs::PressureType::FULL))
 PROXY_CONST_REF(io_pressure_some, getIoPressure(Fs::PressureType::SOME))
-PROXY_CONST_REF(memory_stat, Fs::getMemstatAt(cgroup_dir_))
-PROXY_CONST_REF(io_stat, Fs::readIostatAt(cgroup_dir_))
-PROXY(id, cgroup_dir_.inode())
-PROXY(current_usage, getMemcurrent())
-PROXY(swap_usage, Fs::readSwapCurrentAt(cgroup_dir_))
-PROXY(swap_max, Fs::readSwapMaxAt(cgroup_dir_))
-PROXY(memory_low, Fs::readMemlowAt(cgroup_dir_))
-PROXY(memory_min, Fs::readMemminAt(cgroup_dir_))
-PROXY(memory_high, Fs::readMemhighAt(cgroup_dir_))
-PROXY(memory_high_tmp, Fs::readMemhightmpAt(cgroup_dir_))
-PROXY(memory_max, Fs::readMemmaxAt(cgroup_dir_))
-PROXY(nr_dying_descendants, Fs::getNrDyingDescendantsAt(cgroup_dir_))
-PROXY(is_populated, Fs::readIsPopulatedAt(cgroup_dir_))
-PROXY(kill_preference, Fs::readKillPreferenceAt(cgroup_dir_))
-PROXY(oom_group, Fs::readMemoryOomGroupAt(cgroup_dir_))
-PROXY(effective_swap_max, getEffectiveSwapMax(err))
-PROXY(effective_swap_util_pct, getEffectiveSwapUtilPct(err))
-PROXY(effective_swap_free, getEffectiveSwapFree(err))
-PROXY(io_cost_cumulative, getIoCostCumulative(err))
-PROXY(pg_scan_cumulative, getPgScanCumulative(err))
-PROXY(memory_protection, getMemoryProtection(err))
-PROXY(io_cost_rate, getIoCostRate(err))
-PROXY(average_usage, getAverageUsage(err))
-PROXY(pg_scan_rate, getPgScanRate(err))
+PROXY_CONST_REF(mem_pressure_record, getMemPressureRecord())
+PROXY_CONST_REF(io_pressure_record, getIoPressureRecord())
+PROXY_CONST_REF(
+    memory_stat,
+    readControlFile(ControlFile::MEM_STAT, Fs::parseMemstat))
+PROXY_CONST_REF(io_stat, getIoStat())
+PROXY_CONST_REF(io_cost_stat, getIoCostStat())
+
+// Scalars remember a failed read too, so it isn't retried until refresh()
+#define PROXY(field, expr)                  \
+  case FIELD_TYPE(field)::kField:           \
+    data_->set(data_->field, to_opt(expr)); \
+    break;
+
+bool CgroupContext::fillScalar(CgroupData::Field which, Error* err) const {
+  if (!data_->known(which)) {
+    switch (which) {
+      PROXY(id, cgroup_dir_.inode())
+      PROXY(current_usage, getMemcurrent())
+      PROXY(
+          swap_usage,
+          readControlFile(ControlFile::MEM_SWAP_CURRENT, Fs::parseScalar))
+      PROXY(
+          swap_max,
+          readConfigFile(ControlFile::MEM_SWAP_MAX, Fs::parseMinMaxLowHigh))
+      PROXY(
+          memory_low,
+          readConfigFile(ControlFile::MEM_LOW, Fs::parseMinMaxLowHigh))
+      PROXY(
+          memory_min,
+          readConfigFile(ControlFile::MEM_MIN, Fs::parseMinMaxLowHigh))
+      PROXY(
+          memory_high,
+          readConfigFile(ControlFile::MEM_HIGH, Fs::parseMinMaxLowHigh))
+      PROXY(
+          memory_high_tmp,
+          readControlFile(ControlFile::MEM_HIGH_TMP, Fs::parseMemhightmp))
+      PROXY(
+          memory_max,
+          readConfigFile(ControlFile::MEM_MAX, Fs::parseMinMaxLowHigh))
+      PROXY(
+          nr_dying_descendants,
+          readControlFile(
+              ControlFile::CGROUP_STAT, Fs::parseNrDyingDescendants))
+      PROXY(
+          is_populated,
+          readControlFile(ControlFile::CGROUP_EVENTS, Fs::parseIsPopulated))
+      PROXY(kill_preference, getKillPreference())
+      PROXY(
+          oom_group,
+          readConfigFile(ControlFile::MEM_OOM_GROUP, Fs::parseMemoryOomGroup))
+      PROXY(effective_swap_max, getEffectiveSwapMax(err))
+      PROXY(effective_swap_util_pct, getEffectiveSwapUtilPct(err))
+      PROXY(effective_swap_free, getEffectiveSwapFree(err))
+      PROXY(io_cost_cumulative, getIoCostCumulative(err))
+      PROXY(pg_scan_cumulative, getPgScanCumulative(err))
+      PROXY(memory_protection, getMemoryProtection(err))
+      PROXY(io_cost_rate, getIoCostRate(err))
+      PROXY(average_usage, getAverageUsage(err))
+      PROXY(pg_scan_rate, getPgScanRate(err))
+      // Only filled in by getChildrenProtection()
+      case CgroupData::CHILDREN_PROTECTION:
+      case CgroupData::COUNT:
+        break;
+    }
+  }
+  if (data_->has(which)) {
+    return true;
+  }
+  if (err) {
+    *err = Error::INVALID_CGROUP;
+  }
+  return false;
+}
+
+#undef PROXY
 
 std::optional<int64_t> CgroupContext::anon_usage(Error* err) const {
   if (const auto& stat = memory_stat(err)) {
-    if (auto anon = stat->find("anon"); anon != stat->end()) {
-      return anon->second;
+    if (auto anon = stat->get(MemoryStat::Key::ANON)) {
+      return *anon;
     } else if (err) {
       *err = Error::INVALID_CGROUP;
     }
@@ -172,41 +468,103 @@ std::optional<double> CgroupContext::memory_growth(Error* err) const {
 }
 
 std::vector<std::string> CgroupContext::getChildren() const {
-  auto dirents = Fs::readDirAt(fd(), Fs::DE_DIR);
-  if (!dirents) {
+  // Watch before listing so a concurrent mkdir or rmdir can't be missed
+  if (!ensureWatch()) {
+    children_unwatched_ = true;
+  }
+  auto& dirents = spare_.dirents;
+  if (!Fs::readDirAt(fd(), Fs::DE_DIR, dirents)) {
     return {};
   }
-  return dirents->dirs;
+  std::sort(dirents.dirs.begin(), dirents.dirs.end());
+  return std::move(dirents.dirs);
 }
 
-namespace {
-template <typename T>
-std::optional<T> to_opt(SystemMaybe<T> maybe) {
-  if (maybe) {
-    return std::move(*maybe);
+std::optional<KillPreference> CgroupContext::getKillPreference() const {
+  // Watch before reading so a concurrent xattr change can't be missed
+  if (!ensureWatch()) {
+    kill_preference_unwatched_ = true;
   }
-  return std::nullopt;
+  return to_opt(Fs::readKillPreferenceAt(cgroup_dir_));
+}
+
+std::optional<PressureRecord> CgroupContext::getMemPressureRecord() const {
+  if (cgroup_.isRoot()) {
+    if (const auto& snapshot = ctx_.getSystemContext().mem_pressure) {
+      return snapshot;
+    }
+    return to_opt(Fs::readRootMempressureRecord());
+  }
+  return to_opt(
+      readControlFile(ControlFile::MEM_PRESSURE, Fs::parsePressureRecord));
+}
+
+std::optional<PressureRecord> CgroupContext::getIoPressureRecord() const {
+  if (cgroup_.isRoot()) {
+    if (const auto& snapshot = ctx_.getSystemContext().io_pressure) {
+      return snapshot;
+    }
+    return to_opt(Fs::readRootIopressureRecord());
+  }
+  return to_opt(
+      readControlFile(ControlFile::IO_PRESSURE, Fs::parsePressureRecord));
 }
-} // namespace
 
 std::optional<ResourcePressure> CgroupContext::getMemPressure(
     Fs::PressureType type) const {
-  return to_opt(
-      cgroup_.isRoot() ? Fs::readRootMempressure(type)
-                       : Fs::readMempressureAt(cgroup_dir_, type));
+  const auto& record = mem_pressure_record();
+  if (!record) {
+    return std::nullopt;
+  }
+  return type == Fs::PressureType::SOME ? record->some : record->full;
 }
 
 std::optional<ResourcePressure> CgroupContext::getIoPressure(
     Fs::PressureType type) const {
-  return to_opt(
-      cgroup_.isRoot() ? Fs::readRootIopressure(type)
-                       : Fs::readIopressureAt(cgroup_dir_, type));
+  const auto& record = io_pressure_record();
+  if (!record) {
+    return std::nullopt;
+  }
+  return type == Fs::PressureType::SOME ? record->some : record->full;
+}
+
+std::optional<IOStat> CgroupContext::getIoStat() const {
+  auto& io_stat = spare_.io_stat;
+  auto ret = readControlFile(
+      ControlFile::IO_STAT, [&io_stat](std::string_view content) {
+        return Fs::parseIostat(content, io_stat);
+      });
+  if (!ret) {
+    return std::nullopt;
+  }
+  return std::move(io_stat);
+}
+
+std::optional<std::vector<BoundDeviceIOStat>> CgroupContext::getIoCostStat()
+    const {
+  auto& io_cost_stat = spare_.io_cost_stat;
+  auto ret = readControlFile(
+      ControlFile::IO_STAT, [&](std::string_view content) {
+        return Fs::parseIostatFor(
+            content, ctx_.getIoCostDevices(), io_cost_stat);
+      });
+  if (!ret) {
+    return std::nullopt;
+  }
+  return std::move(io_cost_stat);
 }
 
 std::optional<int64_t> CgroupContext::getMemcurrent() const {
-  return to_opt(
-      cgroup_.isRoot() ? Fs::readRootMemcurrent()
-                       : Fs::readMemcurrentAt(cgroup_dir_));
+  if (cgroup_.isRoot()) {
+    const auto& meminfo = ctx_.getSystemContext().meminfo;
+    auto total = meminfo.find("MemTotal");
+    auto free = meminfo.find("MemFree");
+    if (total != meminfo.end() && free != meminfo.end()) {
+      return total->second - free->second;
+    }
+    return to_opt(Fs::readRootMemcurrent());
+  }
+  return to_opt(readControlFile(ControlFile::MEM_CURRENT, Fs::parseScalar));
 }
 
 namespace {
@@ -244,113 +602,117 @@ std::optional<int64_t> normalizedProtection(
 } // namespace
 
 std::optional<int64_t> CgroupContext::getEffectiveSwapMax(Error* err) const {
-  if (cgroup_.isRoot()) {
-    return ctx_.getSystemContext().swaptotal;
-  }
-
-  auto parent_cgroup = cgroup_.getParent();
-  auto parent_ctx = ctx_.addToCacheAndGet(parent_cgroup);
-  if (!parent_ctx) {
-    if (err) {
-      *err = Error::INVALID_CGROUP;
-    }
-    return std::nullopt;
-  }
-
-  if (auto parent_effective_swap_max =
-          parent_ctx->get().effective_swap_max(err);
-      !parent_effective_swap_max) {
-    return std::nullopt;
-  } else if (auto self_swap_max = swap_max(err); !self_swap_max) {
-    return std::nullopt;
-  } else {
-    return std::min(*parent_effective_swap_max, *self_swap_max);
+  fillEffectiveSwap();
+  auto val = data_->get(data_->effective_swap_max);
+  if (!val && err) {
+    *err = Error::INVALID_CGROUP;
   }
+  return val;
 }
 
-// Looks up the hierarchy to determine which level has the lowest
-// swap free (max - usage) and returns that value. This is
-// useful for detecting or avoiding swap depletion. Value may be
-// negative.
 std::optional<int64_t> CgroupContext::getEffectiveSwapFree(Error* err) const {
-  if (cgroup_.isRoot()) {
-    const auto& sys = ctx_.getSystemContext();
-    return sys.swaptotal - sys.swapused;
-  }
-
-  auto swap_max_opt = swap_max(err);
-  if (!swap_max_opt) {
-    return std::nullopt;
+  fillEffectiveSwap();
+  auto val = data_->get(data_->effective_swap_free);
+  if (!val && err) {
+    *err = Error::INVALID_CGROUP;
   }
+  return val;
+}
 
-  auto swap_usage_opt = swap_usage(err);
-  if (!swap_usage_opt) {
-    return std::nullopt;
+std::optional<double> CgroupContext::getEffectiveSwapUtilPct(Error* err) const {
+  fillEffectiveSwap();
+  auto val = data_->get(data_->effective_swap_util_pct);
+  if (!val && err) {
+    *err = Error::INVALID_CGROUP;
   }
+  return val;
+}
 
-  auto local_free = *swap_max_opt - *swap_usage_opt;
-  auto parent_cgroup = cgroup_.getParent();
-  auto parent_ctx = ctx_.addToCacheAndGet(parent_cgroup);
-  if (!parent_ctx) {
-    if (err) {
-      *err = Error::INVALID_CGROUP;
+/*
+ * Effective swap values only depend on the parent's, so fill in every
+ * ancestor still missing them from the top down. Each cgroup is visited once
+ * per interval no matter how many descendants or which of the values are
+ * asked for.
+ */
+void CgroupContext::fillEffectiveSwap() const {
+  auto done = [](const CgroupContext& ctx) {
+    // All three values are set together
+    return ctx.data_->known(CgroupData::EFFECTIVE_SWAP_MAX);
+  };
+  std::vector<const CgroupContext*> chain;
+  const CgroupContext* cur = this;
+  while (cur && !done(*cur)) {
+    chain.push_back(cur);
+    if (cur->cgroup_.isRoot()) {
+      cur = nullptr;
+      break;
     }
-    return std::nullopt;
+    auto parent_ctx = ctx_.addParentToCacheAndGet(*cur);
+    cur = parent_ctx ? &parent_ctx->get() : nullptr;
   }
 
-  if (auto parent_effective_swap_free =
-          parent_ctx->get().effective_swap_free(err);
-      !parent_effective_swap_free) {
-    return std::nullopt;
-  } else {
-    return std::min(*parent_effective_swap_free, local_free);
+  // cur is now the closest ancestor already filled in, if any
+  const CgroupContext* parent = cur;
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    (*it)->setEffectiveSwap(parent);
+    parent = *it;
   }
 }
 
-// Looks up the hierarchy to determine which level has the highest
-// swap utilization (usage / max) and returns that value. This is
-// useful for detecting or avoiding swap depletion.
-std::optional<double> CgroupContext::getEffectiveSwapUtilPct(Error* err) const {
+// Looks up the hierarchy to determine which level has the lowest swap max,
+// the lowest swap free (max - usage, may be negative) and the highest swap
+// utilization (usage / max). This is useful for detecting or avoiding swap
+// depletion. @param parent is null if it couldn't be found.
+void CgroupContext::setEffectiveSwap(const CgroupContext* parent) const {
+  std::optional<int64_t> max;
+  std::optional<int64_t> free;
+  std::optional<double> util_pct;
+  // Whatever is missing is recorded as failed, so this runs once per interval
+  OOMD_SCOPE_EXIT {
+    data_->set(data_->effective_swap_max, max);
+    data_->set(data_->effective_swap_free, free);
+    data_->set(data_->effective_swap_util_pct, util_pct);
+  };
+
   if (cgroup_.isRoot()) {
     const auto& sys = ctx_.getSystemContext();
-    if (sys.swaptotal == 0) {
-      return 0;
+    max = sys.swaptotal;
+    free = sys.swaptotal - sys.swapused;
+    util_pct = sys.swaptotal == 0
+        ? 0
+        : static_cast<double>(sys.swapused) /
+            static_cast<double>(sys.swaptotal);
+    return;
+  }
+
+  const CgroupData* parent_data = parent ? parent->data_.get() : nullptr;
+  auto self_swap_max = swap_max();
+  if (!self_swap_max) {
+    return;
+  }
+  if (parent_data) {
+    if (auto parent_max = parent_data->get(parent_data->effective_swap_max)) {
+      max = std::min(*parent_max, *self_swap_max);
     }
-    return static_cast<double>(sys.swapused) /
-        static_cast<double>(sys.swaptotal);
-  }
-
-  auto swap_max_opt = swap_max(err);
-  if (!swap_max_opt) {
-    return std::nullopt;
   }
-
-  if (*swap_max_opt == 0) {
-    return 0;
+  // No swap to use means nothing is used either
+  if (*self_swap_max == 0) {
+    util_pct = 0;
   }
 
-  auto swap_usage_opt = swap_usage(err);
-  if (!swap_usage_opt) {
-    return std::nullopt;
+  auto self_swap_usage = swap_usage();
+  if (!self_swap_usage || !parent_data) {
+    return;
   }
-
-  auto local_util_pct =
-      static_cast<double>(*swap_usage_opt) / static_cast<double>(*swap_max_opt);
-  auto parent_cgroup = cgroup_.getParent();
-  auto parent_ctx = ctx_.addToCacheAndGet(parent_cgroup);
-  if (!parent_ctx) {
-    if (err) {
-      *err = Error::INVALID_CGROUP;
-    }
-    return std::nullopt;
+  if (auto parent_free = parent_data->get(parent_data->effective_swap_free)) {
+    free = std::min(*parent_free, *self_swap_max - *self_swap_usage);
   }
-
-  if (auto parent_effective_swap_util_pct =
-          parent_ctx->get().effective_swap_util_pct(err);
-      !parent_effective_swap_util_pct) {
-    return std::nullopt;
-  } else {
-    return std::max(*parent_effective_swap_util_pct, local_util_pct);
+  auto parent_util_pct = parent_data->get(parent_data->effective_swap_util_pct);
+  if (*self_swap_max != 0 && parent_util_pct) {
+    util_pct = std::max(
+        *parent_util_pct,
+        static_cast<double>(*self_swap_usage) /
+            static_cast<double>(*self_swap_max));
   }
 }
 
@@ -373,12 +735,11 @@ std::optional<int64_t> CgroupContext::getMemoryProtection(Error* err) const {
     return current_usage(err);
   }
 
-  auto parent_cgroup = cgroup_.getParent();
-  if (parent_cgroup.isRoot()) {
+  if (cgroup_.depth() == 1) {
     // We're at a top level cgroup where P(cgrp) == R(cgrp)
     return rawProtection(*this, err);
   }
-  auto parent_ctx = ctx_.addToCacheAndGet(parent_cgroup);
+  auto parent_ctx = ctx_.addParentToCacheAndGet(*this);
   if (!parent_ctx) {
     if (err) {
       *err = Error::INVALID_CGROUP;
@@ -386,46 +747,55 @@ std::optional<int64_t> CgroupContext::getMemoryProtection(Error* err) const {
     return std::nullopt;
   }
 
-  std::unordered_set<CgroupPath> sibling_cgroups;
-  std::vector<OomdContext::ConstCgroupContextRef> siblings;
-  if (auto children = parent_ctx->get().children(err)) {
-    for (const auto& name : *children) {
-      sibling_cgroups.insert(parent_cgroup.getChild(name));
-    }
-    siblings = ctx_.addToCacheAndGet(sibling_cgroups);
-  } else {
+  auto protection_sum = parent_ctx->get().getChildrenProtection(err);
+  if (!protection_sum) {
+    return std::nullopt;
+  }
+  return normalizedProtection(*this, *parent_ctx, *protection_sum, err);
+}
+
+/*
+ * Sum of R(child) for each child, computed once per interval. Siblings tend
+ * to be ranked together, so P(child) of all of them is filled in while at it,
+ * making a whole level one pass instead of one pass per sibling.
+ */
+std::optional<int64_t> CgroupContext::getChildrenProtection(Error* err) const {
+  if (auto protection_sum = data_->get(data_->children_protection)) {
+    return protection_sum;
+  }
+  if (!children(err)) {
     return std::nullopt;
   }
+  auto children_ctx = ctx_.addChildrenToCacheAndGet(*this);
 
   int64_t protection_sum = 0;
-  for (auto sibling_ctx : siblings) {
-    protection_sum += rawProtection(sibling_ctx).value_or(0);
+  for (const CgroupContext& child_ctx : children_ctx) {
+    protection_sum += rawProtection(child_ctx).value_or(0);
+  }
+  data_->set(data_->children_protection, protection_sum);
+  for (const CgroupContext& child_ctx : children_ctx) {
+    auto& child_data = *child_ctx.data_;
+    if (child_data.known(CgroupData::MEMORY_PROTECTION)) {
+      continue;
+    }
+    // Left unset on error, so the child's own accessor reports it
+    if (auto protection =
+            normalizedProtection(child_ctx, *this, protection_sum)) {
+      child_data.set(child_data.memory_protection, protection);
+    }
   }
-  return normalizedProtection(*this, *parent_ctx, protection_sum, err);
+  return protection_sum;
 }
 
 std::optional<double> CgroupContext::getIoCostCumulative(Error* err) const {
-  if (!io_stat(err)) {
+  const auto& io_cost_stat = this->io_cost_stat(err);
+  if (!io_cost_stat) {
     return std::nullopt;
   }
-  const auto& params = ctx_.getParams();
   double cost = 0.0;
-  // calculate the sum of cumulative io cost on all devices.
-  for (const auto& stat : *io_stat()) {
-    // only keep stats from devices we care
-    auto dev = params.io_devs.find(stat.dev_id);
-    if (dev == params.io_devs.end()) {
-      continue;
-    }
-    IOCostCoeffs coeffs;
-    switch (dev->second) {
-      case DeviceType::SSD:
-        coeffs = params.ssd_coeffs;
-        break;
-      case DeviceType::HDD:
-        coeffs = params.hdd_coeffs;
-        break;
-    }
+  // calculate the sum of cumulative io cost on all devices we care about.
+  for (const auto& stat : *io_cost_stat) {
+    const auto& coeffs = stat.coeffs;
     // Dot product between dev io stat and io cost coeffs. A more sensible way
     // is to do dot product between rate of change (bandwidth, iops) with
     // coeffs but since the coeffs are constant, we can calculate rate of
@@ -439,10 +809,9 @@ std::optional<double> CgroupContext::getIoCostCumulative(Error* err) const {
 
 std::optional<int64_t> CgroupContext::getPgScanCumulative(
     Error* err = nullptr) const {
-  static constexpr auto kPgScan = "pgscan";
   if (const auto& memstat = memory_stat(err)) {
-    if (auto pos = memstat->find(kPgScan); pos != memstat->end()) {
-      return std::make_optional(pos->second);
+    if (auto pgscan = memstat->get(MemoryStat::Key::PGSCAN)) {
+      return pgscan;
     } else {
       throw std::runtime_error("Bad memory.stat format: missing pgscan entry");
     }
@@ -475,4 +844,114 @@ std::optional<int64_t> CgroupContext::getPgScanRate(Error* err) const {
   return *pg_scan_cumulative() - *archive_.pg_scan_cumulative;
 }
 
+void CgroupContext::prefetch(uint16_t reads) const {
+  if (reads & PREFETCH_CURRENT_USAGE) {
+    current_usage();
+  }
+  if (reads & PREFETCH_SWAP_USAGE) {
+    swap_usage();
+  }
+  if (reads & PREFETCH_MEMORY_HIGH_TMP) {
+    memory_high_tmp();
+  }
+  if (reads & PREFETCH_NR_DYING_DESCENDANTS) {
+    nr_dying_descendants();
+  }
+  if (reads & PREFETCH_IS_POPULATED) {
+    is_populated();
+  }
+  if (reads & PREFETCH_MEMORY_STAT) {
+    memory_stat();
+  }
+  if (reads & PREFETCH_MEM_PRESSURE) {
+    mem_pressure_record();
+  }
+  if (reads & PREFETCH_IO_PRESSURE) {
+    io_pressure_record();
+  }
+  if (reads & PREFETCH_IO_STAT) {
+    io_stat();
+  }
+  if (reads & PREFETCH_IO_COST_STAT) {
+    io_cost_stat();
+  }
+}
+
+void CgroupContext::refreshPressure() {
+  if (!data_->cold) {
+    return;
+  }
+  auto& cold = *data_->cold;
+  if (cold.mem_pressure_record) {
+    cold.mem_pressure_record.reset();
+    cold.mem_pressure.reset();
+    cold.mem_pressure_some.reset();
+    mem_pressure_record();
+  }
+  if (cold.io_pressure_record) {
+    cold.io_pressure_record.reset();
+    cold.io_pressure.reset();
+    cold.io_pressure_some.reset();
+    io_pressure_record();
+  }
+}
+
+const SampleRing* CgroupContext::history(HistorySeries series) const {
+  if (!history_) {
+    return nullptr;
+  }
+  const auto& ring = (*history_)[static_cast<size_t>(series)];
+  return ring ? &*ring : nullptr;
+}
+
+void CgroupContext::recordHistory() {
+  const auto& params = ctx_.getParams();
+  if (params.history_samples <= 0) {
+    return;
+  }
+  auto tick = ctx_.getCurrentTick();
+  auto record = [&](HistorySeries series, auto value) {
+    if (!value) {
+      return;
+    }
+    if (!history_) {
+      history_ = std::make_unique<
+          std::array<std::optional<SampleRing>, kNumHistorySeries>>();
+    }
+    auto& ring = (*history_)[static_cast<size_t>(series)];
+    if (!ring) {
+      auto decay = params.average_size_decay;
+      ring.emplace(params.history_samples, (decay - 1) / decay);
+    }
+    ring->push(tick, *value);
+  };
+  auto pressure_total = [](const std::optional<PressureRecord>& record) {
+    return record && record->full.total
+        ? std::optional<double>(record->full.total->count())
+        : std::nullopt;
+  };
+
+  record(HistorySeries::CURRENT_USAGE, data_->get(data_->current_usage));
+  record(HistorySeries::SWAP_USAGE, data_->get(data_->swap_usage));
+  if (const auto& cold = data_->cold) {
+    if (cold->memory_stat) {
+      record(
+          HistorySeries::ANON_USAGE,
+          cold->memory_stat->get(MemoryStat::Key::ANON));
+    }
+    record(
+        HistorySeries::MEM_PRESSURE_TOTAL,
+        pressure_total(cold->mem_pressure_record));
+    record(
+        HistorySeries::IO_PRESSURE_TOTAL,
+        pressure_total(cold->io_pressure_record));
+  }
+  record(
+      HistorySeries::PG_SCAN_CUMULATIVE,
+      data_->get(data_->pg_scan_cumulative));
+  record(
+      HistorySeries::IO_COST_CUMULATIVE,
+      data_->get(data_->io_cost_cumulative));
+}
+
 } // namespace Oomd
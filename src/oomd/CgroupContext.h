@@ -17,17 +17,69 @@
 
 #pragma once
 
+#include <array>
 #include <deque>
 #include <memory>
 #include <optional>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "oomd/include/CgroupPath.h"
+#include "oomd/include/MemoryStat.h"
+#include "oomd/include/SampleRing.h"
 #include "oomd/include/Types.h"
 #include "oomd/util/Fs.h"
 
 namespace Oomd {
 
+/*
+ * Fields of CgroupContext::CgroupData, for code that handles all of them
+ * alike, eg. TestHelper::CgroupData. SCALAR(type, name, FIELD) fields are
+ * stored unwrapped, in this order. Those ranking reads for every sibling come
+ * first and share a cache line, so mind their sizes. COLD(type, name) fields
+ * are kept out of line. Pass OOMD_CGROUP_SKIP to leave out either kind.
+ */
+#define OOMD_CGROUP_DATA_FIELDS(SCALAR, COLD)                               \
+  /* Hot */                                                                \
+  SCALAR(int64_t, current_usage, CURRENT_USAGE)                            \
+  SCALAR(int64_t, swap_usage, SWAP_USAGE)                                  \
+  SCALAR(KillPreference, kill_preference, KILL_PREFERENCE)                 \
+  SCALAR(bool, is_populated, IS_POPULATED)                                 \
+  SCALAR(bool, oom_group, OOM_GROUP)                                       \
+  SCALAR(int64_t, memory_protection, MEMORY_PROTECTION)                    \
+  SCALAR(int64_t, average_usage, AVERAGE_USAGE)                            \
+  SCALAR(int64_t, pg_scan_rate, PG_SCAN_RATE)                              \
+  SCALAR(double, io_cost_rate, IO_COST_RATE)                               \
+  /* Warm */                                                               \
+  SCALAR(CgroupContext::Id, id, ID)                                        \
+  SCALAR(int64_t, memory_low, MEMORY_LOW)                                  \
+  SCALAR(int64_t, memory_min, MEMORY_MIN)                                  \
+  SCALAR(int64_t, memory_high, MEMORY_HIGH)                                \
+  SCALAR(int64_t, memory_high_tmp, MEMORY_HIGH_TMP)                        \
+  SCALAR(int64_t, memory_max, MEMORY_MAX)                                  \
+  SCALAR(int64_t, swap_max, SWAP_MAX)                                      \
+  SCALAR(int64_t, nr_dying_descendants, NR_DYING_DESCENDANTS)              \
+  SCALAR(int64_t, effective_swap_max, EFFECTIVE_SWAP_MAX)                  \
+  SCALAR(int64_t, effective_swap_free, EFFECTIVE_SWAP_FREE)                \
+  SCALAR(double, effective_swap_util_pct, EFFECTIVE_SWAP_UTIL_PCT)         \
+  /* Sum of children's raw memory protection */                            \
+  SCALAR(int64_t, children_protection, CHILDREN_PROTECTION)                \
+  SCALAR(double, io_cost_cumulative, IO_COST_CUMULATIVE)                   \
+  SCALAR(int64_t, pg_scan_cumulative, PG_SCAN_CUMULATIVE)                  \
+  /* Cold */                                                               \
+  COLD(ResourcePressure, mem_pressure)                                     \
+  COLD(ResourcePressure, mem_pressure_some)                                \
+  COLD(ResourcePressure, io_pressure)                                      \
+  COLD(ResourcePressure, io_pressure_some)                                 \
+  COLD(PressureRecord, mem_pressure_record)                                \
+  COLD(PressureRecord, io_pressure_record)                                 \
+  COLD(std::vector<std::string>, children)                                 \
+  COLD(IOStat, io_stat)                                                    \
+  COLD(std::vector<BoundDeviceIOStat>, io_cost_stat)                       \
+  COLD(MemoryStat, memory_stat)
+#define OOMD_CGROUP_SKIP(...)
+
 class OomdContext;
 /*
  * Storage class for cgroup states. Data are retrieved from cgroupfs on access
@@ -56,12 +108,18 @@ class CgroupContext {
   static std::optional<CgroupContext> make(
       OomdContext& ctx,
       const CgroupPath& cgroup);
+  // Like above, but adopts @param dirfd, already opened on @param cgroup
+  static CgroupContext
+  make(OomdContext& ctx, const CgroupPath& cgroup, Fs::DirFd&& dirfd);
 
   /*
    * To get children of a cgroup, use OomdContext::addChildrenToCacheAndGet.
    * This method is dangerous to use directly because the CgroupContext it
    * returns is not yet in any OomdContext cache.
    */
+  CgroupContext(CgroupContext&& other) noexcept = default;
+  ~CgroupContext();
+
   std::optional<CgroupContext> createChildCgroupCtx(
       const std::string& child_name) const;
 
@@ -95,7 +153,7 @@ class CgroupContext {
   // returned and err set to corresponding error enum if it's not nullptr.
   // Otherwise, err will stay the same and an optional with value returned.
 
-  // Names of child cgroups (not full path)
+  // Names of child cgroups (not full path), sorted
   const std::optional<std::vector<std::string>>& children(
       Error* err = nullptr) const;
   const std::optional<ResourcePressure>& mem_pressure(
@@ -106,12 +164,22 @@ class CgroupContext {
       Error* err = nullptr) const;
   const std::optional<ResourcePressure>& io_pressure_some(
       Error* err = nullptr) const;
-  const std::optional<std::unordered_map<std::string, int64_t>>& memory_stat(
+  // Both halves of memory.pressure / io.pressure from a single read. The
+  // accessors above are views into these.
+  const std::optional<PressureRecord>& mem_pressure_record(
+      Error* err = nullptr) const;
+  const std::optional<PressureRecord>& io_pressure_record(
       Error* err = nullptr) const;
+  const std::optional<MemoryStat>& memory_stat(Error* err = nullptr) const;
   const std::optional<IOStat>& io_stat(Error* err = nullptr) const;
+  // io.stat of only the devices in OomdContext::getIoCostDevices()
+  const std::optional<std::vector<BoundDeviceIOStat>>& io_cost_stat(
+      Error* err = nullptr) const;
   std::optional<Id> id(Error* err = nullptr) const;
   std::optional<int64_t> current_usage(Error* err = nullptr) const;
   std::optional<int64_t> swap_usage(Error* err = nullptr) const;
+  // swap_max, memory_{low,min,high,max}, oom_group and kill_preference are
+  // kept across intervals until inotify reports a change to them
   std::optional<int64_t> swap_max(Error* err = nullptr) const;
   std::optional<int64_t> memory_low(Error* err = nullptr) const;
   std::optional<int64_t> memory_min(Error* err = nullptr) const;
@@ -156,6 +224,54 @@ class CgroupContext {
   // if you use memory_growth() you must in prerun load average_usage()
   std::optional<double> memory_growth(Error* err = nullptr) const;
 
+  // Counters kept in history()
+  enum class HistorySeries : uint8_t {
+    CURRENT_USAGE = 0,
+    ANON_USAGE,
+    SWAP_USAGE,
+    // Totals of the full lines of memory.pressure and io.pressure, in usecs
+    MEM_PRESSURE_TOTAL,
+    IO_PRESSURE_TOTAL,
+    PG_SCAN_CUMULATIVE,
+    IO_COST_CUMULATIVE,
+    COUNT, // Must be last
+  };
+  static constexpr size_t kNumHistorySeries =
+      static_cast<size_t>(HistorySeries::COUNT);
+
+  /*
+   * Reads OomdContext::prefetch() may do ahead of use, off the main thread.
+   * They only read files of the cgroup itself that change every interval.
+   * Configuration is left out, as it's mostly kept across intervals and
+   * reading it sets up inotify watches in OomdContext. Derived fields are
+   * computed from these on first use, some of them from relatives' data, so
+   * are left to the main thread too.
+   */
+  enum PrefetchRead : uint16_t {
+    PREFETCH_CURRENT_USAGE = 1 << 0,
+    PREFETCH_SWAP_USAGE = 1 << 1,
+    PREFETCH_MEMORY_HIGH_TMP = 1 << 2,
+    PREFETCH_NR_DYING_DESCENDANTS = 1 << 3,
+    PREFETCH_IS_POPULATED = 1 << 4,
+    // Also covers anon_usage() and pg_scan_cumulative()
+    PREFETCH_MEMORY_STAT = 1 << 5,
+    PREFETCH_MEM_PRESSURE = 1 << 6,
+    PREFETCH_IO_PRESSURE = 1 << 7,
+    PREFETCH_IO_STAT = 1 << 8,
+    // Also covers io_cost_cumulative()
+    PREFETCH_IO_COST_STAT = 1 << 9,
+  };
+
+  /*
+   * Samples of @param series from earlier intervals, tagged with their tick,
+   * or nullptr if there are none.
+   *
+   * refresh() records whichever of these was read during the interval that
+   * just ended, so history only covers what plugins asked for. At most
+   * ContextParams::history_samples are kept; 0 disables history.
+   */
+  const SampleRing* history(HistorySeries series) const;
+
  private:
   explicit CgroupContext(
       OomdContext& ctx,
@@ -164,54 +280,183 @@ class CgroupContext {
 
   // Test only
   friend class TestHelper;
+  // Maintains tree_
+  friend class OomdContext;
+
+  // Control files read every interval. Their fds are kept open across
+  // intervals as long as OomdContext's fd budget allows, and re-read with
+  // pread() at offset 0.
+  enum class ControlFile {
+    MEM_CURRENT = 0,
+    MEM_PRESSURE,
+    MEM_STAT,
+    MEM_LOW,
+    MEM_MIN,
+    MEM_HIGH,
+    MEM_HIGH_TMP,
+    MEM_MAX,
+    MEM_SWAP_CURRENT,
+    MEM_SWAP_MAX,
+    MEM_OOM_GROUP,
+    IO_PRESSURE,
+    IO_STAT,
+    CGROUP_STAT,
+    CGROUP_EVENTS,
+    COUNT,
+  };
+
+  static const char* controlFileName(ControlFile file);
+  // Read a control file through the fd cache. The returned view is only valid
+  // until the next read, see Fs::readFileAt().
+  SystemMaybe<std::string_view> readControlFile(ControlFile file) const;
+  template <typename Parse>
+  auto readControlFile(ControlFile file, Parse&& parse) const
+      -> decltype(parse(std::string_view()));
+  // Same as readControlFile(), for files kept across intervals
+  template <typename Parse>
+  auto readConfigFile(ControlFile file, Parse&& parse) const
+      -> decltype(parse(std::string_view()));
+  void closeControlFiles();
 
   std::vector<std::string> getChildren() const;
+  std::optional<KillPreference> getKillPreference() const;
+  std::optional<PressureRecord> getMemPressureRecord() const;
+  std::optional<PressureRecord> getIoPressureRecord() const;
   std::optional<ResourcePressure> getMemPressure(Fs::PressureType type) const;
   std::optional<ResourcePressure> getIoPressure(Fs::PressureType type) const;
+  std::optional<IOStat> getIoStat() const;
+  std::optional<std::vector<BoundDeviceIOStat>> getIoCostStat() const;
   std::optional<int64_t> getMemcurrent() const;
   std::optional<int64_t> getEffectiveSwapMax(Error* err) const;
   std::optional<int64_t> getEffectiveSwapFree(Error* err) const;
   std::optional<double> getEffectiveSwapUtilPct(Error* err) const;
+  void fillEffectiveSwap() const;
+  void setEffectiveSwap(const CgroupContext* parent) const;
   std::optional<int64_t> getMemoryProtection(Error* err) const;
+  std::optional<int64_t> getChildrenProtection(Error* err) const;
   std::optional<double> getIoCostCumulative(Error* err) const;
   std::optional<int64_t> getPgScanCumulative(Error* err) const;
   std::optional<int64_t> getAverageUsage(Error* err) const;
   std::optional<double> getIoCostRate(Error* err) const;
   std::optional<int64_t> getPgScanRate(Error* err) const;
+  // Appends what was read this interval to history_
+  void recordHistory();
+  // Re-reads the pressure records read so far this interval
+  void refreshPressure();
 
-  struct CgroupData {
-    std::optional<std::vector<std::string>> children;
-    std::optional<ResourcePressure> mem_pressure;
-    std::optional<ResourcePressure> mem_pressure_some;
-    std::optional<ResourcePressure> io_pressure;
-    std::optional<ResourcePressure> io_pressure_some;
-    std::optional<std::unordered_map<std::string, int64_t>> memory_stat;
-    std::optional<IOStat> io_stat;
-    std::optional<Id> id;
-    std::optional<int64_t> current_usage;
-    std::optional<int64_t> swap_usage;
-    std::optional<int64_t> memory_low;
-    std::optional<int64_t> memory_min;
-    std::optional<int64_t> memory_high;
-    std::optional<int64_t> memory_high_tmp;
-    std::optional<int64_t> memory_max;
-    std::optional<int64_t> nr_dying_descendants;
-    std::optional<bool> is_populated;
-    std::optional<KillPreference> kill_preference;
-    std::optional<bool> oom_group;
-    std::optional<int64_t> swap_max;
-    // Cached derived data
-    std::optional<int64_t> effective_swap_max;
-    std::optional<int64_t> effective_swap_free;
-    std::optional<double> effective_swap_util_pct;
-    std::optional<int64_t> memory_protection;
-    std::optional<double> io_cost_cumulative;
-    std::optional<int64_t> pg_scan_cumulative;
-    // Temporal counters
-    std::optional<int64_t> average_usage;
-    std::optional<double> io_cost_rate;
-    std::optional<int64_t> pg_scan_rate;
+  /*
+   * Does @param reads, PrefetchRead bits, ahead of use. Touches no state but
+   * this context's, so distinct contexts may be prefetched concurrently.
+   */
+  void prefetch(uint16_t reads) const;
+
+  /*
+   * Scalars are stored unwrapped, with whether each was read (or failed to
+   * be) kept in two masks. Cold fields are returned by reference, so they're
+   * kept as optionals, in a block allocated on first use. Most cgroups only
+   * ever have scalars read.
+   */
+  struct alignas(64) CgroupData {
+#define OOMD_CGROUP_FIELD_ENUM(type, name, field) field,
+    enum Field : uint8_t {
+      OOMD_CGROUP_DATA_FIELDS(OOMD_CGROUP_FIELD_ENUM, OOMD_CGROUP_SKIP)
+      COUNT, // Must be last
+    };
+#undef OOMD_CGROUP_FIELD_ENUM
+    static_assert(COUNT <= 32, "Fields are tracked in 32 bit masks");
+
+    template <typename T, Field F>
+    struct Scalar {
+      using value_type = T;
+      static constexpr Field kField = F;
+      T value{};
+    };
+
+#define OOMD_CGROUP_COLD_FIELD(type, name) std::optional<type> name;
+    struct Cold {
+      OOMD_CGROUP_DATA_FIELDS(OOMD_CGROUP_SKIP, OOMD_CGROUP_COLD_FIELD)
+    };
+#undef OOMD_CGROUP_COLD_FIELD
+
+    bool has(Field field) const {
+      return present & (uint32_t{1} << field);
+    }
+    // Whether @param field was read, successfully or not
+    bool known(Field field) const {
+      return (present | failed) & (uint32_t{1} << field);
+    }
+    template <typename T, Field F>
+    std::optional<T> get(const Scalar<T, F>& field) const {
+      if (has(F)) {
+        return field.value;
+      }
+      return std::nullopt;
+    }
+    // Stores @param value, or records the read failed if there is none
+    template <typename T, Field F>
+    void set(
+        Scalar<T, F>& field,
+        const std::optional<typename Scalar<T, F>::value_type>& value) {
+      if (value) {
+        field.value = *value;
+        present |= uint32_t{1} << F;
+        failed &= ~(uint32_t{1} << F);
+      } else {
+        present &= ~(uint32_t{1} << F);
+        failed |= uint32_t{1} << F;
+      }
+    }
+    Cold& getCold() {
+      if (!cold) {
+        cold = std::make_unique<Cold>();
+      }
+      return *cold;
+    }
+
+    uint32_t present{0};
+    uint32_t failed{0};
+#define OOMD_CGROUP_SCALAR_FIELD(type, name, field) Scalar<type, field> name;
+    OOMD_CGROUP_DATA_FIELDS(OOMD_CGROUP_SCALAR_FIELD, OOMD_CGROUP_SKIP)
+#undef OOMD_CGROUP_SCALAR_FIELD
+    std::unique_ptr<Cold> cold;
+  };
+
+  // Slow path of the scalar accessors: reads @param field unless already
+  // tried this interval. Returns whether it has a value.
+  bool fillScalar(CgroupData::Field field, Error* err) const;
+
+  // inotify watches on cgroup_dir_, its parent and its config files, see
+  // OomdContext::addCgroupWatch(). Move-only so a moved-from context doesn't
+  // drop the watches of the one it moved into.
+  struct CgroupWatch {
+    CgroupWatch() {
+      config_wds.fill(-1);
+    }
+    CgroupWatch(CgroupWatch&& other) noexcept
+        : wd(std::exchange(other.wd, -1)),
+          parent_wd(std::exchange(other.parent_wd, -1)),
+          config_wds(other.config_wds),
+          config_failed(other.config_failed),
+          verified(other.verified),
+          add_failed(other.add_failed) {
+      other.config_wds.fill(-1);
+    }
+    CgroupWatch& operator=(CgroupWatch&& other) = delete;
+
+    int wd{-1};
+    int parent_wd{-1};
+    // Added by readConfigFile() before the first read of each file
+    std::array<int, static_cast<size_t>(ControlFile::COUNT)> config_wds;
+    // OomdContext::getWatchesFreed() when adding the config watch failed
+    std::array<std::optional<uint64_t>, static_cast<size_t>(ControlFile::COUNT)>
+        config_failed;
+    // Whether the cgroup was checked to be valid since the watches were added
+    bool verified{false};
+    // Whether adding wd or parent_wd failed last time it was tried
+    bool add_failed{false};
   };
+  // Returns false if the cgroup can't be watched
+  bool ensureWatch() const;
 
   // Data required to calculate temporal counters
   struct CgroupArchivedData {
@@ -227,9 +472,86 @@ class CgroupContext {
   // We check validity in refresh(). If invalid, the dir fd will be closed and
   // OomdContext will remove this CgroupContext.
   Fs::DirFd cgroup_dir_;
+  // Lazily opened fds of control files, indexed by ControlFile
+  mutable std::array<Fs::Fd, static_cast<size_t>(ControlFile::COUNT)>
+      control_fds_;
   std::unique_ptr<CgroupData> data_;
+  mutable CgroupWatch watch_;
+  // Set if the kill preference was read without a watch, so it can't be kept
+  // past this interval
+  mutable bool kill_preference_unwatched_{false};
+  // Same for the listing of children
+  mutable bool children_unwatched_{false};
 
   CgroupArchivedData archive_{};
+
+  // Containers of an earlier interval, kept so the next listing or io.stat
+  // can be read into them instead of freshly allocated ones
+  struct SpareData {
+    Fs::DirEnts dirents;
+    IOStat io_stat;
+    std::vector<BoundDeviceIOStat> io_cost_stat;
+  };
+  mutable SpareData spare_;
+
+  // Allocated on the first sample, indexed by HistorySeries
+  std::unique_ptr<std::array<std::optional<SampleRing>, kNumHistorySeries>>
+      history_;
+
+  // Position in OomdContext's cgroup cache. Links are only set while both
+  // ends are cached, so a missing parent just hasn't been looked up yet.
+  struct TreeLinks {
+    // Whether this is the instance owned by the cache
+    bool cached{false};
+    const CgroupContext* parent{nullptr};
+    // Cached children, sorted by name
+    std::vector<const CgroupContext*> children;
+    // Key in OomdContext's index by id
+    std::optional<Id> id;
+    // Tick of the last OomdContext lookup that returned this context
+    uint64_t last_access{0};
+  };
+  mutable TreeLinks tree_;
 };
 
+/*
+ * Scalar accessors are defined here so the common case, a field already read
+ * this interval, is inlined into ranking loops.
+ */
+#define OOMD_CGROUP_SCALAR(field)                                       \
+  inline std::optional<                                                 \
+      decltype(CgroupContext::CgroupData::field)::value_type>           \
+  CgroupContext::field(Error* err) const {                              \
+    if (!data_->has(data_->field.kField) &&                             \
+        !fillScalar(data_->field.kField, err)) {                        \
+      return std::nullopt;                                              \
+    }                                                                   \
+    return data_->field.value;                                          \
+  }
+
+OOMD_CGROUP_SCALAR(id)
+OOMD_CGROUP_SCALAR(current_usage)
+OOMD_CGROUP_SCALAR(swap_usage)
+OOMD_CGROUP_SCALAR(swap_max)
+OOMD_CGROUP_SCALAR(memory_low)
+OOMD_CGROUP_SCALAR(memory_min)
+OOMD_CGROUP_SCALAR(memory_high)
+OOMD_CGROUP_SCALAR(memory_high_tmp)
+OOMD_CGROUP_SCALAR(memory_max)
+OOMD_CGROUP_SCALAR(nr_dying_descendants)
+OOMD_CGROUP_SCALAR(is_populated)
+OOMD_CGROUP_SCALAR(kill_preference)
+OOMD_CGROUP_SCALAR(oom_group)
+OOMD_CGROUP_SCALAR(effective_swap_max)
+OOMD_CGROUP_SCALAR(effective_swap_free)
+OOMD_CGROUP_SCALAR(effective_swap_util_pct)
+OOMD_CGROUP_SCALAR(memory_protection)
+OOMD_CGROUP_SCALAR(io_cost_cumulative)
+OOMD_CGROUP_SCALAR(pg_scan_cumulative)
+OOMD_CGROUP_SCALAR(average_usage)
+OOMD_CGROUP_SCALAR(io_cost_rate)
+OOMD_CGROUP_SCALAR(pg_scan_rate)
+
+#undef OOMD_CGROUP_SCALAR
+
 } // namespace Oomd
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "oomd/CgroupContext.h"
+#include "oomd/CgroupSnapshot.h"
+#include "oomd/OomdContext.h"
+#include "oomd/util/Fixture.h"
+#include "oomd/util/TestHelper.h"
+
+using namespace Oomd;
+
+namespace {
+
+/*
+ * Per cgroup memory of the cache, excluding the path and anything the
+ * containers of CgroupData point to.
+ */
+void BM_CgroupFootprint(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sizeof(CgroupContext));
+  }
+  state.counters["context_bytes"] = sizeof(CgroupContext);
+  state.counters["data_bytes"] = TestHelper::kCgroupDataBytes;
+}
+
+/*
+ * Ranks state.range(0) siblings the way KillMemoryGrowth does, ie. by kill
+ * preference, then effective usage and growth. Data is injected so only the
+ * accessors are measured.
+ */
+std::vector<OomdContext::ConstCgroupContextRef>
+makeSiblings(OomdContext& ctx, const std::string& root, int64_t count) {
+  std::vector<OomdContext::ConstCgroupContextRef> cgroups;
+  for (int64_t i = 0; i < count; ++i) {
+    auto name = "cg" + std::to_string(i);
+    Fixture::mkdirsChecked(name, root);
+    CgroupPath path(root, name);
+    // Spread values so the sort has real work to do
+    int64_t usage = ((i * 7919) % 1000 + 1) << 20;
+    TestHelper::setCgroupData(
+        ctx,
+        path,
+        TestHelper::CgroupData{
+            .current_usage = usage,
+            .kill_preference = i % 16 ? KillPreference::NORMAL
+                                      : KillPreference::PREFER,
+            .memory_protection = usage / 4,
+            .average_usage = usage - (i % 3) * (1 << 20)});
+    cgroups.push_back(*ctx.addToCacheAndGet(path));
+  }
+  return cgroups;
+}
+
+/*
+ * Ranks state.range(0) siblings the way KillMemoryGrowth used to, ie. by kill
+ * preference, then effective usage and growth pulled through the accessors
+ * from inside the comparator. Data is injected so only the accessors are
+ * measured.
+ */
+void BM_RankSiblings(benchmark::State& state) {
+  auto root = Fixture::mkdtempChecked();
+  OomdContext ctx;
+  auto cgroups = makeSiblings(ctx, root, state.range(0));
+
+  for (auto _ : state) {
+    auto ranked = OomdContext::sortDescWithKillPrefs(
+        cgroups, [](const CgroupContext& cgroup_ctx) {
+          return std::make_tuple(
+              cgroup_ctx.effective_usage().value_or(0),
+              cgroup_ctx.memory_growth().value_or(0));
+        });
+    benchmark::DoNotOptimize(ranked.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  Fixture::rmrChecked(root);
+}
+
+/*
+ * Same ranking as BM_RankSiblings, through a CgroupSnapshot.
+ */
+void BM_RankSiblingsSnapshot(benchmark::State& state) {
+  auto root = Fixture::mkdtempChecked();
+  OomdContext ctx;
+  auto cgroups = makeSiblings(ctx, root, state.range(0));
+
+  for (auto _ : state) {
+    CgroupSnapshot snapshot(
+        cgroups,
+        CgroupSnapshot::EFFECTIVE_USAGE | CgroupSnapshot::MEMORY_GROWTH);
+    std::vector<std::tuple<int64_t, double>> keys(snapshot.size());
+    for (size_t i = 0; i < snapshot.size(); ++i) {
+      keys[i] = {snapshot.effective_usage[i], snapshot.memory_growth[i]};
+    }
+    auto ranked = snapshot.sortDescWithKillPrefs(snapshot.rows(), keys);
+    benchmark::DoNotOptimize(ranked.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  Fixture::rmrChecked(root);
+}
+
+} // namespace
+
+BENCHMARK(BM_CgroupFootprint);
+BENCHMARK(BM_RankSiblings)->RangeMultiplier(8)->Range(64, 4096);
+BENCHMARK(BM_RankSiblingsSnapshot)->RangeMultiplier(8)->Range(64, 4096);
+
+BENCHMARK_MAIN();
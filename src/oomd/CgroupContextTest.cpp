@@ -17,6 +17,8 @@
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <fstream>
+#include <functional>
 
 #include "oomd/CgroupContext.h"
 #include "oomd/Log.h"
@@ -184,6 +186,52 @@ TEST_F(CgroupContextTest, MemoryProtection) {
   cgroup_ctx = ctx_.addToCacheAndGet(CgroupPath(tempDir_, "A/E/G"));
   ASSERT_TRUE(cgroup_ctx);
   EXPECT_EQ(cgroup_ctx->get().memory_protection(), 150);
+
+  // Siblings are computed together in one pass. Starting from the leaves of a
+  // fresh context must still match the per-cgroup formula everywhere.
+  std::function<int64_t(const CgroupPath&)> expected =
+      [&](const CgroupPath& path) -> int64_t {
+    auto raw = [](const CgroupPath& cgroup) -> int64_t {
+      auto read = [&](const char* file) {
+        int64_t value = 0;
+        std::ifstream(cgroup.absolutePath() + "/" + file) >> value;
+        return value;
+      };
+      return std::min(
+          read("memory.current"),
+          std::max(read("memory.min"), read("memory.low")));
+    };
+    if (path.depth() == 1) {
+      return raw(path);
+    }
+    auto parent = path.getParent();
+    int64_t sum = 0;
+    auto dirents = Fs::readDir(parent.absolutePath(), Fs::DE_DIR);
+    for (const auto& name : dirents->dirs) {
+      sum += raw(parent.getChild(name));
+    }
+    if (sum == 0) {
+      return 0;
+    }
+    return raw(path) * std::min(1.0, 1.0 * expected(parent) / sum);
+  };
+  ctx_ = OomdContext(params_);
+  for (const auto& name :
+       {"A/E/G", "A/B/D", "A/E/F", "A/B/C", "A/E", "A/B", "A"}) {
+    CgroupPath path(tempDir_, name);
+    cgroup_ctx = ctx_.addToCacheAndGet(path);
+    ASSERT_TRUE(cgroup_ctx);
+    EXPECT_EQ(cgroup_ctx->get().memory_protection(), expected(path)) << name;
+  }
+
+  // A sibling's protection was filled in by the first one's pass
+  ctx_ = OomdContext(params_);
+  auto g = ctx_.addToCacheAndGet(CgroupPath(tempDir_, "A/E/G"));
+  ASSERT_TRUE(g);
+  EXPECT_EQ(g->get().memory_protection(), 150);
+  auto f = ctx_.addToCacheAndGet(CgroupPath(tempDir_, "A/E/F"));
+  ASSERT_TRUE(f);
+  EXPECT_EQ(TestHelper::getData(*f).memory_protection, 100);
 }
 
 /*
@@ -219,6 +267,454 @@ TEST_F(CgroupContextTest, DistinguishRecreate) {
   EXPECT_EQ(err, CgroupContext::Error::INVALID_CGROUP);
 }
 
+/*
+ * Verify control file fds are kept open within budget, and that reads beyond
+ * the budget still work by opening the file each time.
+ */
+TEST_F(CgroupContextTest, ControlFileFdBudget) {
+  params_.cgroup_fd_budget = 1;
+  ctx_ = OomdContext(params_);
+  F::materialize(F::makeDir(
+      tempDir_,
+      {F::makeDir(
+           "A",
+           {F::makeFile("cgroup.controllers"),
+            F::makeFile("memory.current", "1\n")}),
+       F::makeDir(
+           "B",
+           {F::makeFile("cgroup.controllers"),
+            F::makeFile("memory.current", "2\n")})}));
+
+  {
+    auto a =
+        ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "A")));
+    auto b =
+        ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "B")));
+    EXPECT_EQ(a.current_usage(), 1);
+    EXPECT_EQ(TestHelper::getControlFdsInUse(ctx_), 1);
+    EXPECT_EQ(b.current_usage(), 2);
+    EXPECT_EQ(TestHelper::getControlFdsInUse(ctx_), 1);
+
+    // Both the cached fd and the open-per-read path see new values
+    F::materialize(F::makeDir(
+        tempDir_,
+        {F::makeDir("A", {F::makeFile("memory.current", "3\n")}),
+         F::makeDir("B", {F::makeFile("memory.current", "4\n")})}));
+    ASSERT_TRUE(a.refresh());
+    ASSERT_TRUE(b.refresh());
+    EXPECT_EQ(a.current_usage(), 3);
+    EXPECT_EQ(b.current_usage(), 4);
+    EXPECT_EQ(TestHelper::getControlFdsInUse(ctx_), 1);
+  }
+
+  // Fds are given back to the budget along with their CgroupContext
+  EXPECT_EQ(TestHelper::getControlFdsInUse(ctx_), 0);
+}
+
+/*
+ * Verify inotify watches stay within budget, and that cgroups failing to get
+ * one only try again on validity sweeps.
+ */
+TEST_F(CgroupContextTest, CgroupWatchBudget) {
+  params_.cgroup_watch_budget = 2;
+  params_.validity_sweep_ticks = 4;
+  ctx_ = OomdContext(params_);
+  F::materialize(F::makeDir(
+      tempDir_,
+      {F::makeDir("A", {F::makeFile("cgroup.controllers")}),
+       F::makeDir("B", {F::makeFile("cgroup.controllers")})}));
+
+  // A's watch and its parent's take the whole budget
+  ctx_.bumpCurrentTick();
+  ASSERT_TRUE(ctx_.addToCacheAndGet(CgroupPath(tempDir_, "A")));
+  ctx_.refresh();
+  EXPECT_EQ(TestHelper::getCgroupWatchCount(ctx_), 2);
+
+  ASSERT_TRUE(ctx_.addToCacheAndGet(CgroupPath(tempDir_, "B")));
+  ctx_.bumpCurrentTick();
+  ctx_.refresh();
+  EXPECT_EQ(TestHelper::getCgroupWatchCount(ctx_), 2);
+
+  // Freed along with A, but B doesn't retry until the next sweep
+  F::rmrChecked(tempDir_ + "/A");
+  ctx_.bumpCurrentTick();
+  ctx_.refresh();
+  EXPECT_THAT(ctx_.cgroups(), ElementsAre(CgroupPath(tempDir_, "B")));
+  EXPECT_EQ(TestHelper::getCgroupWatchCount(ctx_), 0);
+
+  ctx_.bumpCurrentTick();
+  ctx_.refresh();
+  EXPECT_EQ(TestHelper::getCgroupWatchCount(ctx_), 2);
+}
+
+/*
+ * Verify children() is sorted and listed again after refresh().
+ */
+TEST_F(CgroupContextTest, Children) {
+  F::materialize(F::makeDir(
+      tempDir_,
+      {F::makeDir(
+          "A",
+          {F::makeFile("cgroup.controllers"),
+           F::makeDir("c"),
+           F::makeDir("b"),
+           F::makeDir("a")})}));
+  auto cgroup_ctx =
+      ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "A")));
+  EXPECT_THAT(*cgroup_ctx.children(), ElementsAre("a", "b", "c"));
+
+  F::rmrChecked(tempDir_ + "/A/b");
+  F::materialize(F::makeDir(
+      tempDir_, {F::makeDir("A", {F::makeDir("d"), F::makeDir("aa")})}));
+  EXPECT_THAT(*cgroup_ctx.children(), ElementsAre("a", "b", "c"));
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_THAT(*cgroup_ctx.children(), ElementsAre("a", "aa", "c", "d"));
+}
+
+/*
+ * Verify the listing is kept across ticks until the dir's watch reports a
+ * child created or removed.
+ */
+TEST_F(CgroupContextTest, ChildrenKeptUntilChanged) {
+  F::materialize(F::makeDir(
+      tempDir_,
+      {F::makeDir(
+          "A",
+          {F::makeFile("cgroup.controllers"),
+           F::makeDir("a"),
+           F::makeDir("b")})}));
+  CgroupPath path(tempDir_, "A");
+  // Stay clear of validity sweeps, which list again regardless
+  ctx_.bumpCurrentTick();
+  const auto& cgroup_ctx = ASSERT_EXISTS(ctx_.addToCacheAndGet(path)).get();
+  EXPECT_THAT(*cgroup_ctx.children(), ElementsAre("a", "b"));
+
+  ctx_.bumpCurrentTick();
+  ctx_.refresh();
+  auto kept = TestHelper::getData(cgroup_ctx).children;
+  ASSERT_TRUE(kept);
+  EXPECT_THAT(*kept, ElementsAre("a", "b"));
+
+  F::materialize(F::makeDir(tempDir_, {F::makeDir("A", {F::makeDir("c")})}));
+  ctx_.bumpCurrentTick();
+  ctx_.refresh();
+  EXPECT_FALSE(TestHelper::getData(cgroup_ctx).children);
+  EXPECT_THAT(*cgroup_ctx.children(), ElementsAre("a", "b", "c"));
+
+  F::rmrChecked(tempDir_ + "/A/a");
+  ctx_.bumpCurrentTick();
+  ctx_.refresh();
+  EXPECT_FALSE(TestHelper::getData(cgroup_ctx).children);
+  EXPECT_THAT(*cgroup_ctx.children(), ElementsAre("b", "c"));
+}
+
+/*
+ * Verify containers of one interval are reused by the next rather than freed.
+ */
+TEST_F(CgroupContextTest, RecycleBuffers) {
+  F::materialize(F::makeDir(
+      tempDir_,
+      {F::makeDir(
+          "A",
+          {F::makeFile("cgroup.controllers"),
+           F::makeFile(
+               "io.stat",
+               {"1:10 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=5 dios=6\n"}),
+           F::makeDir("a"),
+           F::makeDir("b")})}));
+  auto cgroup_ctx =
+      ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "A")));
+
+  // Every tick is a validity sweep until the first bump, so each refresh()
+  // lists again, into the buffer of an earlier listing
+  ASSERT_TRUE(cgroup_ctx.children());
+  const auto* first = cgroup_ctx.children()->data();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  ASSERT_TRUE(cgroup_ctx.children());
+  const auto* second = cgroup_ctx.children()->data();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  ASSERT_TRUE(cgroup_ctx.children());
+  EXPECT_EQ(cgroup_ctx.children()->data(), first);
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  ASSERT_TRUE(cgroup_ctx.children());
+  EXPECT_EQ(cgroup_ctx.children()->data(), second);
+  EXPECT_THAT(*cgroup_ctx.children(), ElementsAre("a", "b"));
+
+  ASSERT_TRUE(cgroup_ctx.io_stat());
+  const auto* io_stat = cgroup_ctx.io_stat()->data();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  ASSERT_TRUE(cgroup_ctx.io_stat());
+  EXPECT_EQ(cgroup_ctx.io_stat()->data(), io_stat);
+  EXPECT_EQ(cgroup_ctx.io_stat()->at(0).dev_id, "1:10");
+  EXPECT_EQ(cgroup_ctx.io_stat()->at(0).dios, 6);
+}
+
+/*
+ * Verify cold fields are only allocated once one is read, and kept across
+ * intervals without what was read into them.
+ */
+TEST_F(CgroupContextTest, ColdDataOnUse) {
+  F::materialize(F::makeDir(
+      tempDir_,
+      {F::makeDir(
+          "A",
+          {F::makeFile("cgroup.controllers"),
+           F::makeFile("memory.current", "10\n"),
+           F::makeFile("memory.stat", "anon 20\n")})}));
+  auto cgroup_ctx =
+      ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "A")));
+
+  EXPECT_EQ(cgroup_ctx.current_usage(), 10);
+  EXPECT_FALSE(TestHelper::hasColdData(cgroup_ctx));
+  ASSERT_TRUE(cgroup_ctx.memory_stat());
+  EXPECT_TRUE(TestHelper::hasColdData(cgroup_ctx));
+
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_TRUE(TestHelper::hasColdData(cgroup_ctx));
+  EXPECT_EQ(TestHelper::getData(cgroup_ctx).memory_stat, std::nullopt);
+  F::writeChecked(tempDir_ + "/A/memory.stat", "anon 30\n");
+  EXPECT_EQ(cgroup_ctx.anon_usage(), 30);
+}
+
+/*
+ * Verify a failed scalar read is remembered for the rest of the interval.
+ */
+TEST_F(CgroupContextTest, FailedReadKeptUntilRefresh) {
+  F::materialize(F::makeDir(
+      tempDir_, {F::makeDir("A", {F::makeFile("cgroup.controllers")})}));
+  auto cgroup_ctx =
+      ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "A")));
+
+  auto err = CgroupContext::Error::NO_ERROR;
+  EXPECT_EQ(cgroup_ctx.swap_usage(&err), std::nullopt);
+  EXPECT_EQ(err, CgroupContext::Error::INVALID_CGROUP);
+
+  F::materialize(F::makeDir(
+      tempDir_,
+      {F::makeDir("A", {F::makeFile("memory.swap.current", "7\n")})}));
+  err = CgroupContext::Error::NO_ERROR;
+  EXPECT_EQ(cgroup_ctx.swap_usage(&err), std::nullopt);
+  EXPECT_EQ(err, CgroupContext::Error::INVALID_CGROUP);
+
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  err = CgroupContext::Error::NO_ERROR;
+  EXPECT_EQ(cgroup_ctx.swap_usage(&err), 7);
+  EXPECT_EQ(err, CgroupContext::Error::NO_ERROR);
+}
+
+/*
+ * Verify refresh() records what was read into the history, and that its
+ * stats cover only what is still in the ring.
+ */
+TEST_F(CgroupContextTest, History) {
+  ContextParams params;
+  params.history_samples = 3;
+  OomdContext ctx(params);
+  F::materialize(F::makeDir(
+      tempDir_, {F::makeDir("A", {F::makeFile("cgroup.controllers")})}));
+  auto cgroup_ctx =
+      ASSERT_EXISTS(CgroupContext::make(ctx, CgroupPath(tempDir_, "A")));
+  using Series = CgroupContext::HistorySeries;
+  EXPECT_EQ(cgroup_ctx.history(Series::CURRENT_USAGE), nullptr);
+
+  for (int i = 1; i <= 5; ++i) {
+    F::materialize(F::makeDir(
+        tempDir_,
+        {F::makeDir(
+            "A", {F::makeFile("memory.current", std::to_string(i * 10))})}));
+    EXPECT_EQ(cgroup_ctx.current_usage(), i * 10);
+    ASSERT_TRUE(cgroup_ctx.refresh());
+    ctx.bumpCurrentTick();
+  }
+
+  const auto* usage = cgroup_ctx.history(Series::CURRENT_USAGE);
+  ASSERT_NE(usage, nullptr);
+  ASSERT_EQ(usage->size(), 3);
+  auto latest = ASSERT_EXISTS(usage->at(0));
+  EXPECT_EQ(latest.tick, 4);
+  EXPECT_EQ(latest.value, 50);
+  EXPECT_EQ(usage->at(2)->value, 30);
+  EXPECT_EQ(usage->at(3), std::nullopt);
+
+  auto stats = usage->stats();
+  EXPECT_EQ(stats.count, 3);
+  EXPECT_EQ(stats.sum, 120);
+  EXPECT_EQ(stats.min, 30);
+  EXPECT_EQ(stats.max, 50);
+  EXPECT_DOUBLE_EQ(stats.slope, 10);
+  stats = usage->stats(2);
+  EXPECT_EQ(stats.count, 2);
+  EXPECT_EQ(stats.sum, 90);
+  EXPECT_EQ(stats.min, 40);
+  // Moving average over all 5 samples, lagging behind the latest
+  auto ewma = ASSERT_EXISTS(usage->ewma());
+  EXPECT_GT(ewma, 10);
+  EXPECT_LT(ewma, 50);
+
+  // Never read, so never recorded
+  EXPECT_EQ(cgroup_ctx.history(Series::SWAP_USAGE), nullptr);
+}
+
+/*
+ * Verify kill preference is kept across intervals until its xattrs change.
+ */
+TEST_F(CgroupContextTest, KillPreferenceCache) {
+  F::materialize(F::makeDir(
+      tempDir_, {F::makeDir("A", {F::makeFile("cgroup.controllers")})}));
+  auto path = tempDir_ + "/A";
+  auto cgroup_ctx =
+      ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "A")));
+  EXPECT_EQ(cgroup_ctx.kill_preference(), KillPreference::NORMAL);
+
+  if (!Fs::setxattr(path, Fs::kOomdUserAvoidXAttr, "")) {
+#ifdef GTEST_SKIP
+    GTEST_SKIP() << "Filesystem doesn't support user xattrs";
+#else
+    OLOG << "Filesystem doesn't support user xattrs";
+    return;
+#endif
+  }
+  // Cached within the interval. Events are collected by OomdContext::refresh()
+  EXPECT_EQ(cgroup_ctx.kill_preference(), KillPreference::NORMAL);
+  ctx_.refresh();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_EQ(cgroup_ctx.kill_preference(), KillPreference::AVOID);
+
+  // Unchanged xattrs survive refresh()
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_EQ(cgroup_ctx.kill_preference(), KillPreference::AVOID);
+
+  ASSERT_SYS_OK(Fs::setxattr(path, Fs::kOomdUserPreferXAttr, ""));
+  ctx_.refresh();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_EQ(cgroup_ctx.kill_preference(), KillPreference::PREFER);
+}
+
+/*
+ * Verify contexts on the same cgroup share its watch, and destroying one
+ * doesn't stop the other from seeing changes.
+ */
+TEST_F(CgroupContextTest, KillPreferenceCacheSharedWatch) {
+  F::materialize(F::makeDir(
+      tempDir_, {F::makeDir("A", {F::makeFile("cgroup.controllers")})}));
+  auto path = tempDir_ + "/A";
+  auto cgroup_ctx =
+      ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "A")));
+  EXPECT_EQ(cgroup_ctx.kill_preference(), KillPreference::NORMAL);
+  {
+    auto other_ctx =
+        ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "A")));
+    EXPECT_EQ(other_ctx.kill_preference(), KillPreference::NORMAL);
+  }
+
+  if (!Fs::setxattr(path, Fs::kOomdUserAvoidXAttr, "")) {
+#ifdef GTEST_SKIP
+    GTEST_SKIP() << "Filesystem doesn't support user xattrs";
+#else
+    OLOG << "Filesystem doesn't support user xattrs";
+    return;
+#endif
+  }
+  ctx_.refresh();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_EQ(cgroup_ctx.kill_preference(), KillPreference::AVOID);
+}
+
+/*
+ * Verify configuration is kept across intervals until it's written to or
+ * it's time to re-read it anyway.
+ */
+TEST_F(CgroupContextTest, ConfigRetention) {
+  params_.config_refresh_ticks = 3;
+  ctx_ = OomdContext(params_);
+  F::materialize(F::makeDir(
+      tempDir_,
+      {F::makeDir(
+          "A",
+          {F::makeFile("cgroup.controllers"),
+           F::makeFile("memory.current", "1\n"),
+           F::makeFile("memory.low", "1\n")})}));
+  auto next_tick = [&]() {
+    ctx_.bumpCurrentTick();
+    ctx_.refresh();
+  };
+  ctx_.refresh();
+  auto cgroup_ctx =
+      ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "A")));
+  EXPECT_EQ(cgroup_ctx.memory_low(), 1);
+  EXPECT_EQ(cgroup_ctx.current_usage(), 1);
+
+  // Writes to other files don't drop it
+  F::materialize(F::makeDir(
+      tempDir_, {F::makeDir("A", {F::makeFile("memory.current", "2\n")})}));
+  next_tick();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_EQ(TestHelper::getData(cgroup_ctx).memory_low, 1);
+  EXPECT_EQ(TestHelper::getData(cgroup_ctx).current_usage, std::nullopt);
+  EXPECT_EQ(cgroup_ctx.memory_low(), 1);
+  EXPECT_EQ(cgroup_ctx.current_usage(), 2);
+
+  // Writes are picked up on the next interval
+  F::materialize(F::makeDir(
+      tempDir_, {F::makeDir("A", {F::makeFile("memory.low", "2\n")})}));
+  EXPECT_EQ(cgroup_ctx.memory_low(), 1);
+  next_tick();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_EQ(TestHelper::getData(cgroup_ctx).memory_low, std::nullopt);
+  EXPECT_EQ(cgroup_ctx.memory_low(), 2);
+
+  // Everything is re-read every ContextParams::config_refresh_ticks
+  next_tick();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_EQ(TestHelper::getData(cgroup_ctx).memory_low, std::nullopt);
+  EXPECT_EQ(cgroup_ctx.memory_low(), 2);
+}
+
+/*
+ * Verify config files without a watch are re-read every interval, and that a
+ * failed watch is only retried once another watch was freed.
+ */
+TEST_F(CgroupContextTest, ConfigWatchBudget) {
+  params_.cgroup_watch_budget = 1;
+  // Open fds would keep removed files, and their watches, around
+  params_.cgroup_fd_budget = 0;
+  ctx_ = OomdContext(params_);
+  F::materialize(F::makeDir(
+      tempDir_,
+      {F::makeDir(
+          "A",
+          {F::makeFile("cgroup.controllers"),
+           F::makeFile("memory.min", "1\n"),
+           F::makeFile("memory.low", "2\n")})}));
+  auto next_tick = [&]() {
+    ctx_.bumpCurrentTick();
+    ctx_.refresh();
+  };
+  ctx_.refresh();
+  auto cgroup_ctx =
+      ASSERT_EXISTS(CgroupContext::make(ctx_, CgroupPath(tempDir_, "A")));
+  EXPECT_EQ(cgroup_ctx.memory_min(), 1);
+  EXPECT_EQ(cgroup_ctx.memory_low(), 2);
+  EXPECT_EQ(TestHelper::getCgroupWatchCount(ctx_), 1);
+
+  next_tick();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_EQ(TestHelper::getData(cgroup_ctx).memory_min, 1);
+  EXPECT_EQ(TestHelper::getData(cgroup_ctx).memory_low, std::nullopt);
+  EXPECT_EQ(cgroup_ctx.memory_low(), 2);
+
+  // Dropping memory.min's watch leaves room for memory.low's
+  F::rmrChecked(tempDir_ + "/A/memory.min");
+  next_tick();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_EQ(TestHelper::getCgroupWatchCount(ctx_), 0);
+  EXPECT_EQ(cgroup_ctx.memory_low(), 2);
+  EXPECT_EQ(TestHelper::getCgroupWatchCount(ctx_), 1);
+  next_tick();
+  ASSERT_TRUE(cgroup_ctx.refresh());
+  EXPECT_EQ(TestHelper::getData(cgroup_ctx).memory_low, 2);
+}
+
 /*
  * Verify expected values are read from fs.
  * Verify data are cached and not affected by fs changes.
@@ -454,7 +950,9 @@ TEST_F(CgroupContextTest, DataLifeCycle) {
   EXPECT_EQ(cgroup_ctx.pg_scan_cumulative(), pg_scan_cumulative);
   EXPECT_EQ(cgroup_ctx.pg_scan_rate(), pg_scan_rate);
 
-  // Call refresh() to clear cache and retrieve values again
+  // Call refresh() to clear cache and retrieve values again. Changes to
+  // configuration are collected by OomdContext::refresh().
+  ctx_.refresh();
   ASSERT_TRUE(cgroup_ctx.refresh());
   set_and_check_fields();
 
@@ -615,6 +1113,35 @@ TEST_F(CgroupContextTest, EffectiveSwapUtilPct) {
   }
 }
 
+/*
+ * Verify ancestors get all effective swap values filled in on the way down.
+ */
+TEST_F(CgroupContextTest, EffectiveSwapTopDown) {
+  ctx_.setSystemContext(SystemContext{.swaptotal = 400, .swapused = 100});
+  F::materialize(F::makeDir(
+      tempDir_,
+      {F::makeDir(
+          "A",
+          {F::makeFile("cgroup.controllers"),
+           F::makeFile("memory.swap.max", "max\n"),
+           F::makeFile("memory.swap.current", "100\n"),
+           F::makeDir(
+               "B",
+               {F::makeFile("cgroup.controllers"),
+                F::makeFile("memory.swap.max", "200\n"),
+                F::makeFile("memory.swap.current", "100\n")})})}));
+
+  auto b = ASSERT_EXISTS(ctx_.addToCacheAndGet(CgroupPath(tempDir_, "A/B")));
+  EXPECT_EQ(b.get().effective_swap_util_pct(), 0.5);
+  auto a = ASSERT_EXISTS(ctx_.addToCacheAndGet(CgroupPath(tempDir_, "A")));
+  const auto& data = TestHelper::getData(a);
+  EXPECT_EQ(data.effective_swap_max, 400);
+  EXPECT_EQ(data.effective_swap_free, 300);
+  EXPECT_EQ(data.effective_swap_util_pct, 0.25);
+  EXPECT_EQ(b.get().effective_swap_max(), 200);
+  EXPECT_EQ(b.get().effective_swap_free(), 100);
+}
+
 TEST_F(CgroupContextTest, EffectiveSwapUtilPctNoSwap) {
   // Check that with no swap available on the root slice, this still works
   ctx_.setSystemContext(SystemContext{.swaptotal = 0, .swapused = 0});
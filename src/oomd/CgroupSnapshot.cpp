@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "oomd/CgroupSnapshot.h"
+
+#include <numeric>
+
+namespace Oomd {
+
+namespace {
+
+void fillPressure(
+    CgroupSnapshot::PressureColumns& columns,
+    size_t row,
+    const std::optional<ResourcePressure>& pressure) {
+  if (pressure) {
+    columns.sec_10[row] = pressure->sec_10;
+    columns.sec_60[row] = pressure->sec_60;
+    columns.sec_300[row] = pressure->sec_300;
+  }
+}
+
+void resizePressure(CgroupSnapshot::PressureColumns& columns, size_t size) {
+  columns.sec_10.resize(size);
+  columns.sec_60.resize(size);
+  columns.sec_300.resize(size);
+}
+
+} // namespace
+
+CgroupSnapshot::CgroupSnapshot(
+    std::vector<OomdContext::ConstCgroupContextRef> cgroups,
+    uint32_t columns)
+    : cgroups_(std::move(cgroups)) {
+  const auto n = cgroups_.size();
+  kill_preference.resize(n);
+  if (columns & ID) {
+    id.resize(n);
+  }
+  if (columns & CURRENT_USAGE) {
+    current_usage.resize(n);
+  }
+  if (columns & EFFECTIVE_USAGE) {
+    effective_usage.resize(n);
+  }
+  if (columns & MEMORY_GROWTH) {
+    memory_growth.resize(n);
+  }
+  if (columns & MEM_PRESSURE) {
+    resizePressure(mem_pressure, n);
+  }
+  if (columns & IO_PRESSURE) {
+    resizePressure(io_pressure, n);
+  }
+  if (columns & SWAP_USAGE) {
+    swap_usage.resize(n);
+  }
+  if (columns & PG_SCAN_RATE) {
+    pg_scan_rate.resize(n);
+  }
+  if (columns & IO_COST_RATE) {
+    io_cost_rate.resize(n);
+  }
+
+  // One pass per cgroup rather than per column so each context is only
+  // pulled into cache once
+  for (size_t i = 0; i < n; ++i) {
+    const CgroupContext& cgroup_ctx = cgroups_[i];
+    kill_preference[i] =
+        cgroup_ctx.kill_preference().value_or(KillPreference::NORMAL);
+    if (columns & ID) {
+      id[i] = cgroup_ctx.id().value_or(0);
+    }
+    if (columns & CURRENT_USAGE) {
+      current_usage[i] = cgroup_ctx.current_usage().value_or(0);
+    }
+    if (columns & EFFECTIVE_USAGE) {
+      effective_usage[i] = cgroup_ctx.effective_usage().value_or(0);
+    }
+    if (columns & MEMORY_GROWTH) {
+      memory_growth[i] = cgroup_ctx.memory_growth().value_or(0);
+    }
+    if (columns & MEM_PRESSURE) {
+      fillPressure(mem_pressure, i, cgroup_ctx.mem_pressure());
+    }
+    if (columns & IO_PRESSURE) {
+      fillPressure(io_pressure, i, cgroup_ctx.io_pressure());
+    }
+    if (columns & SWAP_USAGE) {
+      swap_usage[i] = cgroup_ctx.swap_usage().value_or(0);
+    }
+    if (columns & PG_SCAN_RATE) {
+      pg_scan_rate[i] = cgroup_ctx.pg_scan_rate().value_or(0);
+    }
+    if (columns & IO_COST_RATE) {
+      io_cost_rate[i] = cgroup_ctx.io_cost_rate().value_or(0);
+    }
+  }
+}
+
+std::vector<uint32_t> CgroupSnapshot::rows() const {
+  std::vector<uint32_t> ret(size());
+  std::iota(ret.begin(), ret.end(), 0);
+  return ret;
+}
+
+} // namespace Oomd
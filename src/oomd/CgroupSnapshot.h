@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include "oomd/OomdContext.h"
+
+namespace Oomd {
+
+/*
+ * Struct-of-arrays copy of the ranking inputs of a group of cgroups, usually
+ * siblings. Row i describes cgroups()[i].
+ *
+ * Rankers used to call the accessors from inside sort comparators, ie.
+ * O(n log n) times per field. A snapshot calls each of them once per cgroup,
+ * after which sort keys are computed with plain loops over the columns.
+ *
+ * Only the requested columns are filled, the rest stay empty, so taking a
+ * snapshot reads nothing the ranker wouldn't have read anyway. Missing values
+ * read as 0, as with value_or(0). kill_preference is always filled.
+ */
+class CgroupSnapshot {
+ public:
+  enum Column : uint32_t {
+    ID = 1 << 0,
+    CURRENT_USAGE = 1 << 1,
+    EFFECTIVE_USAGE = 1 << 2,
+    MEMORY_GROWTH = 1 << 3,
+    MEM_PRESSURE = 1 << 4,
+    IO_PRESSURE = 1 << 5,
+    SWAP_USAGE = 1 << 6,
+    PG_SCAN_RATE = 1 << 7,
+    IO_COST_RATE = 1 << 8,
+  };
+
+  struct PressureColumns {
+    std::vector<float> sec_10;
+    std::vector<float> sec_60;
+    std::vector<float> sec_300;
+  };
+
+  CgroupSnapshot(
+      std::vector<OomdContext::ConstCgroupContextRef> cgroups,
+      uint32_t columns);
+
+  size_t size() const {
+    return cgroups_.size();
+  }
+
+  const std::vector<OomdContext::ConstCgroupContextRef>& cgroups() const {
+    return cgroups_;
+  }
+
+  // Indices of every row, in row order
+  std::vector<uint32_t> rows() const;
+
+  // Indices of the rows @param pred accepts, in row order
+  template <class Pred>
+  std::vector<uint32_t> rows(Pred&& pred) const {
+    std::vector<uint32_t> ret;
+    for (uint32_t i = 0; i < size(); ++i) {
+      if (pred(i)) {
+        ret.push_back(i);
+      }
+    }
+    return ret;
+  }
+
+  /*
+   * Sorts @param rows by kill_preference, then @param keys, which is indexed
+   * by row. Highest first to lowest last. Ties are broken the same way
+   * OomdContext::sortDescWithKillPrefs() breaks them for the same cgroups in
+   * the same order.
+   */
+  template <class Key>
+  std::vector<OomdContext::ConstCgroupContextRef> sortDescWithKillPrefs(
+      std::vector<uint32_t> rows,
+      const std::vector<Key>& keys) const {
+    std::sort(rows.begin(), rows.end(), [&](uint32_t a, uint32_t b) {
+      return std::tie(kill_preference[a], keys[a]) >
+          std::tie(kill_preference[b], keys[b]);
+    });
+    std::vector<OomdContext::ConstCgroupContextRef> sorted;
+    sorted.reserve(rows.size());
+    for (auto row : rows) {
+      sorted.push_back(cgroups_[row]);
+    }
+    return sorted;
+  }
+
+  std::vector<CgroupContext::Id> id;
+  std::vector<int64_t> current_usage;
+  std::vector<int64_t> effective_usage;
+  std::vector<double> memory_growth;
+  PressureColumns mem_pressure;
+  PressureColumns io_pressure;
+  std::vector<int64_t> swap_usage;
+  std::vector<int64_t> pg_scan_rate;
+  std::vector<double> io_cost_rate;
+  std::vector<KillPreference> kill_preference;
+
+ private:
+  std::vector<OomdContext::ConstCgroupContextRef> cgroups_;
+};
+
+} // namespace Oomd
@@ -17,6 +17,7 @@
 
 #include <json/value.h>
 #include <sys/file.h>
+#include <sys/resource.h>
 #include <sys/types.h>
 #include <sys/unistd.h>
 #include <cstring>
@@ -99,7 +100,12 @@ static void printUsage() {
          "  --device DEVS              Comma separated <major>:<minor> pairs for IO cost calculation (default: none)\n"
          "  --ssd-coeffs COEFFS        Comma separated values for SSD IO cost calculation (default: see doc)\n"
          "  --hdd-coeffs COEFFS        Comma separated values for HDD IO cost calculation (default: see doc)\n"
-         "  --kmsg-override PATH       File to log kills to (default: /dev/kmsg)"
+         "  --kmsg-override PATH       File to log kills to (default: /dev/kmsg)\n"
+         "  --cgroup-fd-budget N       Max cgroup control file fds kept open across intervals (default: half of RLIMIT_NOFILE)\n"
+         "  --cgroup-watch-budget N    Max inotify watches on cgroups, 0 to poll instead (default: quarter of fs.inotify.max_user_watches)\n"
+         "  --history-samples N        Past samples of each cgroup counter kept for plugins (default: 0)\n"
+         "  --prefetch-threads N       Threads reading cgroup data ahead of plugins, 0 to disable (default: 4)\n"
+         "  --cache-idle-ticks N       Drop cached cgroups no plugin looked up for N intervals, 0 to disable (default: 0)"
       << std::endl;
 }
 
@@ -227,8 +233,37 @@ enum MainOptions {
   OPT_DEVICE = 256, // avoid collision with char
   OPT_SSD_COEFFS,
   OPT_HDD_COEFFS,
+  OPT_CGROUP_FD_BUDGET,
+  OPT_HISTORY_SAMPLES,
+  OPT_PREFETCH_THREADS,
+  OPT_CACHE_IDLE_TICKS,
+  OPT_CGROUP_WATCH_BUDGET,
 };
 
+static int64_t defaultCgroupFdBudget() {
+  struct rlimit rlim;
+  if (::getrlimit(RLIMIT_NOFILE, &rlim) != 0 ||
+      rlim.rlim_cur == RLIM_INFINITY) {
+    return Oomd::ContextParams{}.cgroup_fd_budget;
+  }
+  // Leave the other half for everything else oomd opens
+  return rlim.rlim_cur / 2;
+}
+
+static int64_t defaultCgroupWatchBudget() {
+  auto lines =
+      Oomd::Fs::readFileByLine("/proc/sys/fs/inotify/max_user_watches");
+  if (!lines || lines->empty()) {
+    return Oomd::ContextParams{}.cgroup_watch_budget;
+  }
+  try {
+    // Other root daemons, eg. systemd and udev, draw from the same limit
+    return std::stoll((*lines)[0]) / 4;
+  } catch (const std::exception&) {
+    return Oomd::ContextParams{}.cgroup_watch_budget;
+  }
+}
+
 int main(int argc, char** argv) {
   std::string flag_conf_file = kConfigFilePath;
   std::string cgroup_fs = kCgroupFsRoot;
@@ -238,6 +273,11 @@ int main(int argc, char** argv) {
   std::string dev_id;
   std::string kmsg_path = kKmsgPath;
   int interval = 5;
+  int64_t cgroup_fd_budget = -1;
+  int64_t cgroup_watch_budget = -1;
+  int64_t history_samples = Oomd::ContextParams{}.history_samples;
+  int64_t prefetch_threads = Oomd::ContextParams{}.prefetch_threads;
+  int64_t cache_idle_ticks = Oomd::ContextParams{}.cache_idle_ticks;
   bool should_check_config = false;
 
   int option_index = 0;
@@ -265,6 +305,22 @@ int main(int argc, char** argv) {
       option{"ssd-coeffs", required_argument, nullptr, OPT_SSD_COEFFS},
       option{"hdd-coeffs", required_argument, nullptr, OPT_HDD_COEFFS},
       option{"kmsg-override", required_argument, nullptr, 'k'},
+      option{
+          "cgroup-fd-budget", required_argument, nullptr, OPT_CGROUP_FD_BUDGET},
+      option{
+          "cgroup-watch-budget",
+          required_argument,
+          nullptr,
+          OPT_CGROUP_WATCH_BUDGET},
+      option{
+          "history-samples", required_argument, nullptr, OPT_HISTORY_SAMPLES},
+      option{
+          "prefetch-threads",
+          required_argument,
+          nullptr,
+          OPT_PREFETCH_THREADS},
+      option{
+          "cache-idle-ticks", required_argument, nullptr, OPT_CACHE_IDLE_TICKS},
       option{nullptr, 0, nullptr, 0}};
 
   while ((c = getopt_long(
@@ -347,6 +403,71 @@ int main(int argc, char** argv) {
       case 'k':
         kmsg_path = std::string(optarg);
         break;
+      case OPT_CGROUP_FD_BUDGET:
+        try {
+          cgroup_fd_budget = std::stoll(optarg, &parsed_len);
+        } catch (const std::exception& e) {
+          parse_error = true;
+        }
+        if (parse_error || cgroup_fd_budget < 0 ||
+            parsed_len != strlen(optarg)) {
+          std::cerr << "Cgroup fd budget not a >=0 integer: " << optarg
+                    << std::endl;
+          return 1;
+        }
+        break;
+      case OPT_CGROUP_WATCH_BUDGET:
+        try {
+          cgroup_watch_budget = std::stoll(optarg, &parsed_len);
+        } catch (const std::exception& e) {
+          parse_error = true;
+        }
+        if (parse_error || cgroup_watch_budget < 0 ||
+            parsed_len != strlen(optarg)) {
+          std::cerr << "Cgroup watch budget not a >=0 integer: " << optarg
+                    << std::endl;
+          return 1;
+        }
+        break;
+      case OPT_HISTORY_SAMPLES:
+        try {
+          history_samples = std::stoll(optarg, &parsed_len);
+        } catch (const std::exception& e) {
+          parse_error = true;
+        }
+        if (parse_error || history_samples < 0 ||
+            parsed_len != strlen(optarg)) {
+          std::cerr << "History samples not a >=0 integer: " << optarg
+                    << std::endl;
+          return 1;
+        }
+        break;
+      case OPT_PREFETCH_THREADS:
+        try {
+          prefetch_threads = std::stoll(optarg, &parsed_len);
+        } catch (const std::exception& e) {
+          parse_error = true;
+        }
+        if (parse_error || prefetch_threads < 0 ||
+            parsed_len != strlen(optarg)) {
+          std::cerr << "Prefetch threads not a >=0 integer: " << optarg
+                    << std::endl;
+          return 1;
+        }
+        break;
+      case OPT_CACHE_IDLE_TICKS:
+        try {
+          cache_idle_ticks = std::stoll(optarg, &parsed_len);
+        } catch (const std::exception& e) {
+          parse_error = true;
+        }
+        if (parse_error || cache_idle_ticks < 0 ||
+            parsed_len != strlen(optarg)) {
+          std::cerr << "Cache idle ticks not a >=0 integer: " << optarg
+                    << std::endl;
+          return 1;
+        }
+        break;
       case 0:
         break;
       case '?':
@@ -476,14 +597,26 @@ int main(int argc, char** argv) {
     return EXIT_CANT_RECOVER;
   }
 
+  Oomd::ContextParams params{
+      .io_devs = *io_devs,
+      .hdd_coeffs = hdd_coeffs,
+      .ssd_coeffs = ssd_coeffs,
+      .cgroup_fd_budget =
+          cgroup_fd_budget < 0 ? defaultCgroupFdBudget() : cgroup_fd_budget,
+      .cgroup_watch_budget = cgroup_watch_budget < 0
+          ? defaultCgroupWatchBudget()
+          : cgroup_watch_budget,
+      .history_samples = history_samples,
+      .prefetch_threads = prefetch_threads,
+      .cache_idle_ticks = cache_idle_ticks,
+  };
+
   Oomd::Oomd oomd(
       std::move(ir),
       std::move(engine),
       interval,
       cgroup_fs,
       drop_in_dir,
-      *io_devs,
-      hdd_coeffs,
-      ssd_coeffs);
+      params);
   return oomd.run();
 }
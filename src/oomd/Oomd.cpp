@@ -17,37 +17,39 @@
 
 #include "oomd/Oomd.h"
 
+#include <algorithm>
 #include <cmath>
 #include <functional>
+#include <set>
 #include <thread>
 
 #include "oomd/CgroupContext.h"
 #include "oomd/Log.h"
+#include "oomd/Stats.h"
 #include "oomd/dropin/FsDropInService.h"
+#include "oomd/engine/Engine.h"
 #include "oomd/include/Assert.h"
+#include "oomd/include/CoreStats.h"
 #include "oomd/include/Defines.h"
 #include "oomd/util/Fs.h"
-#include "oomd/util/Util.h"
 
 namespace Oomd {
 
+namespace {
+// Shortest time between two runs, triggered or regular
+constexpr std::chrono::seconds kMinInterval{1};
+} // namespace
+
 Oomd::Oomd(
     std::unique_ptr<Config2::IR::Root> ir_root,
     std::unique_ptr<Engine::Engine> engine,
     int interval,
     const std::string& cgroup_fs,
     const std::string& drop_in_dir,
-    const std::unordered_map<std::string, DeviceType>& io_devs,
-    const IOCostCoeffs& hdd_coeffs,
-    const IOCostCoeffs& ssd_coeffs)
+    const ContextParams& params)
     : interval_(interval),
       ir_root_(std::move(ir_root)),
       engine_(std::move(engine)) {
-  ContextParams params{
-      .io_devs = io_devs,
-      .hdd_coeffs = hdd_coeffs,
-      .ssd_coeffs = ssd_coeffs,
-  };
   ctx_ = OomdContext(params);
   if (drop_in_dir.size()) {
     fs_drop_in_service_ =
@@ -58,23 +60,28 @@ Oomd::Oomd(
 Oomd::~Oomd() = default;
 
 void Oomd::updateContext() {
-  // Update information about swapfree
+  // Snapshot system wide files once so every reader this interval shares it
   SystemContext system_ctx;
-  auto swaps = Fs::readFileByLine("/proc/swaps");
 
   // TODO(dschatzberg): Handle error here
-  if (swaps) {
-    // For each swap, tally up used and total
-    for (size_t i = 1; i < swaps->size(); ++i) {
-      auto parts = Util::split((*swaps)[i], '\t');
-      // The /proc/swaps format is pretty bad. The first field is padded by
-      // spaces but the rest of the fields are padded by '\t'. Since we don't
-      // really care about the first field, we'll just split by '\t'.
-      OCHECK_EXCEPT(
-          parts.size() == 4, std::runtime_error("/proc/swaps malformed"));
-      system_ctx.swaptotal += std::stoll(parts[1]) * 1024; // Values are in KB
-      system_ctx.swapused += std::stoll(parts[2]) * 1024; // Values are in KB
-    }
+  if (auto swaps = Fs::getSwaps()) {
+    system_ctx.swaptotal = swaps->total;
+    system_ctx.swapused = swaps->used;
+  } else {
+    OCHECK_EXCEPT(
+        swaps.error().code().value() != EINVAL,
+        std::runtime_error("/proc/swaps malformed"));
+  }
+
+  if (auto meminfo = Fs::getMeminfo()) {
+    system_ctx.meminfo = std::move(*meminfo);
+  }
+
+  if (auto mem_pressure = Fs::readRootMempressureRecord()) {
+    system_ctx.mem_pressure = *mem_pressure;
+  }
+  if (auto io_pressure = Fs::readRootIopressureRecord()) {
+    system_ctx.io_pressure = *io_pressure;
   }
 
   auto swappiness = Fs::getSwappiness();
@@ -82,22 +89,24 @@ void Oomd::updateContext() {
     system_ctx.swappiness = *swappiness;
   }
 
-  if (auto vmstat_opt = Fs::getVmstat()) {
-    system_ctx.vmstat = *vmstat_opt;
+  // PSWPOUT feeds SystemContext::swapout_bps_*
+  auto vmstat_keys = engine_->vmstatKeys();
+  vmstat_keys.set(static_cast<size_t>(Vmstat::Key::PSWPOUT));
+  if (auto vmstat = Fs::readVmstat(vmstat_keys)) {
+    system_ctx.vmstat = *vmstat;
 
     // Factor for calculating moving average
     const static double factor60 = std::exp(-interval_.count() / 60.0);
     const static double factor300 = std::exp(-interval_.count() / 300.0);
 
-    auto& prev_system_ctx = ctx_.getSystemContext();
-    if (prev_system_ctx.vmstat.size() > 0) {
-      auto swapout_bps = (system_ctx.vmstat.at("pswpout") -
-                          prev_system_ctx.vmstat.at("pswpout")) *
-          4096.0 / interval_.count();
-      system_ctx.swapout_bps_60 = swapout_bps +
-          factor60 * (prev_system_ctx.swapout_bps_60 - swapout_bps);
-      system_ctx.swapout_bps_300 = swapout_bps +
-          factor300 * (prev_system_ctx.swapout_bps_300 - swapout_bps);
+    const auto& prev_system_ctx = ctx_.getSystemContext();
+    if (auto pswpout_rate = system_ctx.vmstat.rate(
+            prev_system_ctx.vmstat, Vmstat::Key::PSWPOUT, interval_)) {
+      auto swapout_bps = *pswpout_rate * 4096.0;
+      system_ctx.swapout_bps_60 = Vmstat::ewma(
+          prev_system_ctx.swapout_bps_60, swapout_bps, factor60);
+      system_ctx.swapout_bps_300 = Vmstat::ewma(
+          prev_system_ctx.swapout_bps_300, swapout_bps, factor300);
     }
   }
 
@@ -107,6 +116,70 @@ void Oomd::updateContext() {
   });
   ctx_.refresh();
   ctx_.bumpCurrentTick();
+  ctx_.prefetch(engine_->intervalDependencies());
+}
+
+std::vector<PressureTriggerSet::Trigger> Oomd::resolvePressureTrigger(
+    const PressureTrigger& trigger) {
+  std::vector<PressureTriggerSet::Trigger> ret;
+  bool io = trigger.resource == ResourceType::IO;
+  auto line = "full " + std::to_string(trigger.stall.count()) + " " +
+      std::to_string(trigger.window.count());
+  for (const CgroupContext& cgroup_ctx :
+       ctx_.addToCacheAndGet(trigger.cgroups)) {
+    const auto& cgroup = cgroup_ctx.cgroup();
+    // The root cgroup has no pressure files, its pressure is system wide
+    std::string path;
+    if (cgroup.isRoot()) {
+      path = io ? "/proc/pressure/io" : "/proc/pressure/memory";
+    } else {
+      path = cgroup.absolutePath() + "/" +
+          (io ? Fs::kIoPressureFile : Fs::kMemPressureFile);
+    }
+    ret.emplace_back(std::move(path), line);
+  }
+  return ret;
+}
+
+void Oomd::armPressureTriggers() {
+  std::set<PressureTriggerSet::Trigger> wanted;
+  for (const auto& trigger : engine_->pressureTriggers()) {
+    auto resolved = resolvePressureTrigger(trigger);
+    wanted.insert(resolved.begin(), resolved.end());
+  }
+  pressure_triggers_.update(wanted);
+}
+
+void Oomd::runInterval() {
+  if (fs_drop_in_service_) {
+    fs_drop_in_service_->updateDropIns();
+  }
+
+  updateContext();
+  armPressureTriggers();
+
+  // Prerun all the plugins
+  engine_->prerun(ctx_);
+
+  // Run all the plugins
+  engine_->runOnce(ctx_);
+}
+
+void Oomd::runTriggered(const std::set<PressureTriggerSet::Trigger>& fired) {
+  ::Oomd::incrementStat(CoreStats::kPressureTriggerWakeups, 1);
+
+  // Everything counted in ticks, eg. rates, decays or plugins' own interval
+  // counters, must only advance once per interval. So only pressure is
+  // re-read, and only rulesets whose triggers fired run.
+  ctx_.refreshPressure();
+  engine_->runTriggered(ctx_, [&](const PressureTrigger& trigger) {
+    for (const auto& resolved : resolvePressureTrigger(trigger)) {
+      if (fired.count(resolved)) {
+        return true;
+      }
+    }
+    return false;
+  });
 }
 
 int Oomd::run() {
@@ -117,21 +190,28 @@ int Oomd::run() {
 
   OLOG << "Running oomd";
 
+  // Triggers are checked over 1s windows, and may wake us up every window
+  // while pressure lasts. Don't run more often than that.
+  const auto min_interval =
+      std::min<std::chrono::steady_clock::duration>(kMinInterval, interval_);
+  auto last_run = std::chrono::steady_clock::now();
+  auto next_interval = last_run + interval_;
+
   while (true) {
     /* sleep override */
-    std::this_thread::sleep_for(interval_);
-
-    if (fs_drop_in_service_) {
-      fs_drop_in_service_->updateDropIns();
+    std::this_thread::sleep_until(last_run + min_interval);
+    auto fired = pressure_triggers_.wait(next_interval);
+    last_run = std::chrono::steady_clock::now();
+
+    // Triggers firing back to back must not hold intervals off
+    if (last_run < next_interval) {
+      if (fired.size()) {
+        runTriggered(fired);
+      }
+      continue;
     }
-
-    updateContext();
-
-    // Prerun all the plugins
-    engine_->prerun(ctx_);
-
-    // Run all the plugins
-    engine_->runOnce(ctx_);
+    next_interval = last_run + interval_;
+    runInterval();
   }
 
   return 0;
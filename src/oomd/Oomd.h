@@ -19,10 +19,13 @@
 
 #include <chrono>
 #include <memory>
+#include <set>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "oomd/OomdContext.h"
+#include "oomd/util/PressureTriggerSet.h"
 
 namespace Oomd {
 
@@ -42,15 +45,26 @@ class Oomd {
       int interval,
       const std::string& cgroup_fs,
       const std::string& drop_in_dir,
-      const std::unordered_map<std::string, DeviceType>& io_devs = {},
-      const IOCostCoeffs& hdd_coeffs = {},
-      const IOCostCoeffs& ssd_coeffs = {});
+      const ContextParams& params = {});
   ~Oomd();
 
   void updateContext();
   int run();
 
  private:
+  // Test only
+  friend class TestHelper;
+
+  // Pressure files and trigger lines @param trigger arms
+  std::vector<PressureTriggerSet::Trigger> resolvePressureTrigger(
+      const PressureTrigger& trigger);
+  // Arms the PSI triggers detectors want on the cgroups they watch
+  void armPressureTriggers();
+  // Regular run, once every interval
+  void runInterval();
+  // Early run of the rulesets whose triggers in @param fired fired
+  void runTriggered(const std::set<PressureTriggerSet::Trigger>& fired);
+
   // runtime settings
   std::chrono::seconds interval_{0};
   std::unique_ptr<Config2::IR::Root> ir_root_;
@@ -58,6 +72,8 @@ class Oomd {
   std::unique_ptr<DropInServiceAdaptor> fs_drop_in_service_;
 
   OomdContext ctx_;
+  // Wake the main loop up ahead of the next interval
+  PressureTriggerSet pressure_triggers_;
 };
 
 } // namespace Oomd
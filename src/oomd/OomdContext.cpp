@@ -16,14 +16,122 @@
  */
 
 #include "oomd/OomdContext.h"
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
 #include <optional>
+#include <thread>
 
 #include "oomd/Log.h"
+#include "oomd/Stats.h"
 #include "oomd/engine/Engine.h"
+#include "oomd/include/CoreStats.h"
 #include "oomd/util/Fs.h"
 
+namespace {
+
+// Order of CgroupContext::TreeLinks::children
+bool nameLess(const Oomd::CgroupContext* ctx, const std::string& name) {
+  return ctx->cgroup().name() < name;
+}
+
+} // namespace
+
 namespace Oomd {
 
+/*
+ * Threads running prefetch() jobs alongside the calling one. Each job runs
+ * once on every thread, which pick their share of the work themselves.
+ */
+class OomdContext::PrefetchPool {
+ public:
+  explicit PrefetchPool(size_t threads) {
+    for (size_t i = 0; i < threads; ++i) {
+      threads_.emplace_back([this] { loop(); });
+    }
+  }
+
+  ~PrefetchPool() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  // Runs @param job on every thread, the calling one included, and returns
+  // once they are all done
+  void run(const std::function<void()>& job) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      job_ = &job;
+      running_ = threads_.size();
+      ++generation_;
+    }
+    wake_.notify_all();
+    job();
+    std::unique_lock<std::mutex> lock(lock_);
+    done_.wait(lock, [this] { return running_ == 0; });
+    job_ = nullptr;
+  }
+
+ private:
+  void loop() {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+      wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+      if (stopping_) {
+        return;
+      }
+      seen = generation_;
+      const auto* job = job_;
+      lock.unlock();
+      (*job)();
+      lock.lock();
+      if (--running_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+
+  std::mutex lock_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const std::function<void()>* job_{nullptr};
+  // Bumped for every job, so each thread runs it exactly once
+  uint64_t generation_{0};
+  size_t running_{0};
+  bool stopping_{false};
+  // Last, so the threads start once the rest is initialized
+  std::vector<std::thread> threads_;
+};
+
+OomdContext::OomdContext(const ContextParams& params) : params_(params) {
+  for (const auto& [dev_id, type] : params_.io_devs) {
+    auto dev = Fs::parseDevId(dev_id);
+    if (!dev) {
+      OLOG << "Ignoring invalid io device " << dev_id;
+      continue;
+    }
+    io_cost_devs_.push_back(IOCostDevice{
+        .dev = *dev,
+        .coeffs = type == DeviceType::SSD ? params_.ssd_coeffs
+                                          : params_.hdd_coeffs});
+  }
+}
+
+// Out of line, where PrefetchPool is complete
+OomdContext::~OomdContext() = default;
+OomdContext::OomdContext(OomdContext&& other) noexcept = default;
+OomdContext& OomdContext::operator=(OomdContext&& other) = default;
+
 std::vector<CgroupPath> OomdContext::cgroups() const {
   std::vector<CgroupPath> keys;
 
@@ -38,25 +146,69 @@ std::optional<OomdContext::ConstCgroupContextRef> OomdContext::addToCacheAndGet(
     const CgroupPath& cgroup) {
   // Return cached cgroup if already exists
   if (auto pos = cgroups_.find(cgroup); pos != cgroups_.end()) {
-    return pos->second;
+    return touch(pos->second);
   }
   if (auto ctx = CgroupContext::make(*this, cgroup)) {
-    return cgroups_.emplace(cgroup, std::move(*ctx)).first->second;
+    return insertCgroup(std::move(*ctx));
   }
   return std::nullopt;
 }
 
 std::vector<OomdContext::ConstCgroupContextRef> OomdContext::addToCacheAndGet(
     const std::unordered_set<CgroupPath>& cgroups) {
-  std::unordered_set<CgroupPath> all_resolved;
+  // Resolved dirs without a context yet come back already open, so new
+  // contexts adopt their fds. Cached ones, and memoized resolutions, have no
+  // fd and are looked up or opened by path.
+  std::unordered_map<CgroupPath, std::optional<Fs::DirFd>> all_resolved;
   std::vector<ConstCgroupContextRef> ret;
   for (const auto& cgroup : cgroups) {
-    auto resolved = cgroup.resolveWildcard();
-    all_resolved.insert(resolved.begin(), resolved.end());
+    if (auto memo = resolved_patterns_.find(cgroup);
+        memo != resolved_patterns_.end()) {
+      pattern_cache_hits_++;
+      for (const auto& resolved : memo->second) {
+        all_resolved.emplace(resolved, std::nullopt);
+      }
+      continue;
+    }
+    pattern_cache_misses_++;
+
+    // Failures aren't memoized, so the next lookup tries again
+    auto root = Fs::DirFd::open(cgroup.cgroupFs());
+    if (!root) {
+      OLOG << "Failed to open cgroup fs " << cgroup.cgroupFs() << ": "
+           << root.error().what();
+      continue;
+    }
+    auto dirs = Fs::resolveDirPatternAt(
+        *root,
+        cgroup.relativePath(),
+        [&](const std::vector<std::string>& parts) {
+          return !cgroups_.count(CgroupPath(cgroup.cgroupFs(), parts));
+        });
+    if (!dirs) {
+      OLOG << "Failed to resolve " << cgroup.absolutePath() << ": "
+           << dirs.error().what();
+      continue;
+    }
+    auto& memo = resolved_patterns_[cgroup];
+    for (auto& dir : *dirs) {
+      CgroupPath resolved(cgroup.cgroupFs(), std::move(dir.parts));
+      memo.push_back(resolved);
+      all_resolved.emplace(std::move(resolved), std::move(dir.fd));
+    }
   }
-  for (const auto& resolved : all_resolved) {
-    if (auto cgroup_ctx = addToCacheAndGet(resolved)) {
-      ret.push_back(*cgroup_ctx);
+  for (auto& [resolved, fd] : all_resolved) {
+    if (!fd) {
+      if (auto cgroup_ctx = addToCacheAndGet(resolved)) {
+        ret.push_back(*cgroup_ctx);
+      }
+      continue;
+    }
+    if (auto pos = cgroups_.find(resolved); pos != cgroups_.end()) {
+      ret.push_back(touch(pos->second));
+    } else {
+      ret.push_back(insertCgroup(
+          CgroupContext::make(*this, resolved, std::move(*fd))));
     }
   }
   return ret;
@@ -66,11 +218,21 @@ std::optional<OomdContext::ConstCgroupContextRef>
 OomdContext::addChildToCacheAndGet(
     const CgroupContext& cgroup_ctx,
     const std::string& child) {
+  const auto& siblings = cgroup_ctx.tree_.children;
+  auto it = std::lower_bound(siblings.begin(), siblings.end(), child, nameLess);
+  if (it != siblings.end() &&
+      (*it)->cgroup().name() == child) {
+    return touch(**it);
+  }
+
+  // May have been cached through its path before its parent was
+  if (auto pos = cgroups_.find(cgroup_ctx.cgroup().getChild(child));
+      pos != cgroups_.end()) {
+    linkCgroup(cgroup_ctx, pos->second);
+    return touch(pos->second);
+  }
   if (auto child_ctx = cgroup_ctx.createChildCgroupCtx(child)) {
-    const CgroupPath& child_path = child_ctx->cgroup();
-    const auto& pair = cgroups_.emplace(child_path, std::move(*child_ctx));
-    return std::make_optional<OomdContext::ConstCgroupContextRef>(
-        pair.first->second);
+    return insertCgroup(std::move(*child_ctx), &cgroup_ctx);
   } else {
     OLOG << "failed to get child of " << cgroup_ctx.cgroup().relativePath()
          << " named " << child;
@@ -83,8 +245,9 @@ OomdContext::addChildrenToCacheAndGet(const CgroupContext& cgroup_ctx) {
   std::vector<OomdContext::ConstCgroupContextRef> ret;
 
   CgroupContext::Error err;
-  std::unordered_set<Oomd::CgroupPath> child_paths;
-  if (auto children = cgroup_ctx.children(&err)) {
+  if (const auto& children = cgroup_ctx.children(&err)) {
+    // Children cached in an earlier interval are found in the tree, so only
+    // new ones need their dir opened
     for (const auto& name : *children) {
       if (const auto& child_ctx = addChildToCacheAndGet(cgroup_ctx, name)) {
         ret.push_back(*child_ctx);
@@ -101,6 +264,90 @@ OomdContext::addChildrenToCacheAndGet(const CgroupContext& cgroup_ctx) {
   return ret;
 }
 
+std::optional<OomdContext::ConstCgroupContextRef>
+OomdContext::addParentToCacheAndGet(const CgroupContext& cgroup_ctx) {
+  if (cgroup_ctx.tree_.parent) {
+    return touch(*cgroup_ctx.tree_.parent);
+  }
+  if (cgroup_ctx.cgroup().isRoot()) {
+    return std::nullopt;
+  }
+  auto parent_ctx = addToCacheAndGet(cgroup_ctx.cgroup().getParent());
+  if (parent_ctx) {
+    linkCgroup(*parent_ctx, cgroup_ctx);
+  }
+  return parent_ctx;
+}
+
+std::optional<OomdContext::ConstCgroupContextRef> OomdContext::getCgroupById(
+    CgroupContext::Id id) const {
+  if (auto pos = cgroups_by_id_.find(id); pos != cgroups_by_id_.end()) {
+    return touch(*pos->second);
+  }
+  return std::nullopt;
+}
+
+CgroupContext& OomdContext::insertCgroup(
+    CgroupContext&& cgroup_ctx,
+    const CgroupContext* parent) {
+  auto [pos, inserted] =
+      cgroups_.emplace(cgroup_ctx.cgroup(), std::move(cgroup_ctx));
+  auto& cached = pos->second;
+  if (!inserted) {
+    return cached;
+  }
+  cached.tree_.cached = true;
+  touch(cached);
+
+  if ((!parent || !parent->tree_.cached) && !cached.cgroup().isRoot()) {
+    parent = nullptr;
+    if (auto parent_pos = cgroups_.find(cached.cgroup().getParent());
+        parent_pos != cgroups_.end()) {
+      parent = &parent_pos->second;
+    }
+  }
+  if (parent) {
+    linkCgroup(*parent, cached);
+  }
+  if (auto id = cached.id()) {
+    // A stale context may still hold a reused inode, newest wins
+    cgroups_by_id_[*id] = &cached;
+    cached.tree_.id = id;
+  }
+  return cached;
+}
+
+void OomdContext::linkCgroup(
+    const CgroupContext& parent,
+    const CgroupContext& child) {
+  // Contexts outside the cache may go away at any time
+  if (child.tree_.parent || !parent.tree_.cached || !child.tree_.cached) {
+    return;
+  }
+  child.tree_.parent = &parent;
+  const auto& name = child.cgroup().name();
+  auto& siblings = parent.tree_.children;
+  siblings.insert(
+      std::lower_bound(siblings.begin(), siblings.end(), name, nameLess),
+      &child);
+}
+
+void OomdContext::unlinkCgroup(const CgroupContext& cgroup_ctx) {
+  if (const auto* parent = cgroup_ctx.tree_.parent) {
+    auto& siblings = parent->tree_.children;
+    siblings.erase(std::find(siblings.begin(), siblings.end(), &cgroup_ctx));
+  }
+  for (const auto* child : cgroup_ctx.tree_.children) {
+    child->tree_.parent = nullptr;
+  }
+  if (const auto& id = cgroup_ctx.tree_.id) {
+    if (auto pos = cgroups_by_id_.find(*id);
+        pos != cgroups_by_id_.end() && pos->second == &cgroup_ctx) {
+      cgroups_by_id_.erase(pos);
+    }
+  }
+}
+
 const ActionContext& OomdContext::getActionContext() const {
   return action_context_;
 }
@@ -168,12 +415,14 @@ void OomdContext::dump(
 
     if (skip_negligible) {
       // don't show if <1% pressure && <.1% usage
-      auto meminfo = Fs::getMeminfo();
+      const auto& meminfo = cgroup_ctx.oomd_ctx().getSystemContext().meminfo;
       // TODO(dschatzberg) report error
-      if (meminfo) {
+      if (!meminfo.empty()) {
         const float press_min = 1;
-        const int64_t mem_min = (*meminfo)["MemTotal"] / 1000;
-        const int64_t swap_min = (*meminfo)["SwapTotal"] / 1000;
+        const int64_t mem_min =
+            meminfo.count("MemTotal") ? meminfo.at("MemTotal") / 1000 : 0;
+        const int64_t swap_min =
+            meminfo.count("SwapTotal") ? meminfo.at("SwapTotal") / 1000 : 0;
 
         if (!(mem_pressure.sec_10 >= press_min ||
               mem_pressure.sec_60 >= press_min ||
@@ -209,11 +458,256 @@ void OomdContext::dump(
   }
 }
 
+void OomdContext::prefetch(const std::vector<DataDependency>& deps) {
+  auto threads = static_cast<size_t>(
+      std::max<int64_t>(params_.prefetch_threads, 0));
+  if (threads == 0 || deps.empty()) {
+    return;
+  }
+
+  // Resolve on this thread, as it may add to the cache, then merge what's
+  // read of each cgroup so every one is only visited once
+  std::vector<std::pair<const CgroupContext*, uint16_t>> work;
+  std::unordered_map<const CgroupContext*, size_t> index;
+  auto add = [&](const CgroupContext& cgroup_ctx, uint16_t reads) {
+    auto [it, inserted] = index.try_emplace(&cgroup_ctx, work.size());
+    if (inserted) {
+      work.emplace_back(&cgroup_ctx, 0);
+    }
+    work[it->second].second |= reads;
+  };
+  for (const auto& dep : deps) {
+    if (dep.reads == 0) {
+      continue;
+    }
+    auto unvisited = addToCacheAndGet(dep.cgroups);
+    while (!unvisited.empty()) {
+      const CgroupContext& cgroup_ctx = unvisited.back();
+      unvisited.pop_back();
+      if (dep.recursive && !cgroup_ctx.oom_group().value_or(false)) {
+        auto children = addChildrenToCacheAndGet(cgroup_ctx);
+        std::move(
+            children.begin(), children.end(), std::back_inserter(unvisited));
+      }
+      add(cgroup_ctx, dep.reads);
+    }
+  }
+  threads = std::min(threads, work.size());
+
+  std::atomic<size_t> next{0};
+  std::function<void()> worker = [&]() {
+    for (size_t i = next++; i < work.size(); i = next++) {
+      try {
+        work[i].first->prefetch(work[i].second);
+      } catch (const std::exception&) {
+        // Whatever failed is left unread, so its first use on the main
+        // thread fails the same way and is handled there
+      }
+    }
+  };
+  if (threads <= 1) {
+    worker();
+    return;
+  }
+  // Sized for the most work there can be, as threads without any are cheap
+  if (!prefetch_pool_) {
+    prefetch_pool_ = std::make_unique<PrefetchPool>(
+        static_cast<size_t>(params_.prefetch_threads) - 1);
+  }
+  prefetch_pool_->run(worker);
+}
+
 void OomdContext::refresh() {
+  resolved_patterns_.clear();
+  if (pattern_cache_hits_ || pattern_cache_misses_) {
+    Oomd::incrementStat(CoreStats::kPatternCacheHits, pattern_cache_hits_);
+    Oomd::incrementStat(CoreStats::kPatternCacheMisses, pattern_cache_misses_);
+    pattern_cache_hits_ = 0;
+    pattern_cache_misses_ = 0;
+  }
+
+  drainCgroupEvents();
+  validity_sweep_ = params_.validity_sweep_ticks > 0 &&
+      current_tick_ % params_.validity_sweep_ticks == 0;
+  config_refresh_ = params_.config_refresh_ticks > 0 &&
+      current_tick_ % params_.config_refresh_ticks == 0;
+
+  uint64_t evicted = 0;
   auto it = cgroups_.begin();
   while (it != cgroups_.end()) {
-    it = it->second.refresh() ? std::next(it) : cgroups_.erase(it);
+    bool idle = isIdle(it->second);
+    if (!idle && it->second.refresh()) {
+      ++it;
+    } else {
+      evicted += idle;
+      unlinkCgroup(it->second);
+      it = cgroups_.erase(it);
+    }
+  }
+  if (evicted) {
+    Oomd::incrementStat(CoreStats::kCgroupCacheEvictions, evicted);
+  }
+}
+
+void OomdContext::refreshPressure() {
+  // The root cgroup reads these snapshots
+  if (system_ctx_.mem_pressure) {
+    auto mem_pressure = Fs::readRootMempressureRecord();
+    system_ctx_.mem_pressure =
+        mem_pressure ? std::make_optional(*mem_pressure) : std::nullopt;
+  }
+  if (system_ctx_.io_pressure) {
+    auto io_pressure = Fs::readRootIopressureRecord();
+    system_ctx_.io_pressure =
+        io_pressure ? std::make_optional(*io_pressure) : std::nullopt;
+  }
+  for (auto& pair : cgroups_) {
+    pair.second.refreshPressure();
+  }
+}
+
+bool OomdContext::isIdle(const CgroupContext& cgroup_ctx) const {
+  if (params_.cache_idle_ticks <= 0) {
+    return false;
+  }
+  // Give history at least as many idle ticks as it has samples before it's
+  // dropped along with the cgroup
+  auto limit = std::max(params_.cache_idle_ticks, params_.history_samples);
+  return current_tick_ - cgroup_ctx.tree_.last_access >=
+      static_cast<uint64_t>(limit);
+}
+
+bool OomdContext::reserveControlFileFd() {
+  const auto budget =
+      static_cast<size_t>(std::max<int64_t>(params_.cgroup_fd_budget, 0));
+  auto& in_use = control_fds_in_use_.value;
+  auto cur = in_use.load(std::memory_order_relaxed);
+  do {
+    if (cur >= budget) {
+      return false;
+    }
+  } while (!in_use.compare_exchange_weak(
+      cur, cur + 1, std::memory_order_relaxed));
+  return true;
+}
+
+int OomdContext::addCgroupWatch(const Fs::DirFd& dirfd, bool parent) {
+  // Watch through the fd rather than the cgroup path, which may already
+  // belong to a recreated cgroup of the same name
+  auto fd_path = "/proc/self/fd/" + std::to_string(dirfd.fd());
+  if (parent) {
+    fd_path += "/..";
+  }
+  // Same mask for every watch, as a cgroup's own watch is also the parent
+  // watch of its children. No IN_MODIFY: kernfs_notify() reports every update
+  // to cgroup.events, memory.events and the like as one, and under memory
+  // pressure these would flood the queue.
+  return addWatch(fd_path, IN_ATTRIB | IN_CREATE | IN_DELETE | IN_ONLYDIR);
+}
+
+int OomdContext::addConfigWatch(const Fs::DirFd& dirfd, const char* file) {
+  auto fd_path = "/proc/self/fd/" + std::to_string(dirfd.fd()) + "/" + file;
+  return addWatch(fd_path, IN_MODIFY);
+}
+
+int OomdContext::addWatch(const std::string& path, uint32_t mask) {
+  // May be a new reference to an existing watch, but that takes a syscall to
+  // find out
+  if (cgroup_watches_.size() >=
+      static_cast<size_t>(std::max<int64_t>(params_.cgroup_watch_budget, 0))) {
+    return -1;
+  }
+  if (cgroup_watch_fd_.fd() < 0) {
+    int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+      return -1;
+    }
+    cgroup_watch_fd_ = Fs::Fd(fd);
   }
+  int wd = ::inotify_add_watch(cgroup_watch_fd_.fd(), path.c_str(), mask);
+  if (wd >= 0) {
+    cgroup_watches_[wd]++;
+  }
+  return wd;
+}
+
+void OomdContext::removeCgroupWatch(int wd) {
+  auto it = cgroup_watches_.find(wd);
+  if (it == cgroup_watches_.end() || --it->second > 0) {
+    return;
+  }
+  cgroup_watches_.erase(it);
+  watches_freed_++;
+  ::inotify_rm_watch(cgroup_watch_fd_.fd(), wd);
+}
+
+uint8_t OomdContext::getCgroupEvents(int wd) const {
+  auto it = cgroup_events_.find(wd);
+  return all_cgroup_events_ | (it == cgroup_events_.end() ? 0 : it->second);
+}
+
+uint8_t OomdContext::getChildCgroupEvents(int wd, const std::string& name)
+    const {
+  // Anything that may have hidden a removal from the parent watch counts
+  uint8_t events = getCgroupEvents(wd) & CGROUP_RECHECK;
+  auto it = removed_children_.find(wd);
+  if (it != removed_children_.end() && it->second.count(name)) {
+    events |= CGROUP_RECHECK;
+  }
+  return events;
+}
+
+void OomdContext::drainCgroupEvents() {
+  cgroup_events_.clear();
+  removed_children_.clear();
+  all_cgroup_events_ = 0;
+  if (cgroup_watch_fd_.fd() < 0) {
+    return;
+  }
+
+  alignas(struct inotify_event) char buf[4096];
+  while (true) {
+    auto len = ::read(cgroup_watch_fd_.fd(), buf, sizeof(buf));
+    if (len <= 0) {
+      // EAGAIN, nothing more queued
+      return;
+    }
+    for (char* p = buf; p < buf + len;) {
+      const auto* event = reinterpret_cast<struct inotify_event*>(p);
+      p += sizeof(struct inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        all_cgroup_events_ =
+            CGROUP_ATTRIB | CGROUP_RECHECK | CGROUP_MODIFY | CGROUP_CHILDREN;
+      } else if (event->mask & IN_IGNORED) {
+        // Kernel dropped the watch, so it has no references left
+        if (cgroup_watches_.erase(event->wd)) {
+          watches_freed_++;
+        }
+        cgroup_events_[event->wd] |= CGROUP_ATTRIB | CGROUP_RECHECK |
+            CGROUP_MODIFY | CGROUP_CHILDREN;
+      } else if (event->len == 0) {
+        if (event->mask & IN_ATTRIB) {
+          cgroup_events_[event->wd] |= CGROUP_ATTRIB;
+        }
+        // Only config file watches ask for IN_MODIFY
+        if (event->mask & IN_MODIFY) {
+          cgroup_events_[event->wd] |= CGROUP_MODIFY;
+        }
+      } else if (event->mask & IN_ISDIR) {
+        cgroup_events_[event->wd] |= CGROUP_CHILDREN;
+        if (event->mask & IN_DELETE) {
+          removed_children_[event->wd].emplace(event->name);
+        }
+      }
+    }
+  }
+}
+
+void OomdContext::releaseControlFileFds(size_t count) {
+  // Only called from the main thread, never during prefetch()
+  auto& in_use = control_fds_in_use_.value;
+  in_use -= std::min(count, in_use.load());
 }
 
 void OomdContext::setPrekillHooksHandler(
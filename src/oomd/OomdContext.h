@@ -19,6 +19,7 @@
 
 #include <sys/types.h>
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -28,6 +29,7 @@
 #include <vector>
 
 #include "oomd/CgroupContext.h"
+#include "oomd/PluginConstructionContext.h"
 #include "oomd/include/CgroupPath.h"
 #include "oomd/include/Types.h"
 
@@ -48,13 +50,40 @@ struct ActionContext {
 };
 
 struct ContextParams {
-  // TODO(dlxu): migrate to ring buffer for raw datapoints so plugins
-  // can calculate weighted average themselves
+  // average_usage and the moving averages of CgroupContext::history() keep
+  // (decay - 1) / decay of their previous value every interval
   double average_size_decay{4.0};
   // root io device IDs (<major>:<minor>) and their device types (SSD/HDD)
   std::unordered_map<std::string, DeviceType> io_devs;
   IOCostCoeffs hdd_coeffs;
   IOCostCoeffs ssd_coeffs;
+  // Max number of cgroup control file fds kept open across intervals. Reads
+  // beyond the budget open and close the file each time. 0 disables reuse.
+  int64_t cgroup_fd_budget{1024};
+  // Max number of inotify watches on cgroup dirs and config files. They come
+  // out of fs.inotify.max_user_watches, which every process of the user
+  // shares. Cgroups without a watch are polled instead, and config files
+  // without one re-read every tick. 0 disables watches.
+  int64_t cgroup_watch_budget{8192};
+  // Cgroup creation and removal are noticed through inotify. Every this many
+  // ticks, all cgroups are checked and their children listed anyway, in case
+  // an event was missed. 0 disables it.
+  int64_t validity_sweep_ticks{60};
+  // Cgroup configuration (memory.low, memory.max, kill preference xattrs...)
+  // is kept across ticks until inotify reports a write. This takes an inotify
+  // watch per config file read. Every this many ticks it's re-read anyway.
+  // 0 disables it.
+  int64_t config_refresh_ticks{30};
+  // Number of past samples of each cgroup counter kept for
+  // CgroupContext::history(). 0 disables it.
+  int64_t history_samples{0};
+  // Threads prefetch() reads cgroup data on, counting the calling one. 0
+  // disables prefetching, leaving every read to first use.
+  int64_t prefetch_threads{4};
+  // Cached cgroups no lookup returned for this many ticks are dropped, rather
+  // than refreshed every tick for nobody. With history_samples set, they're
+  // kept until their history has aged out too. 0 disables it.
+  int64_t cache_idle_ticks{0};
 };
 
 class OomdContext {
@@ -63,10 +92,10 @@ class OomdContext {
   // valid for the interval being accessed. Plugins should never store it.
   using ConstCgroupContextRef = std::reference_wrapper<const CgroupContext>;
 
-  explicit OomdContext(const ContextParams& params = {}) : params_(params) {}
-  ~OomdContext() = default;
-  OomdContext(OomdContext&& other) noexcept = default;
-  OomdContext& operator=(OomdContext&& other) = default;
+  explicit OomdContext(const ContextParams& params = {});
+  ~OomdContext();
+  OomdContext(OomdContext&& other) noexcept;
+  OomdContext& operator=(OomdContext&& other);
 
   std::vector<CgroupPath> cgroups() const;
 
@@ -74,6 +103,11 @@ class OomdContext {
     return params_;
   }
 
+  // ContextParams::io_devs resolved to dev_t with their coefficients bound
+  const std::vector<IOCostDevice>& getIoCostDevices() const {
+    return io_cost_devs_;
+  }
+
   /*
    * Add a cgroup to cache if not already exist, and return the result. If it's
    * invalid, return std::nullopt.
@@ -85,6 +119,9 @@ class OomdContext {
    * Add a set of cgroups to cache if not already exist, and return the result.
    * Cgroup paths may contain glob pattern, which will be expanded if valid.
    * Returned CgroupContexts are all valid and won't contain duplicate.
+   *
+   * Patterns are only resolved once per interval. Cgroups created after the
+   * first resolution show up after the next refresh().
    */
   std::vector<ConstCgroupContextRef> addToCacheAndGet(
       const std::unordered_set<CgroupPath>& cgroups);
@@ -102,6 +139,20 @@ class OomdContext {
   std::vector<ConstCgroupContextRef> addChildrenToCacheAndGet(
       const CgroupContext& cgroup_ctx);
 
+  /*
+   * Get parent of cgroup, adding it to the cache if it doesn't exist yet.
+   * Cached cgroups are linked to their cached parent and children, so this
+   * only goes through the parent's path the first time.
+   */
+  std::optional<ConstCgroupContextRef> addParentToCacheAndGet(
+      const CgroupContext& cgroup_ctx);
+
+  /*
+   * Get a cached cgroup by CgroupContext::id(). Never adds to the cache.
+   */
+  std::optional<ConstCgroupContextRef> getCgroupById(
+      CgroupContext::Id id) const;
+
   /*
    * Add a set of cgroups to cache, and return the resulting CgroupContext
    * sorting in descending order by the get_key functor, which accepts a const
@@ -183,16 +234,148 @@ class OomdContext {
               const CgroupContext& cgroup_ctx)> prekill_hook_handler);
 
   /*
-   * Refresh all cgroups and remove ones no longer exist.
+   * Refresh all cgroups and remove ones no longer exist, or idle for
+   * ContextParams::cache_idle_ticks.
    */
   void refresh();
 
+  /*
+   * Re-reads pressure already read this interval, system wide and of cached
+   * cgroups, for runs between intervals. Nothing else is refreshed, and the
+   * tick stays the same.
+   */
+  void refreshPressure();
+
+  /*
+   * Reads @param deps ahead of use, in parallel. Cgroups are resolved, and
+   * added to the cache, on the calling thread first. Anything not prefetched
+   * is still read on first use. The other threads are started on first use
+   * and kept until the context goes away.
+   */
+  void prefetch(const std::vector<DataDependency>& deps);
+
+  /*
+   * Used by CgroupContext to account its cached control file fds against
+   * ContextParams::cgroup_fd_budget. reserveControlFileFd() returns false if
+   * the budget is exhausted, in which case the fd must not be kept.
+   */
+  bool reserveControlFileFd();
+  void releaseControlFileFds(size_t count);
+
+  /*
+   * Used by CgroupContext to learn about changes to its cgroup without polling.
+   * Every watched dir shares one inotify instance, which is drained once per
+   * refresh(). addCgroupWatch() returns -1 if no watch could be set up, in
+   * which case the caller has to poll.
+   *
+   * A cgroup's own watch reports xattr changes, and children being created
+   * or removed. Its removal only shows up on its parent's watch, as the dir
+   * can't emit IN_DELETE_SELF while its CgroupContext holds it open. Pass
+   * @param parent to watch the parent of @param dirfd. Watches of the same
+   * inode share a descriptor and are reference counted.
+   *
+   * Writes to configuration files are reported by addConfigWatch(), one
+   * watch per @param file in @param dirfd. Watching the dir for IN_MODIFY
+   * would be one watch instead of up to six, but would also wake up on every
+   * kernel update to memory.events, cgroup.events and the like. Those come
+   * in bursts exactly when memory is tight, and an overflowed queue makes
+   * every cgroup recheck and re-read everything.
+   */
+  enum CgroupEvent : uint8_t {
+    // xattrs may have changed
+    CGROUP_ATTRIB = 1,
+    // cgroup may be gone and should be checked with Fs::isCgroupValid()
+    CGROUP_RECHECK = 1 << 1,
+    // Config file watched by the wd may have been written
+    CGROUP_MODIFY = 1 << 2,
+    // Children may have been created or removed
+    CGROUP_CHILDREN = 1 << 3,
+  };
+  int addCgroupWatch(const Fs::DirFd& dirfd, bool parent = false);
+  int addConfigWatch(const Fs::DirFd& dirfd, const char* file);
+  void removeCgroupWatch(int wd);
+  // False once the kernel dropped @param wd
+  bool isCgroupWatched(int wd) const {
+    return cgroup_watches_.count(wd);
+  }
+  // Bumped whenever a watch goes away. A failed add is only worth retrying
+  // once it has changed.
+  uint64_t getWatchesFreed() const {
+    return watches_freed_;
+  }
+  // CgroupEvent bits for the dir watched by @param wd
+  uint8_t getCgroupEvents(int wd) const;
+  // CgroupEvent bits for child @param name of the dir watched by @param wd
+  uint8_t getChildCgroupEvents(int wd, const std::string& name) const;
+  // Whether cgroups should be checked even without a CGROUP_RECHECK event
+  bool isValiditySweep() const {
+    return validity_sweep_;
+  }
+  // Whether cgroup configuration should be re-read even without events
+  bool isConfigRefresh() const {
+    return config_refresh_;
+  }
+
  private:
+  class PrefetchPool;
+
+  int addWatch(const std::string& path, uint32_t mask);
+  void drainCgroupEvents();
+
+  // Adds @param cgroup_ctx to cgroups_ unless its path is already cached, and
+  // links it to its parent. Pass @param parent if already known.
+  CgroupContext& insertCgroup(
+      CgroupContext&& cgroup_ctx,
+      const CgroupContext* parent = nullptr);
+  static void linkCgroup(
+      const CgroupContext& parent,
+      const CgroupContext& child);
+  void unlinkCgroup(const CgroupContext& cgroup_ctx);
+  // Marks @param cgroup_ctx as used this tick and returns it
+  const CgroupContext& touch(const CgroupContext& cgroup_ctx) const {
+    cgroup_ctx.tree_.last_access = current_tick_;
+    return cgroup_ctx;
+  }
+  bool isIdle(const CgroupContext& cgroup_ctx) const;
+
   // Test only
   friend class TestHelper;
 
   struct ContextParams params_;
+  std::vector<IOCostDevice> io_cost_devs_;
+  // Declared before cgroups_ so they outlive the CgroupContexts using them
+  // Also counted from prefetch() threads. Wrapped to keep OomdContext
+  // movable.
+  struct FdCount {
+    std::atomic<size_t> value{0};
+
+    FdCount() = default;
+    FdCount(FdCount&& other) noexcept : value(other.value.load()) {}
+    FdCount& operator=(FdCount&& other) noexcept {
+      value = other.value.load();
+      return *this;
+    }
+  };
+  FdCount control_fds_in_use_;
+  Fs::Fd cgroup_watch_fd_;
+  // Reference count of each watch descriptor
+  std::unordered_map<int, size_t> cgroup_watches_;
+  uint64_t watches_freed_{0};
+  // Events collected by the last refresh()
+  std::unordered_map<int, uint8_t> cgroup_events_;
+  std::unordered_map<int, std::unordered_set<std::string>> removed_children_;
+  // Set if events were lost, applies to every watch
+  uint8_t all_cgroup_events_{0};
+  bool validity_sweep_{true};
+  bool config_refresh_{true};
   std::unordered_map<CgroupPath, CgroupContext> cgroups_;
+  // Secondary index of cgroups_, see CgroupContext::TreeLinks
+  std::unordered_map<CgroupContext::Id, const CgroupContext*> cgroups_by_id_;
+  // Pattern resolutions of the current interval, cleared by refresh()
+  std::unordered_map<CgroupPath, std::vector<CgroupPath>> resolved_patterns_;
+  int pattern_cache_hits_{0};
+  int pattern_cache_misses_{0};
+  std::unique_ptr<PrefetchPool> prefetch_pool_;
   ActionContext action_context_;
   SystemContext system_ctx_;
   uint64_t current_tick_{0};
@@ -15,9 +15,11 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <unistd.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "oomd/CgroupSnapshot.h"
 #include "oomd/OomdContext.h"
 #include "oomd/util/Fixture.h"
 #include "oomd/util/TestHelper.h"
@@ -61,7 +63,7 @@ TEST_F(OomdContextTest, MoveConstructor) {
       other,
       path,
       TestHelper::CgroupData{
-          .current_usage = 1, .memory_low = 2, .average_usage = 3});
+          .current_usage = 1, .average_usage = 3, .memory_low = 2});
 
   ctx = std::move(other);
 
@@ -174,3 +176,255 @@ TEST_F(OomdContextTest, SortContext) {
 
   EXPECT_THAT(sorted, ElementsAre(*cg2, *cg4, *cg3, *cg1));
 }
+
+/*
+ * Verify snapshots fill only the requested columns and rank the same as the
+ * accessor based sort, ties included.
+ */
+TEST_F(OomdContextTest, SnapshotSort) {
+  std::vector<OomdContext::ConstCgroupContextRef> cgroups;
+  for (int i = 0; i < 40; ++i) {
+    auto name = "cg" + std::to_string(i);
+    F::materialize(F::makeDir(tempdir_, {F::makeDir(name)}));
+    CgroupPath path(tempdir_, name);
+    TestHelper::CgroupData data{
+        .kill_preference =
+            i % 5 ? KillPreference::NORMAL : KillPreference::PREFER};
+    // Leave some empty to check they read as 0, and repeat values so there
+    // are ties to break
+    if (i % 7) {
+      data.swap_usage = (i * 13) % 6;
+    }
+    TestHelper::setCgroupData(ctx, path, data);
+    auto cgroup_ctx = ctx.addToCacheAndGet(path);
+    ASSERT_TRUE(cgroup_ctx);
+    cgroups.push_back(*cgroup_ctx);
+  }
+
+  CgroupSnapshot snapshot(cgroups, CgroupSnapshot::SWAP_USAGE);
+  ASSERT_EQ(snapshot.size(), cgroups.size());
+  EXPECT_EQ(snapshot.swap_usage.size(), cgroups.size());
+  EXPECT_EQ(snapshot.kill_preference.size(), cgroups.size());
+  EXPECT_TRUE(snapshot.current_usage.empty());
+  EXPECT_TRUE(snapshot.mem_pressure.sec_10.empty());
+  EXPECT_EQ(snapshot.swap_usage[0], 0);
+  EXPECT_EQ(snapshot.swap_usage[1], 1);
+  EXPECT_EQ(snapshot.kill_preference[0], KillPreference::PREFER);
+
+  auto get_swap = [](const CgroupContext& cgroup_ctx) {
+    return cgroup_ctx.swap_usage().value_or(0);
+  };
+  EXPECT_EQ(
+      snapshot.sortDescWithKillPrefs(snapshot.rows(), snapshot.swap_usage),
+      OomdContext::sortDescWithKillPrefs(cgroups, get_swap));
+
+  auto swapping = snapshot.rows(
+      [&](uint32_t i) { return snapshot.swap_usage[i] >= 3; });
+  std::vector<OomdContext::ConstCgroupContextRef> swapping_cgroups;
+  for (auto row : swapping) {
+    swapping_cgroups.push_back(snapshot.cgroups()[row]);
+  }
+  EXPECT_EQ(
+      snapshot.sortDescWithKillPrefs(swapping, snapshot.swap_usage),
+      OomdContext::sortDescWithKillPrefs(swapping_cgroups, get_swap));
+}
+
+/*
+ * Verify removed cgroups are dropped from the cache without checking every
+ * cgroup every tick.
+ */
+TEST_F(OomdContextTest, CgroupValidity) {
+  ContextParams params;
+  params.validity_sweep_ticks = 2;
+  OomdContext ctx(params);
+  F::materialize(F::makeDir(
+      tempdir_,
+      {F::makeDir("A", {F::makeFile("cgroup.controllers")}),
+       F::makeDir("B", {F::makeFile("cgroup.controllers")})}));
+  ASSERT_TRUE(ctx.addToCacheAndGet(CgroupPath(tempdir_, "A")));
+  ASSERT_TRUE(ctx.addToCacheAndGet(CgroupPath(tempdir_, "B")));
+  ctx.refresh();
+  ctx.bumpCurrentTick();
+  EXPECT_EQ(ctx.cgroups().size(), 2);
+
+  // Removal is noticed through inotify on the next refresh
+  F::rmrChecked(tempdir_ + "/A");
+  ctx.refresh();
+  ctx.bumpCurrentTick();
+  EXPECT_THAT(ctx.cgroups(), ElementsAre(CgroupPath(tempdir_, "B")));
+  ctx.refresh();
+  ctx.bumpCurrentTick();
+
+  // Nothing watched changes when cgroup.controllers alone goes away (which
+  // cgroupfs never does), so only the periodic sweep sees it
+  ASSERT_EQ(::unlink((tempdir_ + "/B/cgroup.controllers").c_str()), 0);
+  ctx.refresh();
+  ctx.bumpCurrentTick();
+  EXPECT_EQ(ctx.cgroups().size(), 1);
+  ctx.refresh();
+  EXPECT_TRUE(ctx.cgroups().empty());
+}
+
+/*
+ * Verify prefetch() reads exactly what's declared, descending into children
+ * of recursive dependencies and merging reads of the same cgroup.
+ */
+TEST_F(OomdContextTest, Prefetch) {
+  ContextParams params;
+  params.prefetch_threads = 3;
+  OomdContext ctx(params);
+  std::unordered_map<std::string, F::DirEntry> children;
+  for (int i = 0; i < 8; ++i) {
+    children.insert(F::makeDir(
+        "cg" + std::to_string(i),
+        {F::makeFile("memory.current", std::to_string(i)),
+         F::makeFile("memory.swap.current", "1")}));
+  }
+  F::materialize(F::makeDir(tempdir_, {F::makeDir("parent", children)}));
+
+  CgroupPath parent(tempdir_, "parent");
+  CgroupPath cg0(tempdir_, "parent/cg0");
+  ctx.prefetch(
+      {{{parent}, true, CgroupContext::PREFETCH_CURRENT_USAGE},
+       {{cg0}, false, CgroupContext::PREFETCH_SWAP_USAGE}});
+
+  for (int i = 0; i < 8; ++i) {
+    auto path = CgroupPath(tempdir_, "parent/cg" + std::to_string(i));
+    const auto& cgroup_ctx = ASSERT_EXISTS(ctx.addToCacheAndGet(path)).get();
+    auto data = TestHelper::getData(cgroup_ctx);
+    EXPECT_EQ(data.current_usage, i);
+    if (i == 0) {
+      EXPECT_EQ(data.swap_usage, 1);
+    } else {
+      EXPECT_EQ(data.swap_usage, std::nullopt);
+    }
+  }
+
+  // Later intervals reuse the same threads
+  const auto* pool = TestHelper::getPrefetchPool(ctx);
+  ASSERT_NE(pool, nullptr);
+  for (int i = 0; i < 8; ++i) {
+    F::writeChecked(
+        tempdir_ + "/parent/cg" + std::to_string(i) + "/memory.current",
+        std::to_string(i * 10));
+  }
+  ctx.refresh();
+  ctx.prefetch({{{parent}, true, CgroupContext::PREFETCH_CURRENT_USAGE}});
+  EXPECT_EQ(TestHelper::getPrefetchPool(ctx), pool);
+  for (int i = 0; i < 8; ++i) {
+    auto path = CgroupPath(tempdir_, "parent/cg" + std::to_string(i));
+    const auto& cgroup_ctx = ASSERT_EXISTS(ctx.addToCacheAndGet(path)).get();
+    EXPECT_EQ(TestHelper::getData(cgroup_ctx).current_usage, i * 10);
+  }
+}
+
+/*
+ * Verify cgroups no lookup returned for cache_idle_ticks are evicted, and
+ * that history keeps them around longer.
+ */
+TEST_F(OomdContextTest, CacheIdleEviction) {
+  F::materialize(F::makeDir(
+      tempdir_,
+      {F::makeDir("A", {F::makeFile("cgroup.controllers")}),
+       F::makeDir("B", {F::makeFile("cgroup.controllers")})}));
+  CgroupPath a(tempdir_, "A");
+  CgroupPath b(tempdir_, "B");
+
+  for (int64_t history_samples : {0, 4}) {
+    ContextParams params;
+    params.cache_idle_ticks = 2;
+    params.history_samples = history_samples;
+    OomdContext ctx(params);
+    ASSERT_TRUE(ctx.addToCacheAndGet(a));
+    ASSERT_TRUE(ctx.addToCacheAndGet(b));
+
+    // Only A is looked up from now on
+    int64_t ticks_kept = 0;
+    while (ctx.cgroups().size() == 2 && ticks_kept < 10) {
+      ctx.refresh();
+      ctx.bumpCurrentTick();
+      ASSERT_TRUE(ctx.addToCacheAndGet(a));
+      ticks_kept++;
+    }
+    EXPECT_THAT(ctx.cgroups(), ElementsAre(a));
+    EXPECT_EQ(ticks_kept, std::max<int64_t>(2, history_samples) + 1);
+  }
+}
+
+/*
+ * Verify patterns are resolved once per interval.
+ */
+TEST_F(OomdContextTest, PatternMemoization) {
+  F::materialize(F::makeDir(tempdir_, {F::makeDir("A"), F::makeDir("B")}));
+  std::unordered_set<CgroupPath> pattern{CgroupPath(tempdir_, "*")};
+  EXPECT_EQ(ctx.addToCacheAndGet(pattern).size(), 2);
+
+  // New cgroups aren't seen until the next interval
+  F::materialize(F::makeDir(tempdir_, {F::makeDir("C")}));
+  EXPECT_EQ(ctx.addToCacheAndGet(pattern).size(), 2);
+  // Unless asked for with another pattern
+  EXPECT_EQ(
+      ctx.addToCacheAndGet(
+             std::unordered_set<CgroupPath>{CgroupPath(tempdir_, "C")})
+          .size(),
+      1);
+
+  ctx.refresh();
+  EXPECT_EQ(ctx.addToCacheAndGet(pattern).size(), 3);
+}
+
+/*
+ * Verify failed resolutions aren't memoized as empty.
+ */
+TEST_F(OomdContextTest, PatternFailureNotMemoized) {
+  auto cgroup_fs = tempdir_ + "/fs";
+  std::unordered_set<CgroupPath> pattern{CgroupPath(cgroup_fs, "*")};
+  EXPECT_EQ(ctx.addToCacheAndGet(pattern).size(), 0);
+
+  // Still the same interval, but the failure is retried
+  F::materialize(F::makeDir(cgroup_fs, {F::makeDir("A")}));
+  EXPECT_EQ(ctx.addToCacheAndGet(pattern).size(), 1);
+}
+
+/*
+ * Verify cached cgroups are linked to their relatives and indexed by id.
+ */
+TEST_F(OomdContextTest, CgroupTree) {
+  F::materialize(F::makeDir(
+      tempdir_,
+      {F::makeDir(
+          "A",
+          {F::makeFile("cgroup.controllers"),
+           F::makeDir("a1", {F::makeFile("cgroup.controllers")}),
+           F::makeDir("a2", {F::makeFile("cgroup.controllers")})})}));
+
+  // Child first, so the parent is linked up after the fact
+  auto a1 = ASSERT_EXISTS(ctx.addToCacheAndGet(CgroupPath(tempdir_, "A/a1")));
+  auto a = ASSERT_EXISTS(ctx.addParentToCacheAndGet(a1));
+  EXPECT_EQ(a.get().cgroup(), CgroupPath(tempdir_, "A"));
+  EXPECT_EQ(ASSERT_EXISTS(ctx.addToCacheAndGet(CgroupPath(tempdir_, "A"))), a);
+  EXPECT_EQ(ASSERT_EXISTS(ctx.addParentToCacheAndGet(a1)), a);
+
+  auto children = ctx.addChildrenToCacheAndGet(a);
+  ASSERT_EQ(children.size(), 2);
+  EXPECT_EQ(children[0], a1);
+  auto a2 = children[1];
+  EXPECT_EQ(a2.get().cgroup(), CgroupPath(tempdir_, "A/a2"));
+  EXPECT_EQ(ASSERT_EXISTS(ctx.addParentToCacheAndGet(a2)), a);
+  auto a2_id = ASSERT_EXISTS(a2.get().id());
+  EXPECT_EQ(ASSERT_EXISTS(ctx.getCgroupById(a2_id)), a2);
+
+  // Removed cgroups leave the tree and the index
+  F::rmrChecked(tempdir_ + "/A/a2");
+  ctx.refresh();
+  EXPECT_THAT(ctx.addChildrenToCacheAndGet(a), ElementsAre(a1));
+  EXPECT_EQ(ctx.getCgroupById(a2_id), std::nullopt);
+
+  // Contexts outside the cache are never linked
+  {
+    auto uncached = ASSERT_EXISTS(
+        CgroupContext::make(ctx, CgroupPath(tempdir_, "A/a1")));
+    EXPECT_EQ(ASSERT_EXISTS(ctx.addParentToCacheAndGet(uncached)), a);
+  }
+  EXPECT_THAT(ctx.addChildrenToCacheAndGet(a), ElementsAre(a1));
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <optional>
+#include <set>
+#include <vector>
+
+#include "oomd/Oomd.h"
+#include "oomd/config/ConfigTypes.h"
+#include "oomd/engine/Engine.h"
+#include "oomd/util/Fixture.h"
+#include "oomd/util/TestHelper.h"
+
+using namespace Oomd;
+using namespace std::chrono_literals;
+
+namespace {
+
+std::string pressureFile(float full_avg10) {
+  return "some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n"
+         "full avg10=" +
+      std::to_string(full_avg10) + " avg60=0.00 avg300=0.00 total=0\n";
+}
+
+// What a detector saw on one of its runs
+struct DetectorRun {
+  uint64_t tick;
+  std::optional<float> full_avg10;
+};
+
+class RecordingDetector : public Engine::BasePlugin {
+ public:
+  RecordingDetector(const CgroupPath& cgroup, std::vector<DetectorRun>& runs)
+      : cgroup_(cgroup), runs_(runs) {}
+
+  int init(
+      const Engine::PluginArgs& /* unused */,
+      const PluginConstructionContext& /* unused */) override {
+    return 0;
+  }
+
+  Engine::PluginRet run(OomdContext& ctx) override {
+    std::optional<float> full_avg10;
+    if (auto cgroup_ctx = ctx.addToCacheAndGet(cgroup_)) {
+      if (const auto& pressure = cgroup_ctx->get().mem_pressure()) {
+        full_avg10 = pressure->sec_10;
+      }
+    }
+    runs_.push_back(DetectorRun{ctx.getCurrentTick(), full_avg10});
+    return Engine::PluginRet::STOP;
+  }
+
+ private:
+  CgroupPath cgroup_;
+  std::vector<DetectorRun>& runs_;
+};
+
+} // namespace
+
+/*
+ * Drives the passes Oomd::run() loops over. Pressure files are faked with
+ * plain files, which trigger sets told to fire on POLLIN always report.
+ */
+class OomdTest : public ::testing::Test {
+ protected:
+  using F = Fixture;
+
+  void SetUp() override {
+    tempdir_ = F::mkdtempChecked();
+    F::materialize(F::makeDir(
+        tempdir_,
+        {F::makeDir(
+             "triggered", {F::makeFile("memory.pressure", pressureFile(0))}),
+         F::makeDir("other")}));
+    cgroup_ = CgroupPath(tempdir_, "triggered");
+  }
+
+  void TearDown() override {
+    F::rmrChecked(tempdir_);
+  }
+
+  std::unique_ptr<Engine::Ruleset> makeRuleset(
+      const std::string& name,
+      std::vector<DetectorRun>& runs,
+      std::vector<PressureTrigger> triggers) {
+    std::vector<std::unique_ptr<Engine::BasePlugin>> detectors;
+    detectors.emplace_back(std::make_unique<RecordingDetector>(cgroup_, runs));
+    std::vector<std::unique_ptr<Engine::DetectorGroup>> detector_groups;
+    detector_groups.emplace_back(std::make_unique<Engine::DetectorGroup>(
+        name + "_group", std::move(detectors)));
+    auto ruleset = std::make_unique<Engine::Ruleset>(
+        name,
+        std::move(detector_groups),
+        std::vector<std::unique_ptr<Engine::BasePlugin>>());
+    PluginConstructionContext::DataDependencies deps;
+    deps.pressure_triggers = std::move(triggers);
+    ruleset->setDataDependencies(std::move(deps), {});
+    return ruleset;
+  }
+
+  std::string tempdir_;
+  CgroupPath cgroup_{"/", "/"};
+};
+
+TEST_F(OomdTest, TriggeredRun) {
+  std::vector<DetectorRun> triggered_runs;
+  std::vector<DetectorRun> other_runs;
+  std::vector<std::unique_ptr<Engine::Ruleset>> rulesets;
+  rulesets.emplace_back(makeRuleset(
+      "triggered",
+      triggered_runs,
+      {PressureTrigger{
+          .cgroups = {cgroup_},
+          .resource = ResourceType::MEMORY,
+          .stall = 100ms,
+          .window = 1s}}));
+  // Triggers on a cgroup whose trigger never fires
+  rulesets.emplace_back(makeRuleset(
+      "other",
+      other_runs,
+      {PressureTrigger{
+          .cgroups = {CgroupPath(tempdir_, "other")},
+          .resource = ResourceType::MEMORY,
+          .stall = 100ms,
+          .window = 1s}}));
+  auto engine = std::make_unique<Engine::Engine>(
+      std::move(rulesets), std::vector<std::unique_ptr<Engine::PrekillHook>>());
+  ::Oomd::Oomd oomd(nullptr, std::move(engine), 5, tempdir_, "");
+  auto& triggers = TestHelper::getPressureTriggers(oomd);
+  triggers = PressureTriggerSet(POLLIN);
+  auto& ctx = TestHelper::getContext(oomd);
+
+  TestHelper::runInterval(oomd);
+  ASSERT_EQ(triggered_runs.size(), 1);
+  ASSERT_EQ(other_runs.size(), 1);
+  EXPECT_EQ(triggered_runs[0].tick, 1);
+  // Only the triggered cgroup has a pressure file to arm
+  ASSERT_EQ(triggers.size(), 1);
+
+  const auto pressure_path = cgroup_.absolutePath() + "/memory.pressure";
+  auto fired = triggers.wait(std::chrono::steady_clock::now() + 10s);
+  std::set<PressureTriggerSet::Trigger> expected = {
+      {pressure_path, "full 100000 1000000"}};
+  ASSERT_EQ(fired, expected);
+
+  // Arming overwrote the fake pressure file, fill it again
+  F::writeChecked(pressure_path, pressureFile(20));
+  TestHelper::runTriggered(oomd, fired);
+  F::writeChecked(pressure_path, pressureFile(40));
+  TestHelper::runTriggered(oomd, fired);
+
+  // Only the triggered ruleset ran, and the tick didn't move
+  EXPECT_EQ(ctx.getCurrentTick(), 1);
+  EXPECT_EQ(other_runs.size(), 1);
+  ASSERT_EQ(triggered_runs.size(), 3);
+  EXPECT_EQ(triggered_runs[1].tick, 1);
+  EXPECT_EQ(triggered_runs[1].full_avg10, 20);
+  // Pressure is re-read on every triggered run
+  EXPECT_EQ(triggered_runs[2].tick, 1);
+  EXPECT_EQ(triggered_runs[2].full_avg10, 40);
+
+  F::writeChecked(pressure_path, pressureFile(0));
+  TestHelper::runInterval(oomd);
+  EXPECT_EQ(ctx.getCurrentTick(), 2);
+  EXPECT_EQ(other_runs.size(), 2);
+  ASSERT_EQ(triggered_runs.size(), 4);
+  EXPECT_EQ(triggered_runs[3].tick, 2);
+}
@@ -1,13 +1,77 @@
 #include "oomd/PluginConstructionContext.h"
 
+#include "oomd/CgroupContext.h"
+
 namespace Oomd {
 
+std::optional<PressureTrigger> PressureTrigger::above(
+    const std::unordered_set<CgroupPath>& cgroups,
+    ResourceType resource,
+    int percent) {
+  if (percent <= 0 || percent >= 100) {
+    return std::nullopt;
+  }
+  std::chrono::microseconds window = std::chrono::seconds(1);
+  return PressureTrigger{
+      .cgroups = cgroups,
+      .resource = resource,
+      .stall = window * percent / 100,
+      .window = window};
+}
+
 PluginConstructionContext::PluginConstructionContext(
     const std::string& cgroup_fs)
-    : cgroup_fs_(cgroup_fs) {}
+    : cgroup_fs_(cgroup_fs), deps_(std::make_shared<DataDependencies>()) {}
 
 const std::string& PluginConstructionContext::cgroupFs() const {
   return cgroup_fs_;
 }
 
+void PluginConstructionContext::addPrerunDependency(DataDependency dep) const {
+  deps_->prerun.push_back(std::move(dep));
+}
+
+void PluginConstructionContext::addRunDependency(DataDependency dep) const {
+  deps_->run.push_back(std::move(dep));
+}
+
+void PluginConstructionContext::addPressureTrigger(
+    PressureTrigger trigger) const {
+  deps_->pressure_triggers.push_back(std::move(trigger));
+}
+
+void PluginConstructionContext::addPressureDetector(
+    const std::unordered_set<CgroupPath>& cgroups,
+    ResourceType resource,
+    int percent) const {
+  addRunDependency(
+      {cgroups,
+       false,
+       static_cast<uint16_t>(
+           CgroupContext::PREFETCH_CURRENT_USAGE |
+           (resource == ResourceType::IO
+                ? CgroupContext::PREFETCH_IO_PRESSURE
+                : CgroupContext::PREFETCH_MEM_PRESSURE))});
+
+  if (auto trigger = PressureTrigger::above(cgroups, resource, percent)) {
+    addPressureTrigger(std::move(*trigger));
+  }
+}
+
+void PluginConstructionContext::addVmstatKey(Vmstat::Key key) const {
+  deps_->vmstat_keys.set(static_cast<size_t>(key));
+}
+
+const PluginConstructionContext::DataDependencies&
+PluginConstructionContext::dataDependencies() const {
+  return *deps_;
+}
+
+PluginConstructionContext PluginConstructionContext::withNewDependencies()
+    const {
+  PluginConstructionContext ret(*this);
+  ret.deps_ = std::make_shared<DataDependencies>();
+  return ret;
+}
+
 } // namespace Oomd
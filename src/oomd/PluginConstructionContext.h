@@ -17,13 +17,68 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "oomd/include/CgroupPath.h"
+#include "oomd/include/Types.h"
 
 namespace Oomd {
 
+/*
+ * Cgroup data a plugin reads, declared at init() so OomdContext::prefetch()
+ * can read it ahead, in parallel, rather than on first use.
+ */
+struct DataDependency {
+  std::unordered_set<CgroupPath> cgroups;
+  // Also covers descendants, not descending below cgroups with
+  // memory.oom.group set, same as BaseKillPlugin::prerunOnCgroups()
+  bool recursive{false};
+  // CgroupContext::PrefetchRead bits
+  uint16_t reads{0};
+};
+
+/*
+ * PSI trigger a detector wants armed on its cgroups, so oomd wakes up as soon
+ * as full pressure on resource reaches stall in a window, rather than at the
+ * next interval.
+ */
+struct PressureTrigger {
+  std::unordered_set<CgroupPath> cgroups;
+  ResourceType resource{ResourceType::MEMORY};
+  std::chrono::microseconds stall{0};
+  std::chrono::microseconds window{0};
+
+  /*
+   * Trigger for pressure over @param percent, checked over 1s windows. That
+   * reacts well ahead of the 10s average detectors compare against, which
+   * the following intervals then catch up on. nullopt unless @param percent
+   * is in (0, 100).
+   */
+  static std::optional<PressureTrigger> above(
+      const std::unordered_set<CgroupPath>& cgroups,
+      ResourceType resource,
+      int percent);
+};
+
 class PluginConstructionContext {
  public:
+  struct DataDependencies {
+    // Read from prerun(), ie. every interval
+    std::vector<DataDependency> prerun;
+    // Read from run()
+    std::vector<DataDependency> run;
+    std::vector<PressureTrigger> pressure_triggers;
+    // /proc/vmstat keys read from SystemContext::vmstat
+    Vmstat::KeySet vmstat_keys;
+  };
+
   PluginConstructionContext(const std::string& cgroup_fs);
   ~PluginConstructionContext() = default;
   PluginConstructionContext(const PluginConstructionContext& other) = default;
@@ -35,8 +90,34 @@ class PluginConstructionContext {
 
   const std::string& cgroupFs() const;
 
+  /*
+   * Declares data the plugin being initialized reads. Copies of a context
+   * share what's declared, so plugins capturing it by value still declare
+   * into the same set.
+   */
+  void addPrerunDependency(DataDependency dep) const;
+  void addRunDependency(DataDependency dep) const;
+  // Only detectors' triggers are armed
+  void addPressureTrigger(PressureTrigger trigger) const;
+  /*
+   * Declares what detectors comparing pressure on @param resource of
+   * @param cgroups against @param percent read from run(), and arms their
+   * PressureTrigger::above() trigger.
+   */
+  void addPressureDetector(
+      const std::unordered_set<CgroupPath>& cgroups,
+      ResourceType resource,
+      int percent) const;
+  void addVmstatKey(Vmstat::Key key) const;
+
+  const DataDependencies& dataDependencies() const;
+
+  // Copy of this context declaring into a new, empty set of dependencies
+  PluginConstructionContext withNewDependencies() const;
+
  private:
   std::string cgroup_fs_;
+  std::shared_ptr<DataDependencies> deps_;
 };
 
 } // namespace Oomd
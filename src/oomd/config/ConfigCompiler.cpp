@@ -160,8 +160,13 @@ std::unique_ptr<Oomd::Engine::Ruleset> compileRuleset(
     }
   }
 
+  // Plugins declare what they read into these, see
+  // PluginConstructionContext::addRunDependency()
+  auto detector_context = context.withNewDependencies();
+  auto action_context = context.withNewDependencies();
+
   for (const auto& dg : ruleset.dgs) {
-    auto compiled_detectorgroup = compileDetectorGroup(dg, context);
+    auto compiled_detectorgroup = compileDetectorGroup(dg, detector_context);
     if (!compiled_detectorgroup) {
       return nullptr;
     }
@@ -171,7 +176,7 @@ std::unique_ptr<Oomd::Engine::Ruleset> compileRuleset(
 
   for (const auto& action : ruleset.acts) {
     auto compiled_action =
-        compilePlugin<Oomd::Config2::IR::Action>(action, context);
+        compilePlugin<Oomd::Config2::IR::Action>(action, action_context);
     if (!compiled_action) {
       return nullptr;
     }
@@ -179,7 +184,7 @@ std::unique_ptr<Oomd::Engine::Ruleset> compileRuleset(
     actions.emplace_back(std::move(compiled_action));
   }
 
-  return std::make_unique<Oomd::Engine::Ruleset>(
+  auto compiled = std::make_unique<Oomd::Engine::Ruleset>(
       ruleset.name,
       std::move(detector_groups),
       std::move(actions),
@@ -189,6 +194,9 @@ std::unique_ptr<Oomd::Engine::Ruleset> compileRuleset(
       silenced_logs,
       post_action_delay,
       prekill_hook_timeout);
+  compiled->setDataDependencies(
+      detector_context.dataDependencies(), action_context.dataDependencies());
+  return compiled;
 }
 
 } // namespace
@@ -298,6 +298,33 @@ class KillPlugin : public BasePlugin {
   std::string cgroupPath_;
 };
 
+// Declares prerun() reads IO_STAT and run() CURRENT_USAGE of "cgroup"
+class DeclareDependencyPlugin : public BasePlugin {
+ public:
+  int init(const PluginArgs& args, const PluginConstructionContext& context)
+      override {
+    CgroupPath cgroup(context.cgroupFs(), args.at("cgroup"));
+    context.addPrerunDependency(
+        {{cgroup}, false, CgroupContext::PREFETCH_IO_STAT});
+    context.addRunDependency(
+        {{cgroup}, false, CgroupContext::PREFETCH_CURRENT_USAGE});
+    if (auto key = Vmstat::keyFromName(args.at("vmstat"))) {
+      context.addVmstatKey(*key);
+    }
+    return 0;
+  }
+
+  PluginRet run(OomdContext& /* unused */) override {
+    return PluginRet::CONTINUE;
+  }
+
+  static DeclareDependencyPlugin* create() {
+    return new DeclareDependencyPlugin();
+  }
+
+  ~DeclareDependencyPlugin() override = default;
+};
+
 REGISTER_PLUGIN(Continue, ContinuePlugin::create);
 REGISTER_PLUGIN(Stop, StopPlugin::create);
 REGISTER_PLUGIN(IncrementCount, IncrementCountPlugin::create);
@@ -307,6 +334,7 @@ REGISTER_PLUGIN(AsyncPause, AsyncPausePlugin::create);
 REGISTER_PLUGIN(NoInit, NoInitPlugin::create);
 REGISTER_PREKILL_HOOK(NoOpPrekillHook, NoOpPrekillHook::create);
 REGISTER_PLUGIN(Kill, KillPlugin::create);
+REGISTER_PLUGIN(DeclareDependency, DeclareDependencyPlugin::create);
 
 } // namespace Oomd
 
@@ -364,6 +392,39 @@ TEST_F(CompilerTest, IncrementCount) {
   EXPECT_EQ(count, 3);
 }
 
+TEST_F(CompilerTest, DataDependencies) {
+  IR::Detector detector{IR::Plugin{
+      .name = "DeclareDependency",
+      .args = {{"cgroup", "A"}, {"vmstat", "pgscan_direct"}}}};
+  IR::Action action{IR::Plugin{
+      .name = "DeclareDependency",
+      .args = {{"cgroup", "B"}, {"vmstat", "oom_kill"}}}};
+  IR::DetectorGroup dgroup{"group1", {std::move(detector)}};
+  root.rulesets.emplace_back(
+      IR::Ruleset{"ruleset1", {std::move(dgroup)}, {std::move(action)}});
+
+  auto engine = compile();
+  ASSERT_TRUE(engine);
+
+  // Everything but what actions read in run() is read every interval
+  std::vector<std::pair<std::string, uint16_t>> deps;
+  for (const auto& dep : engine->intervalDependencies()) {
+    ASSERT_EQ(dep.cgroups.size(), 1);
+    deps.emplace_back(dep.cgroups.begin()->relativePath(), dep.reads);
+  }
+  EXPECT_THAT(
+      deps,
+      ::testing::UnorderedElementsAre(
+          ::testing::Pair("A", CgroupContext::PREFETCH_IO_STAT),
+          ::testing::Pair("A", CgroupContext::PREFETCH_CURRENT_USAGE),
+          ::testing::Pair("B", CgroupContext::PREFETCH_IO_STAT)));
+
+  Vmstat::KeySet vmstat_keys;
+  vmstat_keys.set(static_cast<size_t>(Vmstat::Key::PGSCAN_DIRECT));
+  vmstat_keys.set(static_cast<size_t>(Vmstat::Key::OOM_KILL));
+  EXPECT_EQ(engine->vmstatKeys(), vmstat_keys);
+}
+
 TEST_F(CompilerTest, MultiGroupIncrementCount) {
   IR::Detector cont;
   cont.name = "Continue";
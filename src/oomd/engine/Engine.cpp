@@ -18,6 +18,7 @@
 #include "oomd/engine/Engine.h"
 
 #include <algorithm>
+#include <iterator>
 #include <optional>
 
 #include "oomd/Log.h"
@@ -132,6 +133,55 @@ void Engine::removeDropInConfig(const std::string& tag) {
       new_hooks_end, prekill_hooks_in_reverse_order_.end());
 }
 
+std::vector<DataDependency> Engine::intervalDependencies() const {
+  std::vector<DataDependency> ret;
+  auto append = [&](const std::unique_ptr<Ruleset>& ruleset) {
+    if (ruleset) {
+      auto deps = ruleset->intervalDependencies();
+      std::move(deps.begin(), deps.end(), std::back_inserter(ret));
+    }
+  };
+  for (const auto& base : rulesets_) {
+    for (const auto& dropin : base.dropins) {
+      append(dropin.ruleset);
+    }
+    append(base.ruleset);
+  }
+  return ret;
+}
+
+std::vector<PressureTrigger> Engine::pressureTriggers() const {
+  std::vector<PressureTrigger> ret;
+  auto append = [&](const std::unique_ptr<Ruleset>& ruleset) {
+    if (ruleset) {
+      auto triggers = ruleset->pressureTriggers();
+      std::move(triggers.begin(), triggers.end(), std::back_inserter(ret));
+    }
+  };
+  for (const auto& base : rulesets_) {
+    for (const auto& dropin : base.dropins) {
+      append(dropin.ruleset);
+    }
+    append(base.ruleset);
+  }
+  return ret;
+}
+
+Vmstat::KeySet Engine::vmstatKeys() const {
+  Vmstat::KeySet ret;
+  for (const auto& base : rulesets_) {
+    for (const auto& dropin : base.dropins) {
+      if (dropin.ruleset) {
+        ret |= dropin.ruleset->vmstatKeys();
+      }
+    }
+    if (base.ruleset) {
+      ret |= base.ruleset->vmstatKeys();
+    }
+  }
+  return ret;
+}
+
 void Engine::prerun(OomdContext& context) {
   for (const auto& base : rulesets_) {
     for (const auto& dropin : base.dropins) {
@@ -162,6 +212,30 @@ void Engine::runOnce(OomdContext& context) {
   Oomd::incrementStat(CoreStats::kNumDropInFired, nr_dropins_run);
 }
 
+void Engine::runTriggered(
+    OomdContext& context,
+    const std::function<bool(const PressureTrigger&)>& fired) {
+  auto triggered = [&](const Ruleset& ruleset) {
+    auto triggers = ruleset.pressureTriggers();
+    return std::any_of(triggers.begin(), triggers.end(), fired);
+  };
+  uint32_t nr_dropins_run = 0;
+
+  for (const auto& base : rulesets_) {
+    for (const auto& dropin : base.dropins) {
+      if (dropin.ruleset && triggered(*dropin.ruleset)) {
+        nr_dropins_run += dropin.ruleset->runOnce(context);
+      }
+    }
+
+    if (triggered(*base.ruleset)) {
+      base.ruleset->runOnce(context);
+    }
+  }
+
+  Oomd::incrementStat(CoreStats::kNumDropInFired, nr_dropins_run);
+}
+
 std::optional<std::unique_ptr<PrekillHookInvocation>> Engine::firePrekillHook(
     const CgroupContext& cgroup_ctx,
     const OomdContext& oomd_context) {
@@ -19,6 +19,7 @@
 
 #include <cstdint>
 #include <deque>
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -61,6 +62,22 @@ class Engine {
    */
   void removeDropInConfig(const std::string& tag);
 
+  /*
+   * @returns what every enabled @class Ruleset reads every interval, for
+   * OomdContext::prefetch().
+   */
+  std::vector<DataDependency> intervalDependencies() const;
+
+  /*
+   * @returns the PSI triggers of every enabled @class Ruleset
+   */
+  std::vector<PressureTrigger> pressureTriggers() const;
+
+  /*
+   * @returns the /proc/vmstat keys every enabled @class Ruleset reads
+   */
+  Vmstat::KeySet vmstatKeys() const;
+
   /*
    * Preruns every @class Ruleset once.
    */
@@ -71,6 +88,14 @@ class Engine {
    */
   void runOnce(OomdContext& context);
 
+  /*
+   * Runs every @class Ruleset with a PSI trigger matching @param fired once,
+   * between intervals. Nothing is prerun.
+   */
+  void runTriggered(
+      OomdContext& context,
+      const std::function<bool(const PressureTrigger&)>& fired);
+
   std::optional<std::unique_ptr<PrekillHookInvocation>> firePrekillHook(
       const CgroupContext& cgroup_ctx,
       const OomdContext& oomd_context);
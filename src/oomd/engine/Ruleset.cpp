@@ -57,6 +57,7 @@ bool Ruleset::mergeWithDropIn(std::unique_ptr<Ruleset> ruleset) {
     }
 
     detector_groups_ = std::move(ruleset->detector_groups_);
+    detector_deps_ = std::move(ruleset->detector_deps_);
   }
 
   if (ruleset->action_group_.size()) {
@@ -66,11 +67,45 @@ bool Ruleset::mergeWithDropIn(std::unique_ptr<Ruleset> ruleset) {
     }
 
     action_group_ = std::move(ruleset->action_group_);
+    action_deps_ = std::move(ruleset->action_deps_);
   }
 
   return true;
 }
 
+void Ruleset::setDataDependencies(
+    PluginConstructionContext::DataDependencies detectors,
+    PluginConstructionContext::DataDependencies actions) {
+  detector_deps_ = std::move(detectors);
+  action_deps_ = std::move(actions);
+}
+
+std::vector<DataDependency> Ruleset::intervalDependencies() const {
+  std::vector<DataDependency> ret;
+  if (!enabled_) {
+    return ret;
+  }
+  for (const auto* deps :
+       {&detector_deps_.prerun, &detector_deps_.run, &action_deps_.prerun}) {
+    ret.insert(ret.end(), deps->begin(), deps->end());
+  }
+  return ret;
+}
+
+std::vector<PressureTrigger> Ruleset::pressureTriggers() const {
+  if (!enabled_) {
+    return {};
+  }
+  return detector_deps_.pressure_triggers;
+}
+
+Vmstat::KeySet Ruleset::vmstatKeys() const {
+  if (!enabled_) {
+    return {};
+  }
+  return detector_deps_.vmstat_keys | action_deps_.vmstat_keys;
+}
+
 void Ruleset::markDropInTargeted() {
   ++numTargeted_;
 
@@ -162,6 +197,10 @@ uint32_t Ruleset::runOnce(OomdContext& context) {
          << " has fired for Ruleset=" << name_ << ". Running action chain.";
   }
 
+  // Actions usually only run under pressure, so what they read isn't read
+  // ahead every interval, only once the chain is about to start
+  context.prefetch(action_deps_.run);
+
   // Begin running action chain
   return run_action_chain(action_group_.begin(), action_group_.end(), context);
 }
@@ -20,6 +20,7 @@
 #include <chrono>
 
 #include "oomd/OomdContext.h"
+#include "oomd/PluginConstructionContext.h"
 #include "oomd/engine/BasePlugin.h"
 #include "oomd/engine/DetectorGroup.h"
 
@@ -52,6 +53,33 @@ class Ruleset {
    */
   [[nodiscard]] bool mergeWithDropIn(std::unique_ptr<Ruleset> ruleset);
 
+  /*
+   * Sets what the plugins of this ruleset declared they read at init().
+   * @param detectors is what the detector groups read, @param actions what the
+   * action chain reads.
+   */
+  void setDataDependencies(
+      PluginConstructionContext::DataDependencies detectors,
+      PluginConstructionContext::DataDependencies actions);
+
+  /*
+   * @returns what this ruleset reads every interval, ie. in prerun() and from
+   * its detector groups. Nothing while disabled by a drop in.
+   */
+  std::vector<DataDependency> intervalDependencies() const;
+
+  /*
+   * @returns the PSI triggers its detector groups want armed. Nothing while
+   * disabled by a drop in.
+   */
+  std::vector<PressureTrigger> pressureTriggers() const;
+
+  /*
+   * @returns the /proc/vmstat keys any of its plugins read. Nothing while
+   * disabled by a drop in.
+   */
+  Vmstat::KeySet vmstatKeys() const;
+
   /*
    * Mark/unmark this ruleset as being targeted by an active drop in.
    */
@@ -85,6 +113,8 @@ class Ruleset {
   std::string name_;
   std::vector<std::unique_ptr<DetectorGroup>> detector_groups_;
   std::vector<std::unique_ptr<BasePlugin>> action_group_;
+  PluginConstructionContext::DataDependencies detector_deps_;
+  PluginConstructionContext::DataDependencies action_deps_;
   int post_action_delay_{DEFAULT_POST_ACTION_DELAY};
   int prekill_hook_timeout_{DEFAULT_PREKILL_HOOK_TIMEOUT};
   bool enabled_{true};
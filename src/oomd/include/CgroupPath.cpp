@@ -18,93 +18,202 @@
 #include "oomd/include/CgroupPath.h"
 
 #include <exception>
+#include <mutex>
 #include <optional>
+#include <unordered_map>
 
 #include "oomd/util/Fs.h"
 #include "oomd/util/Util.h"
 
 namespace Oomd {
 
+struct CgroupPath::Node {
+  Node(std::shared_ptr<const Node> parent_node, std::string node_name)
+      : parent(std::move(parent_node)),
+        root(parent ? parent->root : this),
+        name(std::move(node_name)),
+        depth(parent ? parent->depth + 1 : 0) {}
+  ~Node();
+
+  // Null for the cgroup fs itself
+  std::shared_ptr<const Node> parent;
+  const Node* root;
+  // Path component, or the cgroup fs for root
+  std::string name;
+  size_t depth;
+
+  mutable std::once_flag strings_once;
+  mutable std::string relative;
+  mutable std::string absolute;
+
+  // Guarded by tableLock()
+  mutable std::unordered_map<std::string, std::weak_ptr<const Node>> children;
+};
+
+namespace {
+
+std::mutex& tableLock() {
+  // Leaked so that static CgroupPaths can still be destroyed at exit
+  static auto* lock = new std::mutex();
+  return *lock;
+}
+
+template <typename Node>
+std::unordered_map<std::string, std::weak_ptr<const Node>>& roots() {
+  static auto* roots =
+      new std::unordered_map<std::string, std::weak_ptr<const Node>>();
+  return *roots;
+}
+
+/*
+ * Returns the interned node @param name under @param parent, creating it if
+ * needed. Nothing may be destroyed with the lock held, as ~Node() takes it.
+ */
+template <typename Node>
+std::shared_ptr<const Node> intern(
+    const std::shared_ptr<const Node>& parent,
+    const std::string& name) {
+  std::lock_guard<std::mutex> lock(tableLock());
+  auto& table = parent ? parent->children : roots<Node>();
+  auto& slot = table[name];
+  if (auto node = slot.lock()) {
+    return node;
+  }
+  auto node = std::make_shared<const Node>(parent, name);
+  slot = node;
+  return node;
+}
+
+} // namespace
+
+CgroupPath::Node::~Node() {
+  std::lock_guard<std::mutex> lock(tableLock());
+  auto& table = parent ? parent->children : roots<Node>();
+  // The name may already be taken by a new node if it was looked up after
+  // this one expired
+  if (auto it = table.find(name); it != table.end() && it->second.expired()) {
+    table.erase(it);
+  }
+}
+
+CgroupPath::CgroupPath(std::shared_ptr<const Node> node)
+    : node_(std::move(node)) {}
+
 CgroupPath::CgroupPath(
     const std::string& cgroup_fs,
     const std::string& cgroup_path)
-    : cgroup_fs_(cgroup_fs) {
+    : CgroupPath(cgroup_fs, Util::split(cgroup_path, '/')) {}
+
+CgroupPath::CgroupPath(
+    const std::string& cgroup_fs,
+    std::vector<std::string> parts) {
   // Strip trailing '/'
-  if (cgroup_fs_.at(cgroup_fs_.size() - 1) == '/' && cgroup_fs.size() > 1) {
-    cgroup_fs_.pop_back();
+  if (cgroup_fs.size() > 1 && cgroup_fs.back() == '/') {
+    node_ = intern<Node>(nullptr, cgroup_fs.substr(0, cgroup_fs.size() - 1));
+  } else {
+    node_ = intern<Node>(nullptr, cgroup_fs);
+  }
+  for (const auto& part : parts) {
+    node_ = intern(node_, part);
   }
-
-  cgroup_path_ = Util::split(cgroup_path, '/');
-  recomputeReadCache();
 }
 
 const std::string& CgroupPath::absolutePath() const {
-  return absolute_cache_;
+  relativePath();
+  return node_->absolute;
 }
 
 const std::string& CgroupPath::relativePath() const {
-  return relative_cache_;
+  std::call_once(node_->strings_once, [this] {
+    std::vector<const Node*> nodes;
+    size_t size = 0;
+    for (auto* node = node_.get(); node->parent; node = node->parent.get()) {
+      nodes.push_back(node);
+      size += node->name.size() + 1;
+    }
+    auto& relative = node_->relative;
+    relative.reserve(size);
+    for (auto it = nodes.rbegin(); it != nodes.rend(); ++it) {
+      if (!relative.empty()) {
+        relative += '/';
+      }
+      relative += (*it)->name;
+    }
+
+    auto& absolute = node_->absolute;
+    absolute.reserve(cgroupFs().size() + 1 + relative.size());
+    absolute += cgroupFs();
+    if (relative.size()) {
+      absolute += '/';
+      absolute += relative;
+    }
+  });
+  return node_->relative;
 }
 
-const std::vector<std::string>& CgroupPath::relativePathParts() const {
-  return cgroup_path_;
+std::vector<std::string> CgroupPath::relativePathParts() const {
+  std::vector<std::string> parts(node_->depth);
+  auto it = parts.rbegin();
+  for (auto* node = node_.get(); node->parent; node = node->parent.get()) {
+    *it++ = node->name;
+  }
+  return parts;
 }
 
 const std::string& CgroupPath::cgroupFs() const {
-  return cgroup_fs_;
+  return node_->root->name;
+}
+
+const std::string& CgroupPath::name() const {
+  static const std::string kEmpty;
+  return isRoot() ? kEmpty : node_->name;
+}
+
+size_t CgroupPath::depth() const {
+  return node_->depth;
 }
 
 CgroupPath CgroupPath::getParent() const {
   if (this->isRoot()) {
     throw std::invalid_argument("Cannot get parent of root");
   }
-
-  CgroupPath parent(*this);
-  parent.cgroup_path_.pop_back();
-  parent.recomputeReadCache();
-
-  return parent;
+  return CgroupPath(node_->parent);
 }
 
 CgroupPath CgroupPath::getChild(const std::string& path) const {
-  CgroupPath child(*this);
-
-  auto pieces = Util::split(path, '/');
-  child.cgroup_path_.reserve(child.cgroup_path_.size() + pieces.size());
-  for (auto& piece : pieces) {
-    child.cgroup_path_.emplace_back(std::move(piece));
+  auto node = node_;
+  for (const auto& piece : Util::split(path, '/')) {
+    node = intern(node, piece);
   }
-  child.recomputeReadCache();
-
-  return child;
+  return CgroupPath(std::move(node));
 }
 
 std::vector<CgroupPath> CgroupPath::resolveWildcard() const {
   std::vector<CgroupPath> ret;
-  auto glob = Fs::glob(absolutePath(), /* dir_only */ true);
+  auto root = Fs::DirFd::open(cgroupFs());
   // TODO(dschatzberg): Report error
-  if (!glob) {
+  if (!root) {
     return ret;
   }
-  for (const auto& path : *glob) {
-    if (path.find(cgroup_fs_) == 0) {
-      if (path.size() == cgroup_fs_.size()) {
-        ret.emplace_back(cgroup_fs_, "");
-      } else if (path[cgroup_fs_.size()] == '/') {
-        ret.emplace_back(cgroup_fs_, path.substr(cgroup_fs_.size() + 1));
-      }
-    }
+  // Only the paths are wanted, so don't hold on to the matches' fds
+  auto dirs = Fs::resolveDirPatternAt(
+      *root, relativePath(), [](const auto&) { return false; });
+  if (!dirs) {
+    return ret;
+  }
+  for (auto& dir : *dirs) {
+    ret.emplace_back(cgroupFs(), std::move(dir.parts));
   }
   return ret;
 }
 
 bool CgroupPath::hasDescendantWithPrefixMatching(
     const CgroupPath& pattern) const {
-  unsigned int prefix_len =
-      std::min(cgroup_path_.size(), pattern.cgroup_path_.size());
+  auto parts = relativePathParts();
+  auto pattern_parts = pattern.relativePathParts();
+  unsigned int prefix_len = std::min(parts.size(), pattern_parts.size());
   for (unsigned int i = 0; i < prefix_len; i++) {
-    if (!(cgroup_path_[i] == pattern.cgroup_path_[i] ||
-          pattern.cgroup_path_[i] == "*")) {
+    if (!(parts[i] == pattern_parts[i] || pattern_parts[i] == "*")) {
       return false;
     }
   }
@@ -112,7 +221,7 @@ bool CgroupPath::hasDescendantWithPrefixMatching(
 }
 
 bool CgroupPath::operator==(const CgroupPath& other) const {
-  return this->absolutePath() == other.absolutePath();
+  return node_ == other.node_;
 }
 
 bool CgroupPath::operator!=(const CgroupPath& other) const {
@@ -120,39 +229,7 @@ bool CgroupPath::operator!=(const CgroupPath& other) const {
 }
 
 bool CgroupPath::isRoot() const {
-  return cgroup_path_.size() == 0;
-}
-
-void CgroupPath::recomputeReadCache() {
-  // Recreate relative_cache_
-  relative_cache_.clear();
-  size_t s = 0;
-  for (size_t i = 0; i < cgroup_path_.size(); ++i) {
-    s += cgroup_path_.at(i).size();
-    if (i == cgroup_path_.size() - 1) {
-      break;
-    }
-    ++s; // for the path separator
-  }
-
-  relative_cache_.reserve(s);
-
-  for (size_t i = 0; i < cgroup_path_.size(); ++i) {
-    relative_cache_ += cgroup_path_.at(i);
-    if (i == cgroup_path_.size() - 1) {
-      break;
-    }
-    relative_cache_ += '/';
-  }
-
-  // Recreate absolute_cache_
-  absolute_cache_.clear();
-  absolute_cache_.reserve(cgroup_fs_.size() + 1 + relative_cache_.size());
-  absolute_cache_ += cgroup_fs_;
-  if (relative_cache_.size()) {
-    absolute_cache_ += '/';
-    absolute_cache_ += relative_cache_;
-  }
+  return !node_->parent;
 }
 
 } // namespace Oomd
@@ -18,14 +18,21 @@
 #pragma once
 
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace Oomd {
 
+/*
+ * Path of a cgroup, interned so that every CgroupPath naming the same cgroup
+ * shares one node. Copies, hashing, comparison and getParent() are O(1).
+ * Nodes live as long as some CgroupPath refers to them or a descendant.
+ */
 class CgroupPath {
  public:
   CgroupPath(const std::string& cgroup_fs, const std::string& cgroup_path);
+  CgroupPath(const std::string& cgroup_fs, std::vector<std::string> parts);
   ~CgroupPath() = default;
   CgroupPath(const CgroupPath& other) = default;
   CgroupPath(CgroupPath&& other) = default;
@@ -33,11 +40,16 @@ class CgroupPath {
   CgroupPath& operator=(CgroupPath&& other) = default;
   static void setCgroupFs(const std::string& cgroup_fs);
 
+  // String forms are built on first use
   const std::string& absolutePath() const;
   // cgroup path without the cgroup fs
   const std::string& relativePath() const;
-  const std::vector<std::string>& relativePathParts() const;
+  std::vector<std::string> relativePathParts() const;
   const std::string& cgroupFs() const;
+  // Last component of the path, empty for root
+  const std::string& name() const;
+  // Number of components in the path, 0 for root
+  size_t depth() const;
 
   CgroupPath getParent() const;
   CgroupPath getChild(const std::string& path) const;
@@ -66,13 +78,15 @@ class CgroupPath {
   // Do we represent the root cgroup?
   bool isRoot() const;
 
+  size_t hash() const {
+    return std::hash<const void*>()(node_.get());
+  }
+
  private:
-  void recomputeReadCache();
+  struct Node;
+  explicit CgroupPath(std::shared_ptr<const Node> node);
 
-  std::string cgroup_fs_;
-  std::vector<std::string> cgroup_path_;
-  std::string absolute_cache_;
-  std::string relative_cache_;
+  std::shared_ptr<const Node> node_;
 };
 
 } // namespace Oomd
@@ -81,7 +95,7 @@ namespace std {
 template <>
 struct hash<Oomd::CgroupPath> {
   size_t operator()(const Oomd::CgroupPath& path) const {
-    return hash<std::string>()(path.absolutePath());
+    return path.hash();
   }
 };
 } // namespace std
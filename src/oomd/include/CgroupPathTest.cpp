@@ -104,6 +104,30 @@ TEST(CgroupPathTest, HashTest) {
   EXPECT_EQ(m[p3], 1);
 }
 
+TEST(CgroupPathTest, InterningTest) {
+  CgroupPath p1("/sys/fs/cgroup/", "system.slice/foo.service");
+  CgroupPath p2 =
+      CgroupPath("/sys/fs/cgroup", "").getChild("system.slice/foo.service");
+  EXPECT_EQ(p1, p2);
+  EXPECT_EQ(p1.hash(), p2.hash());
+  EXPECT_EQ(p1.getParent(), CgroupPath("/sys/fs/cgroup", "system.slice"));
+  EXPECT_NE(p1, CgroupPath("/cgroup2", "system.slice/foo.service"));
+
+  EXPECT_EQ(p1.name(), "foo.service");
+  EXPECT_EQ(p1.depth(), 2);
+  EXPECT_EQ(p1.getParent().getParent().name(), "");
+  EXPECT_EQ(p1.getParent().getParent().depth(), 0);
+
+  // Unused paths are dropped and come back equal to new lookups
+  {
+    CgroupPath tmp("/sys/fs/cgroup", "system.slice/bar.service");
+    EXPECT_EQ(tmp.absolutePath(), "/sys/fs/cgroup/system.slice/bar.service");
+  }
+  CgroupPath p3("/sys/fs/cgroup", "system.slice/bar.service");
+  EXPECT_EQ(p3, p1.getParent().getChild("bar.service"));
+  EXPECT_EQ(p3.absolutePath(), "/sys/fs/cgroup/system.slice/bar.service");
+}
+
 TEST(CgroupPathTest, ResolveWildcardTest) {
   using F = Fixture;
   auto tempDir = F::mkdtempChecked();
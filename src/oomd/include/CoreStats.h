@@ -26,13 +26,22 @@ class CoreStats {
   static constexpr auto kKillsKey = "oomd.kills";
   static constexpr auto kNumDropInAdds = "oomd.dropin.added";
   static constexpr auto kNumDropInFired = "oomd.dropin.fired";
+  static constexpr auto kPatternCacheHits = "oomd.pattern_cache.hits";
+  static constexpr auto kPatternCacheMisses = "oomd.pattern_cache.misses";
+  static constexpr auto kCgroupCacheEvictions = "oomd.cgroup_cache.evictions";
+  static constexpr auto kPressureTriggerWakeups =
+      "oomd.pressure_trigger.wakeups";
 
   // List of all the stats keys. Useful for operations that need to know
   // all the available core keys.
-  static constexpr std::array<const char*, 3> kAllKeys = {
+  static constexpr std::array<const char*, 7> kAllKeys = {
       kKillsKey,
       kNumDropInAdds,
       kNumDropInFired,
+      kPatternCacheHits,
+      kPatternCacheMisses,
+      kCgroupCacheEvictions,
+      kPressureTriggerWakeups,
   };
 };
 
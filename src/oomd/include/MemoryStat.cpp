@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "oomd/include/MemoryStat.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+constexpr std::string_view kKeyNames[] = {
+    "anon",
+    "file",
+    "kernel",
+    "kernel_stack",
+    "pagetables",
+    "sec_pagetables",
+    "percpu",
+    "sock",
+    "vmalloc",
+    "shmem",
+    "zswap",
+    "zswapped",
+    "file_mapped",
+    "file_dirty",
+    "file_writeback",
+    "swapcached",
+    "anon_thp",
+    "file_thp",
+    "shmem_thp",
+    "inactive_anon",
+    "active_anon",
+    "inactive_file",
+    "active_file",
+    "unevictable",
+    "slab_reclaimable",
+    "slab_unreclaimable",
+    "slab",
+    "workingset_refault",
+    "workingset_refault_anon",
+    "workingset_refault_file",
+    "workingset_activate",
+    "workingset_activate_anon",
+    "workingset_activate_file",
+    "workingset_restore",
+    "workingset_restore_anon",
+    "workingset_restore_file",
+    "workingset_nodereclaim",
+    "pgscan",
+    "pgsteal",
+    "pgscan_kswapd",
+    "pgscan_direct",
+    "pgscan_khugepaged",
+    "pgsteal_kswapd",
+    "pgsteal_direct",
+    "pgsteal_khugepaged",
+    "pgfault",
+    "pgmajfault",
+    "pgrefill",
+    "pgactivate",
+    "pgdeactivate",
+    "pglazyfree",
+    "pglazyfreed",
+    "zswpin",
+    "zswpout",
+    "thp_fault_alloc",
+    "thp_collapse_alloc",
+    "thp_swpout",
+    "thp_swpout_fallback",
+};
+static_assert(
+    std::size(kKeyNames) == Oomd::MemoryStat::kNumKeys,
+    "kKeyNames must have an entry for every MemoryStat::Key");
+
+} // namespace
+
+namespace Oomd {
+
+MemoryStat::MemoryStat(
+    std::initializer_list<std::pair<std::string_view, int64_t>> init) {
+  for (const auto& [name, value] : init) {
+    set(name, value);
+  }
+}
+
+std::string_view MemoryStat::keyName(Key key) {
+  return kKeyNames[static_cast<size_t>(key)];
+}
+
+std::optional<MemoryStat::Key> MemoryStat::keyFromName(
+    std::string_view name,
+    size_t hint) {
+  if (hint < kNumKeys && kKeyNames[hint] == name) {
+    return static_cast<Key>(hint);
+  }
+  auto it = std::find(std::begin(kKeyNames), std::end(kKeyNames), name);
+  if (it == std::end(kKeyNames)) {
+    return std::nullopt;
+  }
+  return static_cast<Key>(it - std::begin(kKeyNames));
+}
+
+std::optional<int64_t> MemoryStat::get(Key key) const {
+  auto idx = static_cast<size_t>(key);
+  if (!present_.test(idx)) {
+    return std::nullopt;
+  }
+  return values_[idx];
+}
+
+std::optional<int64_t> MemoryStat::get(std::string_view name) const {
+  if (auto key = keyFromName(name)) {
+    return get(*key);
+  }
+  for (const auto& [overflow_name, value] : overflow_) {
+    if (overflow_name == name) {
+      return value;
+    }
+  }
+  return std::nullopt;
+}
+
+void MemoryStat::set(Key key, int64_t value) {
+  auto idx = static_cast<size_t>(key);
+  values_[idx] = value;
+  present_.set(idx);
+}
+
+void MemoryStat::set(std::string_view name, int64_t value) {
+  if (auto key = keyFromName(name)) {
+    set(*key, value);
+    return;
+  }
+  for (auto& [overflow_name, overflow_value] : overflow_) {
+    if (overflow_name == name) {
+      overflow_value = value;
+      return;
+    }
+  }
+  overflow_.emplace_back(name, value);
+}
+
+size_t MemoryStat::size() const {
+  return present_.count() + overflow_.size();
+}
+
+bool MemoryStat::empty() const {
+  return size() == 0;
+}
+
+void MemoryStat::clear() {
+  present_.reset();
+  overflow_.clear();
+}
+
+std::unordered_map<std::string, int64_t> MemoryStat::asMap() const {
+  std::unordered_map<std::string, int64_t> map;
+  map.reserve(size());
+  for (size_t i = 0; i < kNumKeys; ++i) {
+    if (present_.test(i)) {
+      map.emplace(kKeyNames[i], values_[i]);
+    }
+  }
+  for (const auto& [name, value] : overflow_) {
+    map.emplace(name, value);
+  }
+  return map;
+}
+
+bool MemoryStat::operator==(const MemoryStat& rhs) const {
+  if (present_ != rhs.present_ || overflow_.size() != rhs.overflow_.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < kNumKeys; ++i) {
+    if (present_.test(i) && values_[i] != rhs.values_[i]) {
+      return false;
+    }
+  }
+  // Overflow entries are unique by name, so a one-way check is enough
+  for (const auto& [name, value] : overflow_) {
+    if (rhs.get(name) != value) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MemoryStat::operator!=(const MemoryStat& rhs) const {
+  return !(*this == rhs);
+}
+
+} // namespace Oomd
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Oomd {
+
+/*
+ * Contents of a cgroup's memory.stat file.
+ *
+ * Keys the kernel is known to print are stored in a fixed array indexed by
+ * MemoryStat::Key. Anything else (eg. a key added by a newer kernel) lands in
+ * a small side table so no data is lost.
+ */
+class MemoryStat {
+ public:
+  // Ordered the same way the kernel prints them
+  enum class Key : uint8_t {
+    ANON = 0,
+    FILE,
+    KERNEL,
+    KERNEL_STACK,
+    PAGETABLES,
+    SEC_PAGETABLES,
+    PERCPU,
+    SOCK,
+    VMALLOC,
+    SHMEM,
+    ZSWAP,
+    ZSWAPPED,
+    FILE_MAPPED,
+    FILE_DIRTY,
+    FILE_WRITEBACK,
+    SWAPCACHED,
+    ANON_THP,
+    FILE_THP,
+    SHMEM_THP,
+    INACTIVE_ANON,
+    ACTIVE_ANON,
+    INACTIVE_FILE,
+    ACTIVE_FILE,
+    UNEVICTABLE,
+    SLAB_RECLAIMABLE,
+    SLAB_UNRECLAIMABLE,
+    SLAB,
+    WORKINGSET_REFAULT,
+    WORKINGSET_REFAULT_ANON,
+    WORKINGSET_REFAULT_FILE,
+    WORKINGSET_ACTIVATE,
+    WORKINGSET_ACTIVATE_ANON,
+    WORKINGSET_ACTIVATE_FILE,
+    WORKINGSET_RESTORE,
+    WORKINGSET_RESTORE_ANON,
+    WORKINGSET_RESTORE_FILE,
+    WORKINGSET_NODERECLAIM,
+    PGSCAN,
+    PGSTEAL,
+    PGSCAN_KSWAPD,
+    PGSCAN_DIRECT,
+    PGSCAN_KHUGEPAGED,
+    PGSTEAL_KSWAPD,
+    PGSTEAL_DIRECT,
+    PGSTEAL_KHUGEPAGED,
+    PGFAULT,
+    PGMAJFAULT,
+    PGREFILL,
+    PGACTIVATE,
+    PGDEACTIVATE,
+    PGLAZYFREE,
+    PGLAZYFREED,
+    ZSWPIN,
+    ZSWPOUT,
+    THP_FAULT_ALLOC,
+    THP_COLLAPSE_ALLOC,
+    THP_SWPOUT,
+    THP_SWPOUT_FALLBACK,
+    COUNT, // Must be last
+  };
+  static constexpr size_t kNumKeys = static_cast<size_t>(Key::COUNT);
+
+  MemoryStat() = default;
+  MemoryStat(std::initializer_list<std::pair<std::string_view, int64_t>> init);
+
+  static std::string_view keyName(Key key);
+  /*
+   * Looks up the Key for @param name. @param hint is the index to try first;
+   * when parsing memory.stat top to bottom, passing one past the previous key
+   * makes nearly every lookup a single comparison.
+   */
+  static std::optional<Key> keyFromName(std::string_view name, size_t hint = 0);
+
+  std::optional<int64_t> get(Key key) const;
+  std::optional<int64_t> get(std::string_view name) const;
+  void set(Key key, int64_t value);
+  void set(std::string_view name, int64_t value);
+
+  size_t size() const;
+  bool empty() const;
+  void clear();
+
+  // Map view of every entry, for callers that want to iterate over all keys
+  std::unordered_map<std::string, int64_t> asMap() const;
+
+  bool operator==(const MemoryStat& rhs) const;
+  bool operator!=(const MemoryStat& rhs) const;
+
+ private:
+  std::array<int64_t, kNumKeys> values_{};
+  std::bitset<kNumKeys> present_;
+  std::vector<std::pair<std::string, int64_t>> overflow_;
+};
+
+} // namespace Oomd
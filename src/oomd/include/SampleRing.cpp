@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "oomd/include/SampleRing.h"
+
+#include <algorithm>
+
+#include "oomd/include/Vmstat.h"
+
+namespace Oomd {
+
+void SampleRing::Sums::add(const Sample& sample) {
+  if (stats.count == 0) {
+    origin = sample.tick;
+    stats.min = sample.value;
+    stats.max = sample.value;
+  }
+  double x = sample.tick - origin;
+  stats.count++;
+  stats.sum += sample.value;
+  stats.min = std::min(stats.min, sample.value);
+  stats.max = std::max(stats.max, sample.value);
+  sum_x += x;
+  sum_xx += x * x;
+  sum_xy += x * sample.value;
+  updateSlope();
+}
+
+void SampleRing::Sums::remove(const Sample& sample) {
+  double x = sample.tick - origin;
+  stats.count--;
+  stats.sum -= sample.value;
+  sum_x -= x;
+  sum_xx -= x * x;
+  sum_xy -= x * sample.value;
+  updateSlope();
+}
+
+void SampleRing::Sums::updateSlope() {
+  double n = stats.count;
+  double denom = n * sum_xx - sum_x * sum_x;
+  stats.slope = stats.count >= 2 && denom > 0
+      ? (n * sum_xy - sum_x * stats.sum) / denom
+      : 0;
+}
+
+void SampleRing::MonotonicQueue::reset(size_t capacity) {
+  slots_.assign(capacity, 0);
+  front_ = 0;
+  size_ = 0;
+}
+
+void SampleRing::MonotonicQueue::evict(size_t slot) {
+  if (size_ && slots_[front_] == slot) {
+    front_ = (front_ + 1) % slots_.size();
+    size_--;
+  }
+}
+
+void SampleRing::MonotonicQueue::push(
+    const std::vector<Sample>& samples,
+    size_t slot) {
+  double value = samples[slot].value;
+  while (size_) {
+    size_t back = (front_ + size_ - 1) % slots_.size();
+    double other = samples[slots_[back]].value;
+    if (max_ ? other > value : other < value) {
+      break;
+    }
+    size_--;
+  }
+  slots_[(front_ + size_) % slots_.size()] = slot;
+  size_++;
+}
+
+SampleRing::SampleRing(size_t capacity, double ewma_decay)
+    : capacity_(capacity), ewma_decay_(ewma_decay) {}
+
+void SampleRing::push(uint64_t tick, double value) {
+  if (capacity_ == 0) {
+    return;
+  }
+  if (samples_.empty()) {
+    samples_.resize(capacity_);
+    min_slots_.reset(capacity_);
+    max_slots_.reset(capacity_);
+  }
+  ewma_ = ewma_ ? Vmstat::ewma(*ewma_, value, ewma_decay_) : value;
+
+  size_t slot = head_;
+  if (size_ == capacity_) {
+    total_.remove(samples_[slot]);
+    min_slots_.evict(slot);
+    max_slots_.evict(slot);
+  } else {
+    size_++;
+  }
+  samples_[slot] = Sample{tick, value};
+  head_ = (head_ + 1) % capacity_;
+  min_slots_.push(samples_, slot);
+  max_slots_.push(samples_, slot);
+
+  // Start over once per lap so rounding error can't pile up
+  if (head_ == 0) {
+    recompute();
+  } else {
+    total_.add(samples_[slot]);
+  }
+  total_.stats.min = samples_[min_slots_.front()].value;
+  total_.stats.max = samples_[max_slots_.front()].value;
+}
+
+std::optional<SampleRing::Sample> SampleRing::at(size_t age) const {
+  if (age >= size_) {
+    return std::nullopt;
+  }
+  return slot(age);
+}
+
+std::optional<double> SampleRing::ewma() const {
+  return ewma_;
+}
+
+SampleRing::Stats SampleRing::stats(size_t window) const {
+  if (window >= size_) {
+    return total_.stats;
+  }
+  Sums sums;
+  for (size_t age = window; age-- > 0;) {
+    sums.add(slot(age));
+  }
+  return sums.stats;
+}
+
+const SampleRing::Sample& SampleRing::slot(size_t age) const {
+  return samples_[(head_ + capacity_ - 1 - age) % capacity_];
+}
+
+void SampleRing::recompute() {
+  total_ = Sums{};
+  for (size_t age = size_; age-- > 0;) {
+    total_.add(slot(age));
+  }
+}
+
+} // namespace Oomd
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace Oomd {
+
+/*
+ * Fixed capacity history of a per-tick counter. Once full, every push drops
+ * the oldest sample.
+ *
+ * Sum, min, max and least-squares slope of the whole ring are kept up to date
+ * as samples come and go, so stats() is O(1) and push() amortized O(1).
+ * Narrower windows are computed on demand in O(window).
+ */
+class SampleRing {
+ public:
+  struct Sample {
+    uint64_t tick;
+    double value;
+  };
+
+  struct Stats {
+    size_t count{0};
+    double sum{0};
+    double min{0};
+    double max{0};
+    // Least-squares fit of value over tick, ie. change per tick. 0 when
+    // there are fewer than 2 samples.
+    double slope{0};
+
+    double mean() const {
+      return count ? sum / count : 0;
+    }
+  };
+
+  /*
+   * @param ewma_decay is the share of the old average kept on every push, as
+   * with Vmstat::ewma().
+   */
+  SampleRing(size_t capacity, double ewma_decay);
+
+  // @param tick must be larger than that of the previous push
+  void push(uint64_t tick, double value);
+
+  size_t size() const {
+    return size_;
+  }
+  size_t capacity() const {
+    return capacity_;
+  }
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  // Sample pushed @param age pushes ago, 0 being the latest
+  std::optional<Sample> at(size_t age) const;
+
+  // Moving average over every sample ever pushed, not just the ring
+  std::optional<double> ewma() const;
+
+  Stats stats() const {
+    return total_.stats;
+  }
+  /*
+   * Stats of the latest @param window samples. Unlike stats(), these aren't
+   * kept up to date but summed on every call, so this is O(window) unless
+   * the window covers the whole ring.
+   */
+  Stats stats(size_t window) const;
+
+ private:
+  // Running sums behind Stats, with ticks relative to origin to keep the
+  // slope terms small
+  struct Sums {
+    Stats stats;
+    uint64_t origin{0};
+    double sum_x{0};
+    double sum_xx{0};
+    double sum_xy{0};
+
+    void add(const Sample& sample);
+    // Doesn't update min and max, which can't be undone
+    void remove(const Sample& sample);
+    void updateSlope();
+  };
+
+  /*
+   * Slots of the samples no later sample beats, oldest first, so the front
+   * is the min (or max) of the whole ring. Every slot is queued and dropped
+   * once, however the series moves.
+   */
+  class MonotonicQueue {
+   public:
+    explicit MonotonicQueue(bool max) : max_(max) {}
+
+    void reset(size_t capacity);
+    // Call before @param slot is overwritten
+    void evict(size_t slot);
+    void push(const std::vector<Sample>& samples, size_t slot);
+    size_t front() const {
+      return slots_[front_];
+    }
+
+   private:
+    bool max_;
+    // Circular, as large as the ring
+    std::vector<size_t> slots_;
+    size_t front_{0};
+    size_t size_{0};
+  };
+
+  const Sample& slot(size_t age) const;
+  // Rebuilds total_ from scratch, dropping any accumulated rounding error
+  void recompute();
+
+  size_t capacity_;
+  double ewma_decay_;
+  // Allocated on the first push, as many rings never get one
+  std::vector<Sample> samples_;
+  size_t head_{0}; // Next slot to write
+  size_t size_{0};
+  std::optional<double> ewma_;
+  Sums total_;
+  MonotonicQueue min_slots_{false};
+  MonotonicQueue max_slots_{true};
+};
+
+} // namespace Oomd
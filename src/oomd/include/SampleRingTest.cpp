@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <vector>
+
+#include "oomd/include/SampleRing.h"
+
+using namespace Oomd;
+
+/*
+ * Verify min and max stay right as the extremes are pushed out of the ring.
+ */
+TEST(SampleRingTest, Eviction) {
+  SampleRing ring(4, 0.5);
+  for (uint64_t tick = 0; tick < 10; ++tick) {
+    ring.push(tick, 100.0 - tick);
+    auto stats = ring.stats();
+    EXPECT_EQ(stats.max, 100.0 - (tick < 4 ? 0 : tick - 3));
+    EXPECT_EQ(stats.min, 100.0 - tick);
+    if (tick > 0) {
+      EXPECT_DOUBLE_EQ(stats.slope, -1);
+    }
+  }
+  EXPECT_EQ(ring.size(), 4);
+  EXPECT_EQ(ring.stats().sum, 91 + 92 + 93 + 94);
+}
+
+/*
+ * Verify min and max follow eviction on series that keep evicting their
+ * min or max, like cumulative counters.
+ */
+TEST(SampleRingTest, MonotonicEviction) {
+  auto check = [](std::function<double(uint64_t)> series) {
+    SampleRing ring(5, 0.5);
+    for (uint64_t tick = 0; tick < 23; ++tick) {
+      ring.push(tick, series(tick));
+      std::vector<double> values;
+      for (size_t age = 0; age < ring.size(); ++age) {
+        values.push_back(ring.at(age)->value);
+      }
+      auto stats = ring.stats();
+      EXPECT_EQ(stats.min, *std::min_element(values.begin(), values.end()))
+          << "tick " << tick;
+      EXPECT_EQ(stats.max, *std::max_element(values.begin(), values.end()))
+          << "tick " << tick;
+      EXPECT_DOUBLE_EQ(
+          stats.sum, std::accumulate(values.begin(), values.end(), 0.0))
+          << "tick " << tick;
+    }
+  };
+  check([](uint64_t tick) { return 10.0 * tick; });
+  check([](uint64_t) { return 7.0; });
+  // Steps, so ties are evicted too
+  check([](uint64_t tick) { return static_cast<double>(tick / 3); });
+  check([](uint64_t tick) { return tick % 7 < 4 ? -1.0 * tick : 100.0; });
+}
+
+/*
+ * Verify narrower windows only cover the latest samples.
+ */
+TEST(SampleRingTest, Window) {
+  SampleRing ring(5, 0.5);
+  EXPECT_EQ(ring.stats(3).count, 0);
+  for (uint64_t tick = 0; tick < 7; ++tick) {
+    ring.push(tick, tick * tick);
+  }
+
+  auto stats = ring.stats(3);
+  EXPECT_EQ(stats.count, 3);
+  EXPECT_EQ(stats.sum, 16 + 25 + 36);
+  EXPECT_EQ(stats.min, 16);
+  EXPECT_EQ(stats.max, 36);
+  EXPECT_DOUBLE_EQ(stats.slope, 10);
+  // Windows as wide as the ring are the whole ring
+  EXPECT_EQ(ring.stats(10).sum, ring.stats().sum);
+  EXPECT_EQ(ring.stats(10).count, 5);
+}
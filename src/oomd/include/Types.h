@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <sys/types.h>
 #include <chrono>
 #include <cstdint>
 #include <iostream>
@@ -24,6 +25,8 @@
 #include <unordered_map>
 #include <vector>
 
+#include "oomd/include/Vmstat.h"
+
 namespace Oomd {
 
 namespace Engine {
@@ -67,6 +70,23 @@ struct IOCostCoeffs {
   double trimbw{0};
 };
 
+// A device io cost is accounted on, keyed by its packed dev_t
+struct IOCostDevice {
+  dev_t dev{0};
+  IOCostCoeffs coeffs;
+};
+
+// io.stat counters of an IOCostDevice, bound to that device's coefficients
+struct BoundDeviceIOStat {
+  IOCostCoeffs coeffs;
+  int64_t rbytes{0};
+  int64_t wbytes{0};
+  int64_t rios{0};
+  int64_t wios{0};
+  int64_t dbytes{0};
+  int64_t dios{0};
+};
+
 struct ResourcePressure {
   float sec_10{0};
   float sec_60{0};
@@ -79,12 +99,28 @@ struct ResourcePressure {
   }
 };
 
+// Both the "some" and "full" lines of a PSI file, parsed from a single read
+struct PressureRecord {
+  ResourcePressure some;
+  ResourcePressure full;
+
+  bool operator==(const PressureRecord& rhs) const {
+    return some == rhs.some && full == rhs.full;
+  }
+};
+
+// Snapshot of system wide state, taken once at the start of every interval
 struct SystemContext {
   uint64_t swaptotal{0};
   uint64_t swapused{0};
   int swappiness{0};
-  std::unordered_map<std::string, int64_t> vmstat{};
-  // moving avg swap out rate derived from vmstat[pswpout]
+  // Only the keys some plugin or oomd itself reads
+  Vmstat vmstat{};
+  std::unordered_map<std::string, int64_t> meminfo{};
+  // Root cgroup PSI, from /proc/pressure/{memory,io}
+  std::optional<PressureRecord> mem_pressure{};
+  std::optional<PressureRecord> io_pressure{};
+  // moving avg swap out rate derived from vmstat pswpout
   double swapout_bps_60{0};
   double swapout_bps_300{0};
 };
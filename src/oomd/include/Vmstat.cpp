@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "oomd/include/Vmstat.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+constexpr std::string_view kKeyNames[] = {
+    "pswpin",
+    "pswpout",
+    "pgmajfault",
+    "pgscan_kswapd",
+    "pgscan_direct",
+    "pgsteal_kswapd",
+    "pgsteal_direct",
+    "workingset_refault_anon",
+    "workingset_refault_file",
+    "oom_kill",
+};
+static_assert(
+    std::size(kKeyNames) == Oomd::Vmstat::kNumKeys,
+    "kKeyNames must have an entry for every Vmstat::Key");
+} // namespace
+
+namespace Oomd {
+
+std::string_view Vmstat::keyName(Key key) {
+  return kKeyNames[static_cast<size_t>(key)];
+}
+
+std::optional<Vmstat::Key> Vmstat::keyFromName(std::string_view name) {
+  auto it = std::find(std::begin(kKeyNames), std::end(kKeyNames), name);
+  if (it == std::end(kKeyNames)) {
+    return std::nullopt;
+  }
+  return static_cast<Key>(it - std::begin(kKeyNames));
+}
+
+std::optional<int64_t> Vmstat::get(Key key) const {
+  auto idx = static_cast<size_t>(key);
+  if (!present_.test(idx)) {
+    return std::nullopt;
+  }
+  return values_[idx];
+}
+
+void Vmstat::set(Key key, int64_t value) {
+  auto idx = static_cast<size_t>(key);
+  values_[idx] = value;
+  present_.set(idx);
+}
+
+bool Vmstat::empty() const {
+  return present_.none();
+}
+
+std::optional<double> Vmstat::rate(
+    const Vmstat& prev,
+    Key key,
+    std::chrono::duration<double> interval) const {
+  auto cur_val = get(key);
+  auto prev_val = prev.get(key);
+  if (!cur_val || !prev_val || interval.count() <= 0) {
+    return std::nullopt;
+  }
+  return (*cur_val - *prev_val) / interval.count();
+}
+
+double Vmstat::ewma(double prev_avg, double sample, double decay) {
+  return sample + decay * (prev_avg - sample);
+}
+
+} // namespace Oomd
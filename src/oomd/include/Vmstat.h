@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace Oomd {
+
+/*
+ * The handful of /proc/vmstat counters oomd consumes.
+ *
+ * /proc/vmstat has well over a hundred keys. Only keys somebody declared are
+ * extracted, so plugins add the ones they read with
+ * PluginConstructionContext::addVmstatKey() from their init().
+ */
+class Vmstat {
+ public:
+  enum class Key : uint8_t {
+    PSWPIN = 0,
+    PSWPOUT,
+    PGMAJFAULT,
+    PGSCAN_KSWAPD,
+    PGSCAN_DIRECT,
+    PGSTEAL_KSWAPD,
+    PGSTEAL_DIRECT,
+    WORKINGSET_REFAULT_ANON,
+    WORKINGSET_REFAULT_FILE,
+    OOM_KILL,
+    COUNT, // Must be last
+  };
+  static constexpr size_t kNumKeys = static_cast<size_t>(Key::COUNT);
+  using KeySet = std::bitset<kNumKeys>;
+
+  static std::string_view keyName(Key key);
+  static std::optional<Key> keyFromName(std::string_view name);
+
+  std::optional<int64_t> get(Key key) const;
+  void set(Key key, int64_t value);
+  bool empty() const;
+
+  /*
+   * Per second rate of @param key between @param prev and this snapshot, or
+   * nullopt if either one lacks it.
+   */
+  std::optional<double> rate(
+      const Vmstat& prev,
+      Key key,
+      std::chrono::duration<double> interval) const;
+
+  /*
+   * Folds @param sample into the moving average @param prev_avg, keeping
+   * @param decay of the old value. decay is exp(-interval / window).
+   */
+  static double ewma(double prev_avg, double sample, double decay);
+
+ private:
+  std::array<int64_t, kNumKeys> values_{};
+  KeySet present_;
+};
+
+} // namespace Oomd
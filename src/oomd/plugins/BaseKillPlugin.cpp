@@ -74,6 +74,13 @@ int BaseKillPlugin::init(
     return 1;
   }
 
+  if (auto reads = prerunReads()) {
+    context.addPrerunDependency({cgroups_, recursive_, reads});
+  }
+  if (auto reads = rankingReads()) {
+    context.addRunDependency({cgroups_, false, reads});
+  }
+
   // Success
   return 0;
 }
@@ -103,6 +103,21 @@ class BaseKillPlugin : public Engine::BasePlugin {
       OomdContext& ctx,
       const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) = 0;
 
+  /*
+   * Override points declaring the CgroupContext::PrefetchRead bits prerun()
+   * reads through prerunOnCgroups(), and rankForKilling() reads of the
+   * "cgroup" config, so they're read ahead by OomdContext::prefetch(). Only
+   * the first level of a recursive ranking is covered. Called once "cgroup"
+   * and "recursive" are parsed, along with any other argument registered
+   * before BaseKillPlugin::init().
+   */
+  virtual uint16_t prerunReads() const {
+    return 0;
+  }
+  virtual uint16_t rankingReads() const {
+    return 0;
+  }
+
   /*
    * Override point to OLOG why plugin chose @param target to die.
    *
@@ -216,7 +216,7 @@ class AlphabeticStandardKillPlugin : public BaseKillPluginMock {
       const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) override {
     return OomdContext::sortDescWithKillPrefs(
         cgroups, [](const CgroupContext& cgroup_ctx) {
-          return cgroup_ctx.cgroup().relativePathParts().back();
+          return cgroup_ctx.cgroup().name();
         });
   }
 
@@ -696,10 +696,10 @@ TEST_F(PressureRisingBeyondTest, DetectsHighMemPressure) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "high_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
               ResourcePressure{
-                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99},
-          .current_usage = 987654321});
+                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99}});
 
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::CONTINUE);
 }
@@ -724,9 +724,10 @@ TEST_F(PressureRisingBeyondTest, NoDetectLowMemPressure) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "low_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
-              ResourcePressure{.sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11},
-          .current_usage = 987654321});
+              ResourcePressure{
+                  .sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11}});
 
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::STOP);
 }
@@ -752,17 +753,18 @@ TEST_F(PressureRisingBeyondTest, DetectsHighMemPressureMultiCgroup) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "high_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
               ResourcePressure{
-                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99},
-          .current_usage = 987654321});
+                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99}});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "low_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
-              ResourcePressure{.sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11},
-          .current_usage = 987654321});
+              ResourcePressure{
+                  .sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11}});
 
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::CONTINUE);
 }
@@ -788,17 +790,18 @@ TEST_F(PressureRisingBeyondTest, DetectsHighMemPressureWildcard) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "high_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
               ResourcePressure{
-                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99},
-          .current_usage = 987654321});
+                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99}});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "low_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
-              ResourcePressure{.sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11},
-          .current_usage = 987654321});
+              ResourcePressure{
+                  .sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11}});
 
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::CONTINUE);
 }
@@ -820,14 +823,21 @@ TEST_F(PressureAboveTest, DetectsHighMemPressure) {
 
   ASSERT_EQ(plugin->init(std::move(args), compile_context), 0);
 
+  // Wakes oomd up once 80% of a 1s window is stalled
+  const auto& triggers = compile_context.dataDependencies().pressure_triggers;
+  ASSERT_EQ(triggers.size(), 1);
+  EXPECT_EQ(triggers[0].resource, ResourceType::MEMORY);
+  EXPECT_EQ(triggers[0].stall, std::chrono::milliseconds(800));
+  EXPECT_EQ(triggers[0].window, std::chrono::seconds(1));
+
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "high_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
               ResourcePressure{
-                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99},
-          .current_usage = 987654321});
+                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99}});
 
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::CONTINUE);
 }
@@ -851,9 +861,10 @@ TEST_F(PressureAboveTest, NoDetectLowMemPressure) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "low_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
-              ResourcePressure{.sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11},
-          .current_usage = 987654321});
+              ResourcePressure{
+                  .sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11}});
 
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::STOP);
 }
@@ -878,17 +889,18 @@ TEST_F(PressureAboveTest, DetectsHighMemPressureMultiCgroup) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "high_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
               ResourcePressure{
-                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99},
-          .current_usage = 987654321});
+                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99}});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "low_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
-              ResourcePressure{.sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11},
-          .current_usage = 987654321});
+              ResourcePressure{
+                  .sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11}});
 
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::CONTINUE);
 }
@@ -913,17 +925,18 @@ TEST_F(PressureAboveTest, DetectsHighMemPressureWildcard) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "high_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
               ResourcePressure{
-                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99},
-          .current_usage = 987654321});
+                  .sec_10 = 99.99, .sec_60 = 99.99, .sec_300 = 99.99}});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "low_pressure"),
       CgroupData{
+          .current_usage = 987654321,
           .mem_pressure =
-              ResourcePressure{.sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11},
-          .current_usage = 987654321});
+              ResourcePressure{
+                  .sec_10 = 1.11, .sec_60 = 1.11, .sec_300 = 1.11}});
 
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::CONTINUE);
 }
@@ -1133,8 +1146,8 @@ TEST_F(MemoryAboveTest, DetectsHighAnonUsage) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "high_memory"),
       CgroupData{
-          .memory_stat = memory_stat_t{{"anon", 2147483648}},
           .swap_usage = 20,
+          .memory_stat = memory_stat_t{{"anon", 2147483648}},
       });
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::CONTINUE);
 }
@@ -1158,8 +1171,8 @@ TEST_F(MemoryAboveTest, NoDetectLowAnonUsage) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "low_memory"),
       CgroupData{
-          .memory_stat = memory_stat_t{{"anon", 1073741824}},
           .swap_usage = 20,
+          .memory_stat = memory_stat_t{{"anon", 1073741824}},
       });
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::STOP);
 }
@@ -1184,9 +1197,9 @@ TEST_F(MemoryAboveTest, DetectsHighAnonUsageIgnoreLowMemUsage) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "high_memory"),
       CgroupData{
-          .memory_stat = memory_stat_t{{"anon", 2147483648}},
           .current_usage = 1073741824,
           .swap_usage = 20,
+          .memory_stat = memory_stat_t{{"anon", 2147483648}},
       });
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::CONTINUE);
 }
@@ -1211,9 +1224,9 @@ TEST_F(MemoryAboveTest, NoDetectLowAnonUsageIgnoreHighMemUsage) {
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "low_memory"),
       CgroupData{
-          .memory_stat = memory_stat_t{{"anon", 1073741824}},
           .current_usage = 2147483648,
           .swap_usage = 20,
+          .memory_stat = memory_stat_t{{"anon", 1073741824}},
       });
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::STOP);
 }
@@ -1360,7 +1373,7 @@ TEST_F(KillIOCostTest, TemporalCounter) {
       ctx_, cgroup, CgroupData{.io_cost_cumulative = 10000});
   plugin->prerun(ctx_);
   EXPECT_TRUE(
-      TestHelper::getDataRef(*ctx_.addToCacheAndGet(cgroup)).io_cost_rate);
+      TestHelper::getData(*ctx_.addToCacheAndGet(cgroup)).io_cost_rate);
 }
 
 TEST_F(KillIOCostTest, KillsHighestIOCost) {
@@ -1378,19 +1391,19 @@ TEST_F(KillIOCostTest, KillsHighestIOCost) {
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "one_high/cgroup1"),
-      CgroupData{.io_cost_cumulative = 10000, .io_cost_rate = 10});
+      CgroupData{.io_cost_rate = 10, .io_cost_cumulative = 10000});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "one_high/cgroup2"),
-      CgroupData{.io_cost_cumulative = 5000, .io_cost_rate = 30});
+      CgroupData{.io_cost_rate = 30, .io_cost_cumulative = 5000});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "one_high/cgroup3"),
-      CgroupData{.io_cost_cumulative = 6000, .io_cost_rate = 50});
+      CgroupData{.io_cost_rate = 50, .io_cost_cumulative = 6000});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "sibling/cgroup1"),
-      CgroupData{.io_cost_cumulative = 20000, .io_cost_rate = 100});
+      CgroupData{.io_cost_rate = 100, .io_cost_cumulative = 20000});
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::STOP);
   EXPECT_THAT(plugin->killed, Contains(111));
   EXPECT_THAT(plugin->killed, Not(Contains(123)));
@@ -1414,19 +1427,19 @@ TEST_F(KillIOCostTest, KillsHighestIOCostMultiCgroup) {
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "one_high/cgroup1"),
-      CgroupData{.io_cost_cumulative = 10000, .io_cost_rate = 10});
+      CgroupData{.io_cost_rate = 10, .io_cost_cumulative = 10000});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "one_high/cgroup2"),
-      CgroupData{.io_cost_cumulative = 5000, .io_cost_rate = 30});
+      CgroupData{.io_cost_rate = 30, .io_cost_cumulative = 5000});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "one_high/cgroup3"),
-      CgroupData{.io_cost_cumulative = 6000, .io_cost_rate = 50});
+      CgroupData{.io_cost_rate = 50, .io_cost_cumulative = 6000});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "sibling/cgroup1"),
-      CgroupData{.io_cost_cumulative = 20000, .io_cost_rate = 100});
+      CgroupData{.io_cost_rate = 100, .io_cost_cumulative = 20000});
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::STOP);
   EXPECT_THAT(plugin->killed, Contains(888));
   EXPECT_THAT(plugin->killed, Not(Contains(111)));
@@ -1451,19 +1464,19 @@ TEST_F(KillIOCostTest, DoesntKillsHighestIOCostDry) {
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "one_high/cgroup1"),
-      CgroupData{.io_cost_cumulative = 10000, .io_cost_rate = 10});
+      CgroupData{.io_cost_rate = 10, .io_cost_cumulative = 10000});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "one_high/cgroup2"),
-      CgroupData{.io_cost_cumulative = 5000, .io_cost_rate = 30});
+      CgroupData{.io_cost_rate = 30, .io_cost_cumulative = 5000});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "one_high/cgroup3"),
-      CgroupData{.io_cost_cumulative = 6000, .io_cost_rate = 50});
+      CgroupData{.io_cost_rate = 50, .io_cost_cumulative = 6000});
   TestHelper::setCgroupData(
       ctx_,
       CgroupPath(compile_context.cgroupFs(), "sibling/cgroup1"),
-      CgroupData{.io_cost_cumulative = 20000, .io_cost_rate = 100});
+      CgroupData{.io_cost_rate = 100, .io_cost_cumulative = 20000});
   EXPECT_EQ(plugin->run(ctx_), Engine::PluginRet::STOP);
   EXPECT_EQ(plugin->killed.size(), 0);
 }
@@ -1650,6 +1663,51 @@ TEST_F(KillPgScanTest, DoesntKillsHighestPgScanDry) {
   EXPECT_EQ(plugin->killed.size(), 0);
 }
 
+/*
+ * Verify prerun() only collects pgscan every tick when history keeps it, and
+ * otherwise leaves it to the 2-tick kill.
+ */
+TEST_F(KillPgScanTest, PrerunCollectsOnlyWithHistory) {
+  const PluginConstructionContext compile_context(
+      "oomd/fixtures/plugins/kill_by_pg_scan");
+  auto set_pg_scan = [&](int64_t cgroup1, int64_t cgroup2) {
+    TestHelper::setCgroupData(
+        ctx_,
+        CgroupPath(compile_context.cgroupFs(), "one_high/cgroup1"),
+        CgroupData{.pg_scan_cumulative = cgroup1});
+    TestHelper::setCgroupData(
+        ctx_,
+        CgroupPath(compile_context.cgroupFs(), "one_high/cgroup2"),
+        CgroupData{.pg_scan_cumulative = cgroup2});
+  };
+
+  for (int64_t history_samples : {0, 2}) {
+    ContextParams params;
+    params.history_samples = history_samples;
+    ctx_ = OomdContext(params);
+    auto plugin = std::make_shared<KillPgScan<BaseKillPluginMock>>();
+    Engine::PluginArgs args;
+    args["cgroup"] = "one_high/cgroup1,one_high/cgroup2";
+    args["post_action_delay"] = "0";
+    ASSERT_EQ(plugin->init(std::move(args), compile_context), 0);
+
+    // Nothing to kill yet, but prerun() runs every tick
+    set_pg_scan(10000, 5000);
+    plugin->prerun(ctx_);
+    ctx_.refresh();
+    ctx_.bumpCurrentTick();
+
+    set_pg_scan(10010, 5030);
+    plugin->prerun(ctx_);
+    EXPECT_EQ(
+        plugin->run(ctx_),
+        history_samples > 0 ? Engine::PluginRet::STOP
+                            : Engine::PluginRet::ASYNC_PAUSED)
+        << history_samples;
+    EXPECT_EQ(plugin->killed.empty(), history_samples == 0) << history_samples;
+  }
+}
+
 TEST_F(KillPgScanTest, CanTargetRecursively) {
   // without cgroup.controllers, CgroupContext::refresh() thinks the cgroup was
   // removed, and gets itself removed from OomdContext's cache.
@@ -1907,7 +1965,7 @@ TEST_F(KillMemoryGrowthTest, TemporalCounter) {
   TestHelper::setCgroupData(ctx_, cgroup, CgroupData{.current_usage = 60});
   plugin->prerun(ctx_);
   EXPECT_TRUE(
-      TestHelper::getDataRef(*ctx_.addToCacheAndGet(cgroup)).average_usage);
+      TestHelper::getData(*ctx_.addToCacheAndGet(cgroup)).average_usage);
 }
 
 TEST_F(KillMemoryGrowthTest, KillsBigCgroup) {
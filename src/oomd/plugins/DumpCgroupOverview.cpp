@@ -22,15 +22,12 @@
 #include <sstream>
 
 #include "oomd/Log.h"
+#include "oomd/OomdContext.h"
 #include "oomd/PluginRegistry.h"
 #include "oomd/include/CgroupPath.h"
-#include "oomd/util/Fs.h"
 #include "oomd/util/Util.h"
 
 namespace {
-auto constexpr kPgscanSwap = "pgscan_kswapd";
-auto constexpr kPgscanDirect = "pgscan_direct";
-
 void dumpCgroupOverview(const Oomd::CgroupContext& cgroup_ctx, bool always) {
   // Only log on exceptional cases
   auto pressure = cgroup_ctx.mem_pressure().value_or(Oomd::ResourcePressure{});
@@ -41,20 +38,13 @@ void dumpCgroupOverview(const Oomd::CgroupContext& cgroup_ctx, bool always) {
 
   const auto& path = cgroup_ctx.cgroup();
   const int64_t current = cgroup_ctx.current_usage().value_or(0);
-  // TODO(dschatzberg): Report error
-  auto meminfo = Oomd::Fs::getMeminfo();
-  int64_t swapfree = 0;
-  int64_t swaptotal = 0;
-  if (meminfo) {
-    swapfree = (*meminfo)["SwapFree"];
-    swaptotal = (*meminfo)["SwapTotal"];
-  }
-  int64_t pgscan = 0;
-  // TODO(dschatzberg): Report error
-  auto vmstat = Oomd::Fs::getVmstat();
-  if (vmstat) {
-    pgscan = (*vmstat)[kPgscanSwap] + (*vmstat)[kPgscanDirect];
-  }
+  const auto& system_ctx = cgroup_ctx.oomd_ctx().getSystemContext();
+  const auto& meminfo = system_ctx.meminfo;
+  int64_t swapfree = meminfo.count("SwapFree") ? meminfo.at("SwapFree") : 0;
+  int64_t swaptotal = meminfo.count("SwapTotal") ? meminfo.at("SwapTotal") : 0;
+  int64_t pgscan =
+      system_ctx.vmstat.get(Oomd::Vmstat::Key::PGSCAN_KSWAPD).value_or(0) +
+      system_ctx.vmstat.get(Oomd::Vmstat::Key::PGSCAN_DIRECT).value_or(0);
 
   std::ostringstream oss;
   oss << std::setprecision(2) << std::fixed;
@@ -87,6 +77,9 @@ int DumpCgroupOverview::init(
     return 1;
   }
 
+  context.addVmstatKey(Vmstat::Key::PGSCAN_KSWAPD);
+  context.addVmstatKey(Vmstat::Key::PGSCAN_DIRECT);
+
   return 0;
 }
 
@@ -22,6 +22,7 @@
 #include <utility>
 #include <vector>
 
+#include "oomd/CgroupSnapshot.h"
 #include "oomd/Log.h"
 #include "oomd/include/Types.h"
 #include "oomd/util/Util.h"
@@ -40,10 +41,9 @@ std::vector<OomdContext::ConstCgroupContextRef>
 KillIOCost<Base>::rankForKilling(
     OomdContext& ctx,
     const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) {
-  return OomdContext::sortDescWithKillPrefs(
-      cgroups, [](const CgroupContext& cgroup_ctx) {
-        return cgroup_ctx.io_cost_rate().value_or(0);
-      });
+  CgroupSnapshot snapshot(cgroups, CgroupSnapshot::IO_COST_RATE);
+  return snapshot.sortDescWithKillPrefs(
+      snapshot.rows(), snapshot.io_cost_rate);
 }
 
 template <typename Base>
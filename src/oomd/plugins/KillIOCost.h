@@ -40,6 +40,10 @@ class KillIOCost : public Base {
       OomdContext& ctx,
       const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) override;
 
+  uint16_t prerunReads() const override {
+    return CgroupContext::PREFETCH_IO_COST_STAT;
+  }
+
   void ologKillTarget(
       OomdContext& ctx,
       const CgroupContext& target,
@@ -16,7 +16,9 @@
  */
 
 #include <algorithm>
+#include <functional>
 #include <iomanip>
+#include <numeric>
 #include <string>
 #include <utility>
 #include <vector>
@@ -55,18 +57,18 @@ void KillMemoryGrowth<Base>::prerun(OomdContext& ctx) {
 
 template <typename Base>
 std::function<std::pair<KMGPhase, std::tuple<int64_t, float, int64_t>>(
-    const CgroupContext&)>
+    int64_t,
+    int64_t,
+    float)>
 KillMemoryGrowth<Base>::get_ranking_fn(
     OomdContext& ctx,
-    const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) {
+    const CgroupSnapshot& snapshot) {
   // First, compute respective thresholds for inclusion in the first 2
   // phases, size_threshold_in_bytes and
   // growth_kill_min_effective_usage_threshold.
 
-  int64_t cur_memcurrent = 0;
-  for (const CgroupContext& cgroup_ctx : cgroups) {
-    cur_memcurrent += cgroup_ctx.current_usage().value_or(0);
-  }
+  int64_t cur_memcurrent = std::accumulate(
+      snapshot.current_usage.begin(), snapshot.current_usage.end(), int64_t{0});
   int64_t size_threshold_in_bytes =
       cur_memcurrent * (static_cast<double>(size_threshold_) / 100);
 
@@ -74,31 +76,25 @@ KillMemoryGrowth<Base>::get_ranking_fn(
   // for killing by growth. nth is the index of the idx of the cgroup w/
   // smallest usage in the top P(growing_size_percentile_)
   int64_t growth_kill_min_effective_usage_threshold = 0;
-  if (cgroups.size() > 0) {
+  if (snapshot.size() > 0) {
     const size_t nth =
         std::ceil(
-            cgroups.size() *
+            snapshot.size() *
             (100 - static_cast<double>(growing_size_percentile_)) / 100) -
         1;
-    auto cgroups_mutable_copy = cgroups;
+    auto usage_mutable_copy = snapshot.effective_usage;
+    // order by effective_usage desc
     std::nth_element(
-        cgroups_mutable_copy.begin(),
-        cgroups_mutable_copy.begin() + nth,
-        cgroups_mutable_copy.end(),
-        [](const auto& a, const auto& b) {
-          // order by effective_usage desc
-          return a.get().effective_usage().value_or(0) >
-              b.get().effective_usage().value_or(0);
-        });
-    growth_kill_min_effective_usage_threshold =
-        cgroups_mutable_copy[nth].get().effective_usage().value_or(0);
+        usage_mutable_copy.begin(),
+        usage_mutable_copy.begin() + nth,
+        usage_mutable_copy.end(),
+        std::greater<int64_t>());
+    growth_kill_min_effective_usage_threshold = usage_mutable_copy[nth];
   }
 
-  return [=](const CgroupContext& cgroup_ctx) {
-    int64_t current_usage = cgroup_ctx.current_usage().value_or(0);
-    int64_t effective_usage = cgroup_ctx.effective_usage().value_or(0);
-    float growth_ratio = cgroup_ctx.memory_growth().value_or(0);
-
+  return [=](int64_t current_usage,
+             int64_t effective_usage,
+             float growth_ratio) {
     bool size_phase_eligible = current_usage >= size_threshold_in_bytes;
     auto growth_phase_eligible = growth_ratio >= min_growth_ratio_ &&
         effective_usage >= growth_kill_min_effective_usage_threshold;
@@ -128,14 +124,24 @@ std::vector<OomdContext::ConstCgroupContextRef>
 KillMemoryGrowth<Base>::rankForKilling(
     OomdContext& ctx,
     const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) {
-  auto rank_cgroup = get_ranking_fn(ctx, cgroups);
+  CgroupSnapshot snapshot(
+      cgroups,
+      CgroupSnapshot::CURRENT_USAGE | CgroupSnapshot::EFFECTIVE_USAGE |
+          CgroupSnapshot::MEMORY_GROWTH);
+  auto rank_cgroup = get_ranking_fn(ctx, snapshot);
+
+  std::vector<std::tuple<int64_t, float, int64_t>> ranks(snapshot.size());
+  for (size_t i = 0; i < snapshot.size(); ++i) {
+    ranks[i] = rank_cgroup(
+                   snapshot.current_usage[i],
+                   snapshot.effective_usage[i],
+                   snapshot.memory_growth[i])
+                   .second;
+  }
 
   // Note kill_preference take priority over phase, which is
   // handled automatically by sortDescWithKillPrefs.
-  return OomdContext::sortDescWithKillPrefs(
-      cgroups, [&](const CgroupContext& cgroup_ctx) {
-        return rank_cgroup(cgroup_ctx).second;
-      });
+  return snapshot.sortDescWithKillPrefs(snapshot.rows(), ranks);
 }
 
 template <typename Base>
@@ -143,14 +149,20 @@ void KillMemoryGrowth<Base>::ologKillTarget(
     OomdContext& ctx,
     const CgroupContext& target,
     const std::vector<OomdContext::ConstCgroupContextRef>& peers) {
-  auto rank_cgroup = get_ranking_fn(ctx, peers);
-
-  int64_t sib_memcurrent = 0;
-  for (const CgroupContext& cgroup_ctx : peers) {
-    sib_memcurrent += cgroup_ctx.current_usage().value_or(0);
-  }
-
-  switch (rank_cgroup(target).first) {
+  CgroupSnapshot snapshot(
+      peers,
+      CgroupSnapshot::CURRENT_USAGE | CgroupSnapshot::EFFECTIVE_USAGE);
+  auto rank_cgroup = get_ranking_fn(ctx, snapshot);
+
+  int64_t sib_memcurrent = std::accumulate(
+      snapshot.current_usage.begin(), snapshot.current_usage.end(), int64_t{0});
+
+  auto phase = rank_cgroup(
+                   target.current_usage().value_or(0),
+                   target.effective_usage().value_or(0),
+                   target.memory_growth().value_or(0))
+                   .first;
+  switch (phase) {
     case KMGPhase::SIZE_THRESHOLD: {
       OLOG << "Picked \"" << target.cgroup().relativePath() << "\" ("
            << target.current_usage().value_or(0) / 1024 / 1024
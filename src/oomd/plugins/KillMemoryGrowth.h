@@ -21,6 +21,7 @@
 #include <cmath>
 #include <unordered_set>
 
+#include "oomd/CgroupSnapshot.h"
 #include "oomd/plugins/BaseKillPlugin.h"
 
 namespace Oomd {
@@ -53,16 +54,22 @@ class KillMemoryGrowth : public Base {
       OomdContext& ctx,
       const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) override;
 
+  // Ranking reads the same, as of the current interval
+  uint16_t prerunReads() const override {
+    return CgroupContext::PREFETCH_CURRENT_USAGE;
+  }
+
   void ologKillTarget(
       OomdContext& ctx,
       const CgroupContext& target,
       const std::vector<OomdContext::ConstCgroupContextRef>& peers) override;
 
+  // Returned functor takes current_usage, effective_usage and memory_growth
   std::function<std::pair<KMGPhase, std::tuple<int64_t, float, int64_t>>(
-      const CgroupContext&)>
-  get_ranking_fn(
-      OomdContext& ctx,
-      const std::vector<OomdContext::ConstCgroupContextRef>& cgroups);
+      int64_t,
+      int64_t,
+      float)>
+  get_ranking_fn(OomdContext& ctx, const CgroupSnapshot& snapshot);
 
   int size_threshold_{50};
   int growing_size_percentile_{80};
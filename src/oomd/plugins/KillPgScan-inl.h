@@ -22,6 +22,7 @@
 #include <utility>
 #include <vector>
 
+#include "oomd/CgroupSnapshot.h"
 #include "oomd/Log.h"
 #include "oomd/engine/BasePlugin.h"
 #include "oomd/include/Types.h"
@@ -31,16 +32,32 @@
 namespace Oomd {
 
 template <typename Base>
-Engine::PluginRet KillPgScan<Base>::run(OomdContext& ctx) {
-  bool has_prev_tick_data =
+void KillPgScan<Base>::collect(OomdContext& ctx) {
+  if (last_tick_data_was_collected_ == ctx.getCurrentTick()) {
+    return;
+  }
+  has_prev_tick_data_ =
       (last_tick_data_was_collected_ == ctx.getCurrentTick() - 1);
 
-  // always collect pg scan data
   Base::prerunOnCgroups(
       ctx, [](const auto& cgroup_ctx) { cgroup_ctx.pg_scan_rate(); });
   last_tick_data_was_collected_ = ctx.getCurrentTick();
+}
+
+template <typename Base>
+void KillPgScan<Base>::prerun(OomdContext& ctx) {
+  // Only worth reading the whole subtree every tick if history keeps it
+  if (ctx.getParams().history_samples > 0) {
+    collect(ctx);
+  }
+}
+
+template <typename Base>
+Engine::PluginRet KillPgScan<Base>::run(OomdContext& ctx) {
+  // always collect pg scan data
+  collect(ctx);
 
-  if (!has_prev_tick_data) {
+  if (!has_prev_tick_data_) {
     // wait until we have 2 ticks of data to compare
     return Engine::PluginRet::ASYNC_PAUSED;
   }
@@ -76,10 +93,9 @@ KillPgScan<Base>::rankForKilling(
     }
   }
 
-  return OomdContext::sortDescWithKillPrefs(
-      cgroups, [](const CgroupContext& cgroup_ctx) {
-        return cgroup_ctx.pg_scan_rate().value_or(0);
-      });
+  CgroupSnapshot snapshot(cgroups, CgroupSnapshot::PG_SCAN_RATE);
+  return snapshot.sortDescWithKillPrefs(
+      snapshot.rows(), snapshot.pg_scan_rate);
 }
 
 template <typename Base>
@@ -28,6 +28,8 @@ namespace Oomd {
 template <typename Base = BaseKillPlugin>
 class KillPgScan : public Base {
  public:
+  void prerun(OomdContext& ctx) override;
+
   Engine::PluginRet run(OomdContext& ctx) override;
 
   static KillPgScan* create() {
@@ -41,11 +43,18 @@ class KillPgScan : public Base {
       OomdContext& ctx,
       const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) override;
 
+  uint16_t rankingReads() const override {
+    return CgroupContext::PREFETCH_MEMORY_STAT;
+  }
+
   void ologKillTarget(
       OomdContext& ctx,
       const CgroupContext& target,
       const std::vector<OomdContext::ConstCgroupContextRef>& peers) override;
 
+  // Reads pgscan of the cgroups, once per tick
+  void collect(OomdContext& ctx);
+
   /*
    * KillPgScan has a 2-tick kill. It needs to collect pgscan data over time
    * so it can pick the cgroup whose pgscan grew the most over the last tick.
@@ -56,8 +65,12 @@ class KillPgScan : public Base {
    * multiple ticks (thanks to async prekill hooks) and we don't want
    * accidentally stale-ish data.
    * If we haven't collected data in 2 ticks, consider it dropped to be safe.
+   * With ContextParams::history_samples set, prerun() collects every tick
+   * instead, which keeps pgscan in CgroupContext::history() and lets the
+   * first run() kill right away.
    */
   std::optional<uint64_t> last_tick_data_was_collected_{std::nullopt};
+  bool has_prev_tick_data_{false};
 };
 
 } // namespace Oomd
@@ -22,6 +22,7 @@
 #include <utility>
 #include <vector>
 
+#include "oomd/CgroupSnapshot.h"
 #include "oomd/Log.h"
 #include "oomd/include/Types.h"
 #include "oomd/util/Util.h"
@@ -42,24 +43,19 @@ std::vector<OomdContext::ConstCgroupContextRef>
 KillPressure<Base>::rankForKilling(
     OomdContext& ctx,
     const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) {
-  return OomdContext::sortDescWithKillPrefs(
-      cgroups, [&](const CgroupContext& cgroup_ctx) {
-        int average = 0;
-        switch (resource_) {
-          case ResourceType::IO:
-            if (const auto& pressure = cgroup_ctx.io_pressure()) {
-              average = pressure->sec_10 / 2 + pressure->sec_60 / 2;
-            }
-            break;
-          case ResourceType::MEMORY:
-            if (const auto& pressure = cgroup_ctx.mem_pressure()) {
-              average = pressure->sec_10 / 2 + pressure->sec_60 / 2;
-            }
-            break;
-        }
+  CgroupSnapshot snapshot(
+      cgroups,
+      resource_ == ResourceType::IO ? CgroupSnapshot::IO_PRESSURE
+                                    : CgroupSnapshot::MEM_PRESSURE);
+  const auto& pressure = resource_ == ResourceType::IO ? snapshot.io_pressure
+                                                       : snapshot.mem_pressure;
 
-        return average;
-      });
+  std::vector<int> averages(snapshot.size());
+  for (size_t i = 0; i < snapshot.size(); ++i) {
+    averages[i] = pressure.sec_10[i] / 2 + pressure.sec_60[i] / 2;
+  }
+
+  return snapshot.sortDescWithKillPrefs(snapshot.rows(), averages);
 }
 
 template <typename Base>
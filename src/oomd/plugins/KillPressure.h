@@ -42,6 +42,11 @@ class KillPressure : public Base {
       OomdContext& ctx,
       const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) override;
 
+  uint16_t rankingReads() const override {
+    return resource_ == ResourceType::IO ? CgroupContext::PREFETCH_IO_PRESSURE
+                                         : CgroupContext::PREFETCH_MEM_PRESSURE;
+  }
+
   void ologKillTarget(
       OomdContext& ctx,
       const CgroupContext& target,
@@ -22,6 +22,7 @@
 #include <utility>
 #include <vector>
 
+#include "oomd/CgroupSnapshot.h"
 #include "oomd/Log.h"
 #include "oomd/include/Types.h"
 #include "oomd/util/Fs.h"
@@ -64,15 +65,11 @@ std::vector<OomdContext::ConstCgroupContextRef>
 KillSwapUsage<Base>::rankForKilling(
     OomdContext& ctx,
     const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) {
-  return OomdContext::sortDescWithKillPrefs(
-      Util::filter(
-          cgroups,
-          [=](const CgroupContext& cgroup_ctx) {
-            return cgroup_ctx.swap_usage().value_or(0) >= threshold_;
-          }),
-      [](const CgroupContext& cgroup_ctx) {
-        return cgroup_ctx.swap_usage().value_or(0);
-      });
+  CgroupSnapshot snapshot(cgroups, CgroupSnapshot::SWAP_USAGE);
+  return snapshot.sortDescWithKillPrefs(
+      snapshot.rows(
+          [&](uint32_t i) { return snapshot.swap_usage[i] >= threshold_; }),
+      snapshot.swap_usage);
 }
 
 template <typename Base>
@@ -41,6 +41,10 @@ class KillSwapUsage : public Base {
       OomdContext& ctx,
       const std::vector<OomdContext::ConstCgroupContextRef>& cgroups) override;
 
+  uint16_t rankingReads() const override {
+    return CgroupContext::PREFETCH_SWAP_USAGE;
+  }
+
   void ologKillTarget(
       OomdContext& ctx,
       const CgroupContext& target,
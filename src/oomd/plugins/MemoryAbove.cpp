@@ -93,6 +93,12 @@ int MemoryAbove::init(
     return 1;
   }
 
+  context.addRunDependency(
+      {cgroups_,
+       false,
+       is_anon_ ? CgroupContext::PREFETCH_MEMORY_STAT
+                : CgroupContext::PREFETCH_CURRENT_USAGE});
+
   // Success
   return 0;
 }
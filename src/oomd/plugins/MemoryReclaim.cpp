@@ -22,8 +22,6 @@
 #include "oomd/util/ScopeGuard.h"
 #include "oomd/util/Util.h"
 
-static constexpr auto kPgscan = "pgscan";
-
 namespace Oomd {
 
 REGISTER_PLUGIN(memory_reclaim, MemoryReclaim::create);
@@ -45,6 +43,9 @@ int MemoryReclaim::init(
     return 1;
   }
 
+  context.addRunDependency(
+      {cgroups_, false, CgroupContext::PREFETCH_MEMORY_STAT});
+
   // Success
   return 0;
 }
@@ -55,9 +56,7 @@ Engine::PluginRet MemoryReclaim::run(OomdContext& ctx) {
   int64_t pgscan = 0;
   for (const CgroupContext& cgroup_ctx : ctx.addToCacheAndGet(cgroups_)) {
     if (const auto& memstat = cgroup_ctx.memory_stat()) {
-      if (auto pos = memstat->find(kPgscan); pos != memstat->end()) {
-        pgscan += pos->second;
-      }
+      pgscan += memstat->get(MemoryStat::Key::PGSCAN).value_or(0);
     }
   }
 
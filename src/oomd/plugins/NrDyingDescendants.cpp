@@ -46,6 +46,9 @@ int NrDyingDescendants::init(
     return 1;
   }
 
+  context.addRunDependency(
+      {cgroups_, false, CgroupContext::PREFETCH_NR_DYING_DESCENDANTS});
+
   // Success
   return 0;
 }
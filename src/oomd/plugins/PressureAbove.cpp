@@ -48,6 +48,8 @@ int PressureAbove::init(
     return 1;
   }
 
+  context.addPressureDetector(cgroups_, resource_, threshold_);
+
   // Success
   return 0;
 }
@@ -51,6 +51,8 @@ int PressureRisingBeyond::init(
     return 1;
   }
 
+  context.addPressureDetector(cgroups_, resource_, threshold_);
+
   // Success
   return 0;
 }
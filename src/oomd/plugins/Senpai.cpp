@@ -152,9 +152,8 @@ std::optional<std::chrono::microseconds> getPressureTotalSome(
     const CgroupContext& cgroup_ctx) {
   // Senpai reads pressure.some to get early notice that a workload
   // may be under resource pressure
-  if (const auto pressure = Oomd::Fs::readMempressureAt(
-          cgroup_ctx.fd(), Oomd::Fs::PressureType::SOME)) {
-    if (const auto total = pressure.value().total) {
+  if (const auto& pressure = cgroup_ctx.mem_pressure_some()) {
+    if (const auto total = pressure->total) {
       return total.value();
     }
     throw std::runtime_error("Senpai enabled but no total pressure info");
@@ -354,13 +353,12 @@ SystemMaybe<int64_t> Senpai::getReclaimableBytes(
     return SYSTEM_ERROR(ENOENT);
   }
 
-  auto active_file_pos = stat_opt->find("active_file");
-  auto inactive_file_pos = stat_opt->find("inactive_file");
-  if (active_file_pos == stat_opt->end() ||
-      inactive_file_pos == stat_opt->end()) {
+  auto active_file = stat_opt->get(MemoryStat::Key::ACTIVE_FILE);
+  auto inactive_file = stat_opt->get(MemoryStat::Key::INACTIVE_FILE);
+  if (!active_file || !inactive_file) {
     throw std::runtime_error("Invalid memory.stat cgroup file");
   }
-  auto file_cache = active_file_pos->second + inactive_file_pos->second;
+  auto file_cache = *active_file + *inactive_file;
 
   int64_t swappable = 0;
   const auto& system_ctx = cgroup_ctx.oomd_ctx().getSystemContext();
@@ -369,13 +367,12 @@ SystemMaybe<int64_t> Senpai::getReclaimableBytes(
     if (!effective_swap_free_opt) {
       return SYSTEM_ERROR(ENOENT);
     } else if (*effective_swap_free_opt > 0) {
-      auto active_anon_pos = stat_opt->find("active_anon");
-      auto inactive_anon_pos = stat_opt->find("inactive_anon");
-      if (active_anon_pos == stat_opt->end() ||
-          inactive_anon_pos == stat_opt->end()) {
+      auto active_anon = stat_opt->get(MemoryStat::Key::ACTIVE_ANON);
+      auto inactive_anon = stat_opt->get(MemoryStat::Key::INACTIVE_ANON);
+      if (!active_anon || !inactive_anon) {
         return SYSTEM_ERROR(EINVAL);
       }
-      auto anon_size = active_anon_pos->second + inactive_anon_pos->second;
+      auto anon_size = *active_anon + *inactive_anon;
       swappable = std::min(*effective_swap_free_opt, anon_size);
     }
   }
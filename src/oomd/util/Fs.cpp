@@ -21,13 +21,19 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <glob.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
 #include <sys/types.h>
 #include <sys/xattr.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <cinttypes>
 #include <deque>
 #include <fstream>
@@ -47,29 +53,331 @@ enum class PsiFormat {
   UPSTREAM, // Upstream kernel format
 };
 
-PsiFormat getPsiFormat(const std::vector<std::string>& lines) {
-  if (lines.size() == 0) {
+// Initial size of the per-thread buffer backing Fs::readFileAt(). Covers every
+// scalar control file and most multi-line ones without growing.
+constexpr size_t kReadBufferInitialSize = 4096;
+
+std::vector<char>& readBuffer() {
+  thread_local std::vector<char> buf(kReadBufferInitialSize);
+  return buf;
+}
+
+// Layout of the records getdents64() fills in. glibc only exposes it through
+// a wrapper that older versions lack.
+struct LinuxDirent64 {
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+
+std::vector<char>& direntBuffer() {
+  // Fits a few hundred cgroups per getdents64() call
+  thread_local std::vector<char> buf(32 * 1024);
+  return buf;
+}
+
+/*
+ * Appends every expansion of the {a,b} braces in @param pattern to @param out,
+ * the way GLOB_BRACE does. "{}" and unbalanced braces are kept literally.
+ */
+void expandBraces(const std::string& pattern, std::vector<std::string>& out) {
+  for (size_t open = pattern.find('{'); open != std::string::npos;
+       open = pattern.find('{', open + 1)) {
+    // Find the matching close brace and the commas at this depth
+    std::vector<size_t> commas;
+    size_t close = std::string::npos;
+    int depth = 0;
+    for (size_t i = open + 1; i < pattern.size(); ++i) {
+      if (pattern[i] == '{') {
+        depth++;
+      } else if (pattern[i] == '}' && depth-- == 0) {
+        close = i;
+        break;
+      } else if (pattern[i] == ',' && depth == 0) {
+        commas.push_back(i);
+      }
+    }
+    if (close == std::string::npos) {
+      break;
+    } else if (close == open + 1) {
+      continue;
+    }
+
+    auto prefix = pattern.substr(0, open);
+    auto suffix = pattern.substr(close + 1);
+    commas.push_back(close);
+    size_t start = open + 1;
+    for (auto end : commas) {
+      expandBraces(
+          prefix + pattern.substr(start, end - start) + suffix, out);
+      start = end + 1;
+    }
+    return;
+  }
+  out.push_back(pattern);
+}
+
+bool hasWildcard(const std::string& component) {
+  return component.find_first_of("*?[") != std::string::npos;
+}
+
+/*
+ * Pops the next line off @param content. Like getline(), a trailing newline
+ * does not produce an empty last line.
+ */
+std::string_view nextLine(std::string_view& content) {
+  auto pos = content.find('\n');
+  auto line = content.substr(0, pos);
+  content.remove_prefix(
+      pos == std::string_view::npos ? content.size() : pos + 1);
+  return line;
+}
+
+/*
+ * Pops the next @param delim separated token off @param s. Empty tokens are
+ * skipped, same as Util::split().
+ */
+std::string_view nextToken(std::string_view& s, char delim = ' ') {
+  while (!s.empty() && s.front() == delim) {
+    s.remove_prefix(1);
+  }
+  auto pos = s.find(delim);
+  auto tok = s.substr(0, pos);
+  s.remove_prefix(pos == std::string_view::npos ? s.size() : pos);
+  return tok;
+}
+
+// Like nextToken() but splits on any run of spaces and tabs
+std::string_view nextField(std::string_view& s) {
+  constexpr std::string_view kBlanks = " \t";
+  auto start = s.find_first_not_of(kBlanks);
+  s.remove_prefix(start == std::string_view::npos ? s.size() : start);
+  auto pos = s.find_first_of(kBlanks);
+  auto tok = s.substr(0, pos);
+  s.remove_prefix(pos == std::string_view::npos ? s.size() : pos);
+  return tok;
+}
+
+/*
+ * Splits off the first N lines of @param content. Returns them with the total
+ * number of lines, which may be larger than N.
+ */
+template <size_t N>
+std::pair<std::array<std::string_view, N>, size_t> firstLines(
+    std::string_view content) {
+  std::array<std::string_view, N> lines;
+  size_t nr_lines = 0;
+  while (!content.empty()) {
+    auto line = nextLine(content);
+    if (nr_lines < N) {
+      lines[nr_lines] = line;
+    }
+    ++nr_lines;
+  }
+  return {lines, nr_lines};
+}
+
+template <typename T>
+std::optional<T> parseNumber(std::string_view s) {
+  T val;
+  auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), val);
+  if (ec != std::errc() || ptr == s.data()) {
+    return std::nullopt;
+  }
+  return val;
+}
+
+/*
+ * Parses "<key><delim><value>" where value is a number. Returns false if
+ * @param key doesn't match or the value fails to parse.
+ */
+template <typename T>
+bool parseKeyValue(std::string_view tok, std::string_view key, T& out) {
+  auto k = nextToken(tok, '=');
+  if (k != key) {
+    return false;
+  }
+  auto val = parseNumber<T>(nextToken(tok, '='));
+  if (!val) {
+    return false;
+  }
+  out = *val;
+  return true;
+}
+
+PsiFormat getPsiFormat(std::string_view first, size_t nr_lines) {
+  if (nr_lines == 0) {
     return PsiFormat::MISSING;
   }
 
-  const auto& first = lines[0];
-  if (Oomd::Util::startsWith("some", first) && lines.size() >= 2) {
+  if (first.substr(0, 4) == "some" && nr_lines >= 2) {
     return PsiFormat::UPSTREAM;
-  } else if (Oomd::Util::startsWith("aggr", first) && lines.size() >= 3) {
+  } else if (first.substr(0, 4) == "aggr" && nr_lines >= 3) {
     return PsiFormat::EXPERIMENTAL;
   } else {
     return PsiFormat::INVALID;
   }
 }
 
+/*
+ * Parses a PSI average such as "12.34". The kernel prints them as fixed point
+ * with two decimals, so a plain digit scan beats strtof() by a wide margin.
+ */
+std::optional<float> parsePsiAvg(std::string_view s) {
+  uint64_t integral = 0;
+  uint64_t fraction = 0;
+  uint64_t scale = 1;
+  size_t i = 0;
+  for (; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i) {
+    integral = integral * 10 + (s[i] - '0');
+  }
+  if (i == 0) {
+    return std::nullopt;
+  }
+  if (i < s.size() && s[i] == '.') {
+    for (++i; i < s.size() && s[i] >= '0' && s[i] <= '9'; ++i) {
+      // Anything beyond 9 decimals doesn't matter for a float
+      if (scale < 1000000000) {
+        fraction = fraction * 10 + (s[i] - '0');
+        scale *= 10;
+      }
+    }
+  }
+  if (i != s.size()) {
+    return std::nullopt;
+  }
+  return static_cast<float>(
+      integral + static_cast<double>(fraction) / static_cast<double>(scale));
+}
+
+// Parses "avg10=0.22" style tokens
+bool parsePsiAvgKey(std::string_view tok, std::string_view key, float& out) {
+  if (nextToken(tok, '=') != key) {
+    return false;
+  }
+  auto val = parsePsiAvg(nextToken(tok, '='));
+  if (!val) {
+    return false;
+  }
+  out = *val;
+  return true;
+}
+
+// Upstream v4.16+ format, e.g.
+//
+// some avg10=0.22 avg60=0.17 avg300=1.11 total=58761459
+bool parseUpstreamPsiLine(
+    std::string_view line,
+    std::string_view type_name,
+    Oomd::ResourcePressure& pressure) {
+  uint64_t total;
+  if (nextToken(line) != type_name ||
+      !parsePsiAvgKey(nextToken(line), "avg10", pressure.sec_10) ||
+      !parsePsiAvgKey(nextToken(line), "avg60", pressure.sec_60) ||
+      !parsePsiAvgKey(nextToken(line), "avg300", pressure.sec_300) ||
+      !parseKeyValue(nextToken(line), "total", total)) {
+    return false;
+  }
+  pressure.total = std::chrono::microseconds(total);
+  return true;
+}
+
+// Old experimental format, e.g.
+//
+// some 0.00 0.03 0.05
+bool parseExperimentalPsiLine(
+    std::string_view line,
+    std::string_view type_name,
+    Oomd::ResourcePressure& pressure) {
+  if (nextToken(line) != type_name) {
+    return false;
+  }
+  auto sec_10 = parsePsiAvg(nextToken(line));
+  auto sec_60 = parsePsiAvg(nextToken(line));
+  auto sec_300 = parsePsiAvg(nextToken(line));
+  if (!sec_10 || !sec_60 || !sec_300) {
+    return false;
+  }
+  pressure = Oomd::ResourcePressure{*sec_10, *sec_60, *sec_300, std::nullopt};
+  return true;
+}
+
+// memory.{min,low,high,max} and memory.swap.max hold "max" or a number
+Oomd::SystemMaybe<int64_t> parseMinMaxLowHighLine(
+    std::string_view line,
+    size_t nr_lines) {
+  if (nr_lines != 1) {
+    return SYSTEM_ERROR(EINVAL);
+  }
+  if (line == "max") {
+    return std::numeric_limits<int64_t>::max();
+  }
+  auto val = parseNumber<int64_t>(line);
+  if (!val) {
+    return SYSTEM_ERROR(EINVAL);
+  }
+  return *val;
+}
+
+// memory.high.tmp holds "<max|number> <duration>"
+Oomd::SystemMaybe<int64_t> parseMemhightmpLine(
+    std::string_view line,
+    size_t nr_lines) {
+  if (nr_lines != 1) {
+    return SYSTEM_ERROR(ENOENT);
+  }
+  auto limit = nextToken(line);
+  auto duration = nextToken(line);
+  if (limit.empty() || duration.empty() || !nextToken(line).empty()) {
+    return SYSTEM_ERROR(EINVAL);
+  }
+  if (limit == "max") {
+    return std::numeric_limits<int64_t>::max();
+  }
+  auto val = parseNumber<int64_t>(limit);
+  if (!val) {
+    return SYSTEM_ERROR(EINVAL);
+  }
+  return *val;
+}
+
+// Consumes the leading "<major>:<minor>" token of an io.stat line
+bool parseIostatDev(std::string_view& line, dev_t& dev) {
+  auto tok = nextToken(line);
+  auto major = parseNumber<unsigned int>(nextToken(tok, ':'));
+  auto minor = parseNumber<unsigned int>(nextToken(tok, ':'));
+  if (!major || !minor || !tok.empty()) {
+    return false;
+  }
+  dev = makedev(*major, *minor);
+  return true;
+}
+
+// rbytes=0 wbytes=0 rios=0 wios=0 dbytes=0 dios=0
+bool parseIostatCounters(std::string_view line, Oomd::DeviceIOStat& stat) {
+  return parseKeyValue(nextToken(line), "rbytes", stat.rbytes) &&
+      parseKeyValue(nextToken(line), "wbytes", stat.wbytes) &&
+      parseKeyValue(nextToken(line), "rios", stat.rios) &&
+      parseKeyValue(nextToken(line), "wios", stat.wios) &&
+      parseKeyValue(nextToken(line), "dbytes", stat.dbytes) &&
+      parseKeyValue(nextToken(line), "dios", stat.dios);
+}
+
 }; // namespace
 
 namespace Oomd {
 
 SystemMaybe<Fs::Fd>
 Fs::Fd::openat(const DirFd& dirfd, const std::string& path, bool read_only) {
+  return openat(dirfd, path.c_str(), read_only);
+}
+
+SystemMaybe<Fs::Fd>
+Fs::Fd::openat(const DirFd& dirfd, const char* path, bool read_only) {
   int flags = read_only ? O_RDONLY : O_WRONLY;
-  const auto fd = ::openat(dirfd.fd(), path.c_str(), flags);
+  const auto fd = ::openat(dirfd.fd(), path, flags);
   if (fd == -1) {
     return SYSTEM_ERROR(errno);
   }
@@ -121,78 +429,193 @@ bool Fs::isCgroupValid(const DirFd& dirfd) {
   return ::faccessat(dirfd.fd(), kControllersFile, F_OK, 0) == 0;
 }
 
-SystemMaybe<Fs::DirEnts> Fs::readDirFromDIR(DIR* d, int flags) {
-  Fs::DirEnts de;
+namespace {
+// Overwrites slot @param n of @param v, reusing the string already there
+void setEntry(std::vector<std::string>& v, size_t n, const char* name) {
+  if (n < v.size()) {
+    v[n].assign(name);
+  } else {
+    v.emplace_back(name);
+  }
+}
+} // namespace
 
-  while (struct dirent* dir = ::readdir(d)) {
-    if (dir->d_name[0] == '.') {
-      continue;
-    }
+SystemMaybe<Fs::DirEnts> Fs::readDirAt(const DirFd& dirfd, int flags) {
+  DirEnts de;
+  auto ret = readDirAt(dirfd, flags, de);
+  if (!ret) {
+    return SYSTEM_ERROR(ret.error());
+  }
+  return de;
+}
 
-    /*
-     * Optimisation: Avoid doing lstat calls if kernfs gives us back d_type.
-     * This actually can be pretty useful, since avoiding lstat()ing everything
-     * can reduce oomd CPU usage by ~10% on a reasonably sized cgroup
-     * hierarchy.
-     */
-    if ((flags & DirEntFlags::DE_FILE) && dir->d_type == DT_REG) {
-      de.files.push_back(dir->d_name);
-      continue;
-    }
-    if ((flags & DirEntFlags::DE_DIR) && dir->d_type == DT_DIR) {
-      de.dirs.push_back(dir->d_name);
-      continue;
-    }
+SystemMaybe<Unit> Fs::readDirAt(const DirFd& dirfd, int flags, DirEnts& out) {
+  // The fd offset is shared with every other user of dirfd, so always start
+  // from the top and leave it there
+  if (::lseek(dirfd.fd(), 0, SEEK_SET) == -1) {
+    return SYSTEM_ERROR(errno);
+  }
+  OOMD_SCOPE_EXIT {
+    ::lseek(dirfd.fd(), 0, SEEK_SET);
+  };
 
-    struct stat buf;
-    int ret = ::fstatat(dirfd(d), dir->d_name, &buf, AT_SYMLINK_NOFOLLOW);
-    if (ret == -1) {
+  size_t ndirs = 0;
+  size_t nfiles = 0;
+  auto& buf = direntBuffer();
+  while (true) {
+    auto n = ::syscall(SYS_getdents64, dirfd.fd(), buf.data(), buf.size());
+    if (n == -1) {
       return SYSTEM_ERROR(errno);
+    } else if (n == 0) {
+      break;
     }
 
-    if ((flags & DirEntFlags::DE_FILE) && (buf.st_mode & S_IFREG)) {
-      de.files.push_back(dir->d_name);
-    }
-    if ((flags & DirEntFlags::DE_DIR) && (buf.st_mode & S_IFDIR)) {
-      de.files.push_back(dir->d_name);
+    for (long pos = 0; pos < n;) {
+      const auto* dir = reinterpret_cast<LinuxDirent64*>(buf.data() + pos);
+      pos += dir->d_reclen;
+      if (dir->d_name[0] == '.') {
+        continue;
+      }
+
+      /*
+       * Optimisation: Avoid doing lstat calls if kernfs gives us back d_type.
+       * This actually can be pretty useful, since avoiding lstat()ing
+       * everything can reduce oomd CPU usage by ~10% on a reasonably sized
+       * cgroup hierarchy.
+       */
+      auto type = dir->d_type;
+      if (type == DT_UNKNOWN) {
+        struct stat stat_buf;
+        int ret = ::fstatat(
+            dirfd.fd(), dir->d_name, &stat_buf, AT_SYMLINK_NOFOLLOW);
+        if (ret == -1) {
+          return SYSTEM_ERROR(errno);
+        }
+        if (S_ISREG(stat_buf.st_mode)) {
+          type = DT_REG;
+        } else if (S_ISDIR(stat_buf.st_mode)) {
+          type = DT_DIR;
+        }
+      }
+
+      if ((flags & DirEntFlags::DE_FILE) && type == DT_REG) {
+        setEntry(out.files, nfiles++, dir->d_name);
+      } else if ((flags & DirEntFlags::DE_DIR) && type == DT_DIR) {
+        setEntry(out.dirs, ndirs++, dir->d_name);
+      }
     }
   }
 
-  return de;
+  out.dirs.resize(ndirs);
+  out.files.resize(nfiles);
+  return noSystemError();
 }
 
-SystemMaybe<Fs::DirEnts> Fs::readDirAt(const DirFd& dirfd, int flags) {
-  // once an fd is passed to fdopendir, it is unusable except through that DIR
-  int fresh_fd = ::dup(dirfd.fd());
-
-  DIR* d = ::fdopendir(fresh_fd);
-  if (!d) {
-    auto e = errno;
-    ::close(fresh_fd);
-    return SYSTEM_ERROR(e);
+SystemMaybe<Fs::DirEnts> Fs::readDir(const std::string& path, int flags) {
+  auto dirfd = DirFd::open(path);
+  if (!dirfd) {
+    return SYSTEM_ERROR(dirfd.error());
   }
+  return readDirAt(*dirfd, flags);
+}
 
-  OOMD_SCOPE_EXIT {
-    // even though we dup()ed dirfd.fd(), the copied fd shares state with
-    // dirfd.fd(). For dirfd to be reusable again, we need to rewind it, which
-    // we can do through d.
-    ::rewinddir(d);
+namespace {
+// Dirs may go away while we walk, which only drops them from the result.
+// Anything else, eg. running out of fds, fails the walk.
+bool wentAway(const std::system_error& err) {
+  auto code = err.code().value();
+  return code == ENOENT || code == ENOTDIR;
+}
 
-    ::closedir(d);
+/*
+ * Matches the components of a pattern after those in @param parts, below
+ * @param dirfd. Depth first, so only the dirs along the current path are
+ * open besides the matches.
+ */
+SystemMaybe<Unit> resolveComponentsAt(
+    const Fs::DirFd& dirfd,
+    const std::vector<std::string>& components,
+    std::vector<std::string>& parts,
+    const Fs::WantFd& want_fd,
+    std::vector<Fs::ResolvedDir>& out) {
+  const auto& component = components[parts.size()];
+  auto descend = [&](const std::string& name) -> SystemMaybe<Unit> {
+    auto fd = dirfd.openChildDir(name);
+    if (!fd) {
+      if (wentAway(fd.error())) {
+        return noSystemError();
+      }
+      return SYSTEM_ERROR(fd.error(), name);
+    }
+    parts.push_back(name);
+    auto ret = noSystemError();
+    if (parts.size() == components.size()) {
+      if (!want_fd || want_fd(parts)) {
+        out.push_back({parts, std::move(*fd)});
+      } else {
+        out.push_back({parts, std::nullopt});
+      }
+    } else {
+      ret = resolveComponentsAt(*fd, components, parts, want_fd, out);
+    }
+    parts.pop_back();
+    return ret;
   };
 
-  return Fs::readDirFromDIR(d, flags);
+  if (!hasWildcard(component)) {
+    return descend(component);
+  }
+  auto de = Fs::readDirAt(dirfd, Fs::DE_DIR);
+  if (!de) {
+    if (wentAway(de.error())) {
+      return noSystemError();
+    }
+    return SYSTEM_ERROR(de.error());
+  }
+  for (const auto& name : de->dirs) {
+    if (::fnmatch(component.c_str(), name.c_str(), FNM_PERIOD) == 0) {
+      if (auto ret = descend(name); !ret) {
+        return ret;
+      }
+    }
+  }
+  return noSystemError();
 }
+} // namespace
 
-SystemMaybe<Fs::DirEnts> Fs::readDir(const std::string& path, int flags) {
-  DIR* d = ::opendir(path.c_str());
-  if (!d) {
-    return SYSTEM_ERROR(errno);
+SystemMaybe<std::vector<Fs::ResolvedDir>> Fs::resolveDirPatternAt(
+    const DirFd& root,
+    const std::string& pattern,
+    const WantFd& want_fd) {
+  std::vector<std::string> patterns;
+  expandBraces(pattern, patterns);
+
+  std::vector<ResolvedDir> ret;
+  for (const auto& expanded : patterns) {
+    auto components = Util::split(expanded, '/');
+
+    // The root itself is borrowed and only reopened if the pattern is empty
+    if (components.empty()) {
+      if (want_fd && !want_fd({})) {
+        ret.push_back({{}, std::nullopt});
+        continue;
+      }
+      auto fd = root.openChildDir(".");
+      if (!fd) {
+        return SYSTEM_ERROR(fd.error());
+      }
+      ret.push_back({{}, std::move(*fd)});
+      continue;
+    }
+
+    std::vector<std::string> parts;
+    if (auto walked =
+            resolveComponentsAt(root, components, parts, want_fd, ret);
+        !walked) {
+      return SYSTEM_ERROR(walked.error());
+    }
   }
-  OOMD_SCOPE_EXIT {
-    ::closedir(d);
-  };
-  return readDirFromDIR(d, flags);
+  return ret;
 }
 
 bool Fs::isDir(const std::string& path) {
@@ -306,6 +729,38 @@ SystemMaybe<std::vector<std::string>> Fs::readFileByLine(Fd&& fd) {
   return v;
 }
 
+SystemMaybe<std::string_view> Fs::readFileAt(const Fd& fd) {
+  auto& buf = readBuffer();
+  size_t len = 0;
+  while (true) {
+    if (len == buf.size()) {
+      buf.resize(buf.size() * 2);
+    }
+    auto n = ::pread(fd.fd(), buf.data() + len, buf.size() - len, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return SYSTEM_ERROR(errno);
+    }
+    if (n == 0) {
+      break;
+    }
+    len += n;
+  }
+  return std::string_view(buf.data(), len);
+}
+
+SystemMaybe<std::string_view> Fs::readFileAt(
+    const DirFd& dirfd,
+    const char* name) {
+  auto fd = Fd::openat(dirfd, name);
+  if (!fd) {
+    return SYSTEM_ERROR(fd.error());
+  }
+  return readFileAt(*fd);
+}
+
 SystemMaybe<Unit> Fs::checkExistAt(const DirFd& dirfd, const char* name) {
   if (int rc = ::faccessat(dirfd.fd(), name, F_OK, 0); rc == 0) {
     return noSystemError();
@@ -316,36 +771,43 @@ SystemMaybe<Unit> Fs::checkExistAt(const DirFd& dirfd, const char* name) {
 
 SystemMaybe<std::vector<std::string>> Fs::readControllersAt(
     const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kControllersFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+  auto content = readFileAt(dirfd, kControllersFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
-  return Util::split((*lines)[0], ' ');
+  auto line = nextLine(*content);
+  std::vector<std::string> controllers;
+  for (auto tok = nextToken(line); !tok.empty(); tok = nextToken(line)) {
+    controllers.emplace_back(tok);
+  }
+  return controllers;
 }
 
 SystemMaybe<std::vector<int>> Fs::getPidsAt(const DirFd& dirfd) {
-  auto str_pids = readFileByLine(Fs::Fd::openat(dirfd, kProcsFile));
-  if (!str_pids) {
-    return SYSTEM_ERROR(str_pids.error());
+  auto content = readFileAt(dirfd, kProcsFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
   std::vector<int> pids;
-  for (const auto& sp : *str_pids) {
-    pids.push_back(std::stoi(sp));
+  while (!content->empty()) {
+    auto pid = parseNumber<int>(nextLine(*content));
+    if (!pid) {
+      return SYSTEM_ERROR(EINVAL);
+    }
+    pids.push_back(*pid);
   }
   return pids;
 }
 
-SystemMaybe<bool> Fs::readIsPopulatedAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kEventsFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
-  }
-  for (const auto& line : *lines) {
-    std::vector<std::string> toks = Util::split(line, ' ');
-    if (toks.size() == 2 && toks[0] == "populated") {
-      if (toks[1] == "1") {
+SystemMaybe<bool> Fs::parseIsPopulated(std::string_view content) {
+  while (!content.empty()) {
+    auto line = nextLine(content);
+    auto key = nextToken(line);
+    auto val = nextToken(line);
+    if (key == "populated" && !val.empty() && nextToken(line).empty()) {
+      if (val == "1") {
         return true;
-      } else if (toks[1] == "0") {
+      } else if (val == "0") {
         return false;
       } else {
         return SYSTEM_ERROR(EINVAL);
@@ -356,6 +818,14 @@ SystemMaybe<bool> Fs::readIsPopulatedAt(const DirFd& dirfd) {
   return SYSTEM_ERROR(EINVAL);
 }
 
+SystemMaybe<bool> Fs::readIsPopulatedAt(const DirFd& dirfd) {
+  auto content = readFileAt(dirfd, kEventsFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
+  }
+  return parseIsPopulated(*content);
+}
+
 std::string Fs::pressureTypeToString(PressureType type) {
   switch (type) {
     case PressureType::SOME:
@@ -369,71 +839,36 @@ std::string Fs::pressureTypeToString(PressureType type) {
 SystemMaybe<ResourcePressure> Fs::readRespressureFromLines(
     const std::vector<std::string>& lines,
     PressureType type) {
-  auto type_name = pressureTypeToString(type);
-  size_t pressure_line_index = 0;
-  switch (type) {
-    case PressureType::SOME:
-      pressure_line_index = 0;
-      break;
-    case PressureType::FULL:
-      pressure_line_index = 1;
-      break;
+  std::string content;
+  for (const auto& line : lines) {
+    content += line;
+    content += '\n';
   }
+  return parseRespressure(content, type);
+}
 
-  switch (getPsiFormat(lines)) {
-    case PsiFormat::UPSTREAM: {
-      // Upstream v4.16+ format
-      //
+SystemMaybe<PressureRecord> Fs::parsePressureRecord(std::string_view content) {
+  auto [lines, nr_lines] = firstLines<3>(content);
+  PressureRecord record;
+
+  switch (getPsiFormat(lines[0], nr_lines)) {
+    case PsiFormat::UPSTREAM:
       // some avg10=0.22 avg60=0.17 avg300=1.11 total=58761459
       // full avg10=0.22 avg60=0.16 avg300=1.08 total=58464525
-      std::vector<std::string> toks =
-          Util::split(lines[pressure_line_index], ' ');
-      if (toks[0] != type_name) {
-        return SYSTEM_ERROR(EINVAL);
-      }
-      std::vector<std::string> avg10 = Util::split(toks[1], '=');
-      if (avg10[0] != "avg10") {
+      if (!parseUpstreamPsiLine(lines[0], "some", record.some) ||
+          !parseUpstreamPsiLine(lines[1], "full", record.full)) {
         return SYSTEM_ERROR(EINVAL);
       }
-      std::vector<std::string> avg60 = Util::split(toks[2], '=');
-      if (avg60[0] != "avg60") {
-        return SYSTEM_ERROR(EINVAL);
-      }
-      std::vector<std::string> avg300 = Util::split(toks[3], '=');
-      if (avg300[0] != "avg300") {
-        return SYSTEM_ERROR(EINVAL);
-      }
-      std::vector<std::string> total = Util::split(toks[4], '=');
-      if (total[0] != "total") {
-        return SYSTEM_ERROR(EINVAL);
-      }
-
-      return ResourcePressure{
-          std::stof(avg10[1]),
-          std::stof(avg60[1]),
-          std::stof(avg300[1]),
-          std::chrono::microseconds(std::stoull(total[1])),
-      };
-    }
-    case PsiFormat::EXPERIMENTAL: {
-      // Old experimental format
-      //
+      return record;
+    case PsiFormat::EXPERIMENTAL:
       // aggr 316016073
       // some 0.00 0.03 0.05
       // full 0.00 0.03 0.05
-      std::vector<std::string> toks =
-          Util::split(lines[pressure_line_index + 1], ' ');
-      if (toks[0] != type_name) {
+      if (!parseExperimentalPsiLine(lines[1], "some", record.some) ||
+          !parseExperimentalPsiLine(lines[2], "full", record.full)) {
         return SYSTEM_ERROR(EINVAL);
       }
-
-      return ResourcePressure{
-          std::stof(toks[1]),
-          std::stof(toks[2]),
-          std::stof(toks[3]),
-          std::nullopt,
-      };
-    }
+      return record;
     case PsiFormat::MISSING:
       // Missing the control file
       return SYSTEM_ERROR(ENOENT);
@@ -443,6 +878,24 @@ SystemMaybe<ResourcePressure> Fs::readRespressureFromLines(
   __builtin_unreachable();
 }
 
+SystemMaybe<ResourcePressure> Fs::parseRespressure(
+    std::string_view content,
+    PressureType type) {
+  auto record = parsePressureRecord(content);
+  if (!record) {
+    return SYSTEM_ERROR(record.error());
+  }
+  return type == PressureType::SOME ? record->some : record->full;
+}
+
+SystemMaybe<int64_t> Fs::parseScalar(std::string_view content) {
+  auto val = parseNumber<int64_t>(nextLine(content));
+  if (!val) {
+    return SYSTEM_ERROR(EINVAL);
+  }
+  return *val;
+}
+
 SystemMaybe<int64_t> Fs::readRootMemcurrent() {
   auto meminfo = getMeminfo("/proc/meminfo");
   if (!meminfo) {
@@ -456,269 +909,431 @@ SystemMaybe<int64_t> Fs::readRootMemcurrent() {
 }
 
 SystemMaybe<int64_t> Fs::readMemcurrentAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemCurrentFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+  auto content = readFileAt(dirfd, kMemCurrentFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
-  return static_cast<int64_t>(std::stoll((*lines)[0]));
+  return parseScalar(*content);
 }
 
-SystemMaybe<ResourcePressure> Fs::readRootMempressure(PressureType type) {
-  auto lines = readFileByLine("/proc/pressure/memory");
-  if (!lines) {
-    lines = readFileByLine("/proc/mempressure");
+SystemMaybe<PressureRecord> Fs::readRootMempressureRecord() {
+  auto fd = Fd::open("/proc/pressure/memory");
+  if (!fd) {
+    fd = Fd::open("/proc/mempressure");
   }
 
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+  if (!fd) {
+    return SYSTEM_ERROR(fd.error());
+  }
+  auto content = readFileAt(*fd);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
-  return readRespressureFromLines(*lines, type);
+  return parsePressureRecord(*content);
+}
+
+SystemMaybe<ResourcePressure> Fs::readRootMempressure(PressureType type) {
+  auto record = readRootMempressureRecord();
+  if (!record) {
+    return SYSTEM_ERROR(record.error());
+  }
+  return type == PressureType::SOME ? record->some : record->full;
 }
 
 SystemMaybe<ResourcePressure> Fs::readMempressureAt(
     const DirFd& dirfd,
     PressureType type) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemPressureFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+  auto content = readFileAt(dirfd, kMemPressureFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
-  return readRespressureFromLines(*lines, type);
+  return parseRespressure(*content, type);
 }
 
 SystemMaybe<int64_t> Fs::readMinMaxLowHighFromLines(
     const std::vector<std::string>& lines) {
-  if (lines.size() != 1) {
-    return SYSTEM_ERROR(EINVAL);
-  }
-  if (lines[0] == "max") {
-    return std::numeric_limits<int64_t>::max();
+  return parseMinMaxLowHighLine(
+      lines.empty() ? std::string_view() : lines[0], lines.size());
+}
+
+SystemMaybe<int64_t> Fs::parseMinMaxLowHigh(std::string_view content) {
+  auto [lines, nr_lines] = firstLines<1>(content);
+  return parseMinMaxLowHighLine(lines[0], nr_lines);
+}
+
+SystemMaybe<int64_t> Fs::readMinMaxLowHighAt(
+    const DirFd& dirfd,
+    const char* name) {
+  auto content = readFileAt(dirfd, name);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
-  return static_cast<int64_t>(std::stoll(lines[0]));
+  return parseMinMaxLowHigh(*content);
 }
 
 SystemMaybe<int64_t> Fs::readMemlowAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemLowFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
-  }
-  auto ret = Fs::readMinMaxLowHighFromLines(*lines);
-  if (!ret) {
-    return SYSTEM_ERROR(ret.error());
-  }
-  return ret;
+  return readMinMaxLowHighAt(dirfd, kMemLowFile);
 }
 
 SystemMaybe<int64_t> Fs::readMemhighAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemHighFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
-  }
-  auto ret = Fs::readMinMaxLowHighFromLines(*lines);
-  if (!ret) {
-    return SYSTEM_ERROR(ret.error());
-  }
-  return ret;
+  return readMinMaxLowHighAt(dirfd, kMemHighFile);
 }
 
 SystemMaybe<int64_t> Fs::readMemmaxAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemMaxFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
-  }
-  auto ret = Fs::readMinMaxLowHighFromLines(*lines);
-  if (!ret) {
-    return SYSTEM_ERROR(ret.error());
-  }
-  return ret;
+  return readMinMaxLowHighAt(dirfd, kMemMaxFile);
 }
 
 SystemMaybe<int64_t> Fs::readMemhightmpFromLines(
     const std::vector<std::string>& lines) {
-  if (lines.size() != 1) {
-    return SYSTEM_ERROR(ENOENT);
-  }
-  auto tokens = Util::split(lines[0], ' ');
-  if (tokens.size() != 2) {
-    return SYSTEM_ERROR(EINVAL);
-  }
-  if (tokens[0] == "max") {
-    return std::numeric_limits<int64_t>::max();
-  }
-  return static_cast<int64_t>(std::stoll(tokens[0]));
+  return parseMemhightmpLine(
+      lines.empty() ? std::string_view() : lines[0], lines.size());
+}
+
+SystemMaybe<int64_t> Fs::parseMemhightmp(std::string_view content) {
+  auto [lines, nr_lines] = firstLines<1>(content);
+  return parseMemhightmpLine(lines[0], nr_lines);
 }
 
 SystemMaybe<int64_t> Fs::readMemhightmpAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemHighTmpFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+  auto content = readFileAt(dirfd, kMemHighTmpFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
-  auto ret = readMemhightmpFromLines(*lines);
-  if (!ret) {
-    return SYSTEM_ERROR(ret.error());
-  }
-  return ret;
+  return parseMemhightmp(*content);
 }
 
 SystemMaybe<int64_t> Fs::readMemminAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemMinFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
-  }
-  auto ret = Fs::readMinMaxLowHighFromLines(*lines);
-  if (!ret) {
-    return SYSTEM_ERROR(ret.error());
-  }
-  return ret;
+  return readMinMaxLowHighAt(dirfd, kMemMinFile);
 }
 
 SystemMaybe<int64_t> Fs::readSwapCurrentAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemSwapCurrentFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
-  }
   // The swap controller can be disabled via CONFIG_MEMCG_SWAP=n
-  return std::stoll((*lines)[0]);
+  auto content = readFileAt(dirfd, kMemSwapCurrentFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
+  }
+  return parseScalar(*content);
 }
 
 SystemMaybe<int64_t> Fs::readSwapMaxAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemSwapMaxFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
-  }
-  auto ret = Fs::readMinMaxLowHighFromLines(*lines);
-  if (!ret) {
-    return SYSTEM_ERROR(ret.error());
-  }
-  return ret;
+  return readMinMaxLowHighAt(dirfd, kMemSwapMaxFile);
 }
 
 SystemMaybe<std::unordered_map<std::string, int64_t>> Fs::getVmstat(
     const std::string& path) {
-  auto lines = readFileByLine(path);
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+  auto fd = Fd::open(path);
+  if (!fd) {
+    return SYSTEM_ERROR(fd.error());
+  }
+  auto content = readFileAt(*fd);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
   std::unordered_map<std::string, int64_t> map;
-  char space{' '};
 
-  for (auto& line : *lines) {
-    std::stringstream ss(line);
-    std::string item;
+  while (!content->empty()) {
+    auto line = nextLine(*content);
+    auto key = nextToken(line);
+    auto val = parseNumber<int64_t>(nextToken(line));
+    if (!val) {
+      return SYSTEM_ERROR(EINVAL, path);
+    }
+    map[std::string(key)] = *val;
+  }
+
+  return map;
+}
 
-    // get key
-    std::getline(ss, item, space);
-    std::string key{item};
+SystemMaybe<Vmstat> Fs::parseVmstat(
+    std::string_view content,
+    Vmstat::KeySet keys) {
+  Vmstat vmstat;
+  auto remaining = keys.count();
 
-    // insert value into map
-    std::getline(ss, item, space);
-    map[key] = static_cast<int64_t>(std::stoll(item));
+  while (remaining && !content.empty()) {
+    auto line = nextLine(content);
+    auto key = Vmstat::keyFromName(nextToken(line));
+    if (!key || !keys.test(static_cast<size_t>(*key))) {
+      continue;
+    }
+    auto val = parseNumber<int64_t>(nextToken(line));
+    if (!val) {
+      return SYSTEM_ERROR(EINVAL);
+    }
+    vmstat.set(*key, *val);
+    keys.reset(static_cast<size_t>(*key));
+    --remaining;
   }
 
-  return map;
+  return vmstat;
+}
+
+SystemMaybe<Vmstat> Fs::readVmstat(
+    Vmstat::KeySet keys,
+    const std::string& path) {
+  auto fd = Fd::open(path);
+  if (!fd) {
+    return SYSTEM_ERROR(fd.error());
+  }
+  auto content = readFileAt(*fd);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
+  }
+  auto vmstat = parseVmstat(*content, keys);
+  if (!vmstat) {
+    return SYSTEM_ERROR(vmstat.error(), path);
+  }
+  return vmstat;
 }
 
 SystemMaybe<std::unordered_map<std::string, int64_t>> Fs::getMeminfo(
     const std::string& path) {
-  char name[256] = {0};
-  uint64_t val;
+  auto fd = Fd::open(path);
+  if (!fd) {
+    return SYSTEM_ERROR(fd.error());
+  }
+  auto content = readFileAt(*fd);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
+  }
   std::unordered_map<std::string, int64_t> map;
 
-  auto lines = readFileByLine(path);
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
-  }
-  for (auto& line : *lines) {
-    int ret =
-        sscanf(line.c_str(), "%255[^:]:%*[ \t]%" SCNu64 "%*s\n", name, &val);
-    if (ret == 2) {
-      map[name] = val * 1024;
+  // MemTotal:       58575616 kB
+  while (!content->empty()) {
+    auto line = nextLine(*content);
+    auto colon = line.find(':');
+    if (colon == 0 || colon == std::string_view::npos) {
+      continue;
+    }
+    auto name = line.substr(0, colon);
+    auto rest = line.substr(colon + 1);
+    auto val_start = rest.find_first_not_of(" \t");
+    if (val_start == 0 || val_start == std::string_view::npos) {
+      continue;
+    }
+    rest.remove_prefix(val_start);
+    if (auto val = parseNumber<uint64_t>(nextToken(rest))) {
+      map[std::string(name)] = *val * 1024;
     }
   }
 
   return map;
 }
 
-std::unordered_map<std::string, int64_t> Fs::getMemstatLikeFromLines(
-    const std::vector<std::string>& lines) {
-  char name[256] = {0};
-  uint64_t val;
-  std::unordered_map<std::string, int64_t> map;
+SystemMaybe<Fs::SwapTotals> Fs::parseSwaps(std::string_view content) {
+  SwapTotals totals;
+
+  // Filename				Type		Size		Used		Priority
+  // /dev/dm-1                               partition	8388604		0		-2
+  //
+  // The kernel escapes whitespace in filenames, so plain tokenizing is safe
+  nextLine(content);
+  while (!content.empty()) {
+    auto line = nextLine(content);
+    if (nextField(line).empty()) {
+      continue;
+    }
+    nextField(line); // Type
+    auto size = parseNumber<uint64_t>(nextField(line));
+    auto used = parseNumber<uint64_t>(nextField(line));
+    if (!size || !used) {
+      return SYSTEM_ERROR(EINVAL);
+    }
+    // Values are in KB
+    totals.total += *size * 1024;
+    totals.used += *used * 1024;
+  }
 
-  for (const auto& line : lines) {
-    int ret = sscanf(line.c_str(), "%255s %" SCNu64 "\n", name, &val);
-    if (ret == 2) {
-      map[name] = val;
+  return totals;
+}
+
+SystemMaybe<Fs::SwapTotals> Fs::getSwaps(const std::string& path) {
+  auto fd = Fd::open(path);
+  if (!fd) {
+    return SYSTEM_ERROR(fd.error());
+  }
+  auto content = readFileAt(*fd);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
+  }
+  auto totals = parseSwaps(*content);
+  if (!totals) {
+    return SYSTEM_ERROR(totals.error(), path);
+  }
+  return totals;
+}
+
+SystemMaybe<MemoryStat> Fs::parseMemstat(std::string_view content) {
+  MemoryStat stat;
+  // The kernel prints keys in MemoryStat::Key order, so guess the next one
+  size_t hint = 0;
+
+  while (!content.empty()) {
+    auto line = nextLine(content);
+    auto name = nextToken(line);
+    auto val = parseNumber<uint64_t>(nextToken(line));
+    if (!val) {
+      continue;
+    }
+    if (auto key = MemoryStat::keyFromName(name, hint)) {
+      stat.set(*key, *val);
+      hint = static_cast<size_t>(*key) + 1;
+    } else {
+      stat.set(name, *val);
     }
   }
 
-  return map;
+  return stat;
 }
 
 SystemMaybe<std::unordered_map<std::string, int64_t>> Fs::getMemstatAt(
     const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemStatFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+  auto content = readFileAt(dirfd, kMemStatFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
 
-  return getMemstatLikeFromLines(lines.value());
+  auto stat = parseMemstat(*content);
+  if (!stat) {
+    return SYSTEM_ERROR(stat.error());
+  }
+  return stat->asMap();
+}
+
+SystemMaybe<PressureRecord> Fs::readRootIopressureRecord() {
+  auto fd = Fd::open("/proc/pressure/io");
+  if (!fd) {
+    return SYSTEM_ERROR(fd.error());
+  }
+  auto content = readFileAt(*fd);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
+  }
+  return parsePressureRecord(*content);
 }
 
 SystemMaybe<ResourcePressure> Fs::readRootIopressure(PressureType type) {
-  auto lines = readFileByLine("/proc/pressure/io");
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+  auto record = readRootIopressureRecord();
+  if (!record) {
+    return SYSTEM_ERROR(record.error());
   }
-  return readRespressureFromLines(*lines, type);
+  return type == PressureType::SOME ? record->some : record->full;
 }
 
 SystemMaybe<ResourcePressure> Fs::readIopressureAt(
     const DirFd& dirfd,
     PressureType type) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kIoPressureFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+  auto content = readFileAt(dirfd, kIoPressureFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
-  return readRespressureFromLines(*lines, type);
+  return parseRespressure(*content, type);
 }
 
-SystemMaybe<IOStat> Fs::readIostatAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kIoStatFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+SystemMaybe<Fs::Fd> Fs::openPressureTrigger(
+    const std::string& path,
+    const std::string& trigger) {
+  auto fd = Fd::open(path, false);
+  if (!fd) {
+    return SYSTEM_ERROR(fd.error());
+  }
+  // The kernel wants the terminating NUL too
+  if (Util::writeFull(fd->fd(), trigger.c_str(), trigger.size() + 1) < 0) {
+    return SYSTEM_ERROR(errno);
   }
+  return fd;
+}
+
+SystemMaybe<IOStat> Fs::parseIostat(std::string_view content) {
+  IOStat io_stat;
+  auto ret = parseIostat(content, io_stat);
+  if (!ret) {
+    return SYSTEM_ERROR(ret.error());
+  }
+  return io_stat;
+}
 
-  std::vector<DeviceIOStat> io_stat;
-  io_stat.reserve(lines->size());
-
-  for (const auto& line : *lines) {
-    // format
-    //
-    // 0:0 rbytes=0 wbytes=0 rios=0 wios=0 dbytes=0 dios=0
-    DeviceIOStat dev_io_stat;
-    int major, minor;
-    int ret = sscanf(
-        line.c_str(),
-        "%d:%d rbytes=%" SCNd64 " wbytes=%" SCNd64 " rios=%" SCNd64
-        " wios=%" SCNd64 " dbytes=%" SCNd64 " dios=%" SCNd64 "\n",
-        &major,
-        &minor,
-        &dev_io_stat.rbytes,
-        &dev_io_stat.wbytes,
-        &dev_io_stat.rios,
-        &dev_io_stat.wios,
-        &dev_io_stat.dbytes,
-        &dev_io_stat.dios);
-
-    if (ret != 8) {
+SystemMaybe<Unit> Fs::parseIostat(std::string_view content, IOStat& out) {
+  size_t n = 0;
+  while (!content.empty()) {
+    auto line = nextLine(content);
+    if (n == out.size()) {
+      out.emplace_back();
+    }
+    auto& dev_io_stat = out[n];
+    dev_t dev;
+    if (!parseIostatDev(line, dev) || !parseIostatCounters(line, dev_io_stat)) {
       return SYSTEM_ERROR(EINVAL);
     }
-    dev_io_stat.dev_id = std::to_string(major) + ":" + std::to_string(minor);
-    io_stat.push_back(dev_io_stat);
+    dev_io_stat.dev_id =
+        std::to_string(major(dev)) + ":" + std::to_string(minor(dev));
+    n++;
+  }
+  out.resize(n);
+  return noSystemError();
+}
+
+SystemMaybe<std::vector<BoundDeviceIOStat>> Fs::parseIostatFor(
+    std::string_view content,
+    const std::vector<IOCostDevice>& devs) {
+  std::vector<BoundDeviceIOStat> io_stat;
+  auto ret = parseIostatFor(content, devs, io_stat);
+  if (!ret) {
+    return SYSTEM_ERROR(ret.error());
   }
   return io_stat;
 }
 
+SystemMaybe<Unit> Fs::parseIostatFor(
+    std::string_view content,
+    const std::vector<IOCostDevice>& devs,
+    std::vector<BoundDeviceIOStat>& out) {
+  out.clear();
+  while (!content.empty()) {
+    auto line = nextLine(content);
+    dev_t dev;
+    if (!parseIostatDev(line, dev)) {
+      return SYSTEM_ERROR(EINVAL);
+    }
+    // Hosts usually care about a handful of devices at most
+    auto it = std::find_if(devs.begin(), devs.end(), [&](const auto& d) {
+      return d.dev == dev;
+    });
+    if (it == devs.end()) {
+      continue;
+    }
+    DeviceIOStat counters;
+    if (!parseIostatCounters(line, counters)) {
+      return SYSTEM_ERROR(EINVAL);
+    }
+    out.push_back(BoundDeviceIOStat{
+        .coeffs = it->coeffs,
+        .rbytes = counters.rbytes,
+        .wbytes = counters.wbytes,
+        .rios = counters.rios,
+        .wios = counters.wios,
+        .dbytes = counters.dbytes,
+        .dios = counters.dios});
+  }
+  return noSystemError();
+}
+
+std::optional<dev_t> Fs::parseDevId(std::string_view dev_id) {
+  dev_t dev;
+  if (!parseIostatDev(dev_id, dev) || !dev_id.empty()) {
+    return std::nullopt;
+  }
+  return dev;
+}
+
+SystemMaybe<IOStat> Fs::readIostatAt(const DirFd& dirfd) {
+  auto content = readFileAt(dirfd, kIoStatFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
+  }
+  return parseIostat(*content);
+}
+
 SystemMaybe<Unit> Fs::writeControlFileAt(
     SystemMaybe<Fd>&& fd,
     const std::string& content) {
@@ -766,62 +1381,89 @@ SystemMaybe<Unit> Fs::writeMemReclaimAt(const DirFd& dirfd, int64_t value) {
   return noSystemError();
 }
 
-SystemMaybe<int64_t> Fs::getNrDyingDescendantsAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kCgroupStatFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+SystemMaybe<int64_t> Fs::parseNrDyingDescendants(std::string_view content) {
+  while (!content.empty()) {
+    auto line = nextLine(content);
+    if (nextToken(line) == "nr_dying_descendants") {
+      if (auto val = parseNumber<int64_t>(nextToken(line))) {
+        return *val;
+      }
+    }
   }
-  auto map = getMemstatLikeFromLines(lines.value());
   // Will return 0 for missing entries
-  return map["nr_dying_descendants"];
+  return 0;
 }
 
-SystemMaybe<KillPreference> Fs::readKillPreferenceAt(const DirFd& path) {
-  auto maybe = Fs::hasxattrAt(path, kOomdSystemPreferXAttr);
-  if (!maybe) {
-    return SYSTEM_ERROR(maybe.error());
-  }
-
-  if (*maybe) {
-    return KillPreference::PREFER;
+SystemMaybe<int64_t> Fs::getNrDyingDescendantsAt(const DirFd& dirfd) {
+  auto content = readFileAt(dirfd, kCgroupStatFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
+  return parseNrDyingDescendants(*content);
+}
 
-  maybe = Fs::hasxattrAt(path, kOomdUserPreferXAttr);
-  if (!maybe) {
-    return SYSTEM_ERROR(maybe.error());
+KillPreference Fs::parseKillPreference(std::string_view xattr_names) {
+  bool prefer = false;
+  bool avoid = false;
+  // flistxattr() output is a sequence of NUL terminated names
+  while (!xattr_names.empty()) {
+    auto name = nextToken(xattr_names, '\0');
+    if (name == kOomdSystemPreferXAttr || name == kOomdUserPreferXAttr) {
+      prefer = true;
+    } else if (name == kOomdSystemAvoidXAttr || name == kOomdUserAvoidXAttr) {
+      avoid = true;
+    }
   }
 
-  if (*maybe) {
+  // Prefer wins over avoid if both are set
+  if (prefer) {
     return KillPreference::PREFER;
-  }
-
-  maybe = Fs::hasxattrAt(path, kOomdSystemAvoidXAttr);
-  if (!maybe) {
-    return SYSTEM_ERROR(maybe.error());
-  }
-
-  if (*maybe) {
+  } else if (avoid) {
     return KillPreference::AVOID;
   }
+  return KillPreference::NORMAL;
+}
 
-  maybe = Fs::hasxattrAt(path, kOomdUserAvoidXAttr);
-  if (!maybe) {
-    return SYSTEM_ERROR(maybe.error());
+SystemMaybe<KillPreference> Fs::readKillPreferenceAt(const DirFd& path) {
+  // cgroups rarely carry more than a couple of xattrs
+  std::array<char, 1024> buf;
+  auto size = ::flistxattr(path.fd(), buf.data(), buf.size());
+  if (size >= 0) {
+    return parseKillPreference(std::string_view(buf.data(), size));
+  } else if (errno == EOPNOTSUPP) {
+    return KillPreference::NORMAL;
+  } else if (errno != ERANGE) {
+    return SYSTEM_ERROR(errno);
   }
 
-  if (*maybe) {
-    return KillPreference::AVOID;
+  // Didn't fit, ask for the size and retry. The list can grow in between.
+  std::vector<char> big_buf;
+  do {
+    size = ::flistxattr(path.fd(), nullptr, 0);
+    if (size < 0) {
+      return SYSTEM_ERROR(errno);
+    }
+    big_buf.resize(size);
+    size = ::flistxattr(path.fd(), big_buf.data(), big_buf.size());
+  } while (size < 0 && errno == ERANGE);
+
+  if (size < 0) {
+    return SYSTEM_ERROR(errno);
   }
+  return parseKillPreference(std::string_view(big_buf.data(), size));
+}
 
-  return KillPreference::NORMAL;
+SystemMaybe<bool> Fs::parseMemoryOomGroup(std::string_view content) {
+  auto [lines, nr_lines] = firstLines<1>(content);
+  return nr_lines == 1 && lines[0] == "1";
 }
 
 SystemMaybe<bool> Fs::readMemoryOomGroupAt(const DirFd& dirfd) {
-  auto lines = readFileByLine(Fs::Fd::openat(dirfd, kMemOomGroupFile));
-  if (!lines) {
-    return SYSTEM_ERROR(lines.error());
+  auto content = readFileAt(dirfd, kMemOomGroupFile);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
-  return *lines == std::vector<std::string>({"1"});
+  return parseMemoryOomGroup(*content);
 }
 
 SystemMaybe<Unit> Fs::setxattr(
@@ -931,14 +1573,20 @@ SystemMaybe<DeviceType> Fs::getDeviceType(
 }
 
 SystemMaybe<int> Fs::getSwappiness(const std::string& path) {
-  auto str_swappiness = readFileByLine(Fd::open(path));
-  if (!str_swappiness) {
-    return SYSTEM_ERROR(str_swappiness.error());
+  auto fd = Fd::open(path);
+  if (!fd) {
+    return SYSTEM_ERROR(fd.error());
+  }
+  auto content = readFileAt(*fd);
+  if (!content) {
+    return SYSTEM_ERROR(content.error());
   }
-  if (str_swappiness->size() != 1) {
+  auto [lines, nr_lines] = firstLines<1>(*content);
+  auto swappiness = parseNumber<int>(lines[0]);
+  if (nr_lines != 1 || !swappiness) {
     return SYSTEM_ERROR(EINVAL, path, " malformed");
   }
-  return std::stoi((*str_swappiness)[0]);
+  return *swappiness;
 }
 
 SystemMaybe<Unit> Fs::setSwappiness(int swappiness, const std::string& path) {
@@ -20,13 +20,18 @@
 #include <dirent.h>
 #include <sys/types.h>
 #include <exception>
+#include <functional>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "oomd/include/MemoryStat.h"
 #include "oomd/include/Types.h"
+#include "oomd/include/Vmstat.h"
 #include "oomd/util/SystemMaybe.h"
 
 namespace Oomd {
@@ -64,6 +69,12 @@ class Fs {
     std::vector<std::string> files;
   };
 
+  // Sum over every swap device in /proc/swaps, in bytes
+  struct SwapTotals {
+    uint64_t total{0};
+    uint64_t used{0};
+  };
+
   enum DirEntFlags {
     DE_FILE = 1,
     DE_DIR = (1 << 1),
@@ -83,6 +94,8 @@ class Fs {
    public:
     static SystemMaybe<Fd>
     openat(const DirFd& dirfd, const std::string& path, bool read_only = true);
+    static SystemMaybe<Fd>
+    openat(const DirFd& dirfd, const char* path, bool read_only = true);
     // Not safe for accessing cgroup control files. Use Openat instead.
     static SystemMaybe<Fd> open(const std::string& path, bool read_only = true);
 
@@ -94,8 +107,11 @@ class Fs {
     }
     Fd& operator=(const Fd& other) = delete;
     Fd& operator=(Fd&& other) {
-      fd_ = other.fd_;
-      other.fd_ = -1;
+      if (this != &other) {
+        this->close();
+        fd_ = other.fd_;
+        other.fd_ = -1;
+      }
       return *this;
     }
     ~Fd() {
@@ -145,9 +161,44 @@ class Fs {
   static SystemMaybe<DirEnts> readDir(const std::string& path, int flags);
 
   /*
-   * Like readDir, but takes a DirFd
+   * Like readDir, but takes a DirFd. Entries are read with getdents64() into
+   * a per-thread buffer, and @param dirfd is left rewound.
    */
   static SystemMaybe<DirEnts> readDirAt(const DirFd& dirfd, int flags);
+  // Same, but refills @param out in place, reusing its strings
+  static SystemMaybe<Unit>
+  readDirAt(const DirFd& dirfd, int flags, DirEnts& out);
+
+  // A directory matching a pattern passed to resolveDirPatternAt()
+  struct ResolvedDir {
+    // Path components relative to the root of the walk
+    std::vector<std::string> parts;
+    // Unset if the caller didn't want it kept open
+    std::optional<DirFd> fd;
+  };
+
+  // Given the parts of a match, whether resolveDirPatternAt() should return
+  // it opened
+  using WantFd = std::function<bool(const std::vector<std::string>&)>;
+
+  /*
+   * Resolves @param pattern, a '/' separated path relative to @param root, to
+   * the directories matching it. Components may use the wildcards of glob(7)
+   * and {a,b} braces. Components without wildcards are opened directly, and
+   * only the others list their parent. Unlike glob(), the matching dirs are
+   * returned already opened. The walk is depth first, so dirs leading up to a
+   * match are closed as soon as they're done with.
+   *
+   * If @param want_fd is given, matches it returns false for are closed as
+   * soon as they're found, so callers only hold fds they will use.
+   *
+   * Dirs removed during the walk are skipped. Any other error, eg. EMFILE,
+   * fails the whole walk.
+   */
+  static SystemMaybe<std::vector<ResolvedDir>> resolveDirPatternAt(
+      const DirFd& root,
+      const std::string& pattern,
+      const WantFd& want_fd = nullptr);
 
   /*
    * Checks if @param path is a directory
@@ -190,8 +241,54 @@ class Fs {
     return SYSTEM_ERROR(fd.error());
   }
 
+  /*
+   * Reads the whole file behind @param fd with pread(2) starting at offset 0
+   * into a thread local buffer and returns a view of the content. The view is
+   * only valid until the next readFileAt() call on the same thread.
+   *
+   * No heap allocation is done unless the file is larger than any file read
+   * before on this thread, so this is the preferred way to read control files
+   * on the hot path.
+   */
+  static SystemMaybe<std::string_view> readFileAt(const Fd& fd);
+  /*
+   * Same as above, but opens @param name under @param dirfd and closes it
+   * once read
+   */
+  static SystemMaybe<std::string_view> readFileAt(
+      const DirFd& dirfd,
+      const char* name);
+
   static SystemMaybe<Unit> checkExistAt(const DirFd& dirfd, const char* name);
 
+  /*
+   * Parsers for control file content as returned by readFileAt(). Each of
+   * the read*At() helpers below is readFileAt() followed by one of these, so
+   * callers holding on to control file fds can skip the open.
+   */
+  static SystemMaybe<int64_t> parseScalar(std::string_view content);
+  static SystemMaybe<int64_t> parseMinMaxLowHigh(std::string_view content);
+  static SystemMaybe<int64_t> parseMemhightmp(std::string_view content);
+  static SystemMaybe<PressureRecord> parsePressureRecord(
+      std::string_view content);
+  static SystemMaybe<ResourcePressure> parseRespressure(
+      std::string_view content,
+      PressureType type = PressureType::FULL);
+  static SystemMaybe<MemoryStat> parseMemstat(std::string_view content);
+  static SystemMaybe<IOStat> parseIostat(std::string_view content);
+  static SystemMaybe<Unit> parseIostat(std::string_view content, IOStat& out);
+  // Parses io.stat, keeping only devices in @param devs
+  static SystemMaybe<std::vector<BoundDeviceIOStat>> parseIostatFor(
+      std::string_view content,
+      const std::vector<IOCostDevice>& devs);
+  static SystemMaybe<Unit> parseIostatFor(
+      std::string_view content,
+      const std::vector<IOCostDevice>& devs,
+      std::vector<BoundDeviceIOStat>& out);
+  static SystemMaybe<int64_t> parseNrDyingDescendants(std::string_view content);
+  static SystemMaybe<bool> parseIsPopulated(std::string_view content);
+  static SystemMaybe<bool> parseMemoryOomGroup(std::string_view content);
+
   static SystemMaybe<std::vector<std::string>> readControllersAt(
       const DirFd& dirfd);
   static SystemMaybe<std::vector<int>> getPidsAt(const DirFd& dirfd);
@@ -204,6 +301,7 @@ class Fs {
       PressureType type = PressureType::FULL);
   static SystemMaybe<int64_t> readRootMemcurrent();
   static SystemMaybe<int64_t> readMemcurrentAt(const DirFd& dirfd);
+  static SystemMaybe<PressureRecord> readRootMempressureRecord();
   static SystemMaybe<ResourcePressure> readRootMempressure(
       PressureType type = PressureType::FULL);
   static SystemMaybe<ResourcePressure> readMempressureAt(
@@ -220,12 +318,22 @@ class Fs {
   static SystemMaybe<int64_t> readMemminAt(const DirFd& dirfd);
   static SystemMaybe<int64_t> readSwapCurrentAt(const DirFd& dirfd);
   static SystemMaybe<int64_t> readSwapMaxAt(const DirFd& dirfd);
+  static SystemMaybe<PressureRecord> readRootIopressureRecord();
   static SystemMaybe<ResourcePressure> readRootIopressure(
       PressureType type = PressureType::FULL);
   static SystemMaybe<ResourcePressure> readIopressureAt(
       const DirFd& dirfd,
       PressureType type = PressureType::FULL);
 
+  /*
+   * Arms PSI trigger @param trigger, eg. "full 150000 1000000", on pressure
+   * file @param path. The trigger lasts as long as the returned fd, which
+   * polls POLLPRI whenever it fires.
+   */
+  static SystemMaybe<Fd> openPressureTrigger(
+      const std::string& path,
+      const std::string& trigger);
+
   static SystemMaybe<Unit> writeMemhighAt(const DirFd& dirfd, int64_t value);
   static SystemMaybe<Unit> writeMemhightmpAt(
       const DirFd& dirfd,
@@ -234,16 +342,29 @@ class Fs {
   static SystemMaybe<Unit> writeMemReclaimAt(const DirFd& dirfd, int64_t value);
 
   static SystemMaybe<int64_t> getNrDyingDescendantsAt(const DirFd& dirfd);
+  // Kill preference from a flistxattr() name list
+  static KillPreference parseKillPreference(std::string_view xattr_names);
   static SystemMaybe<KillPreference> readKillPreferenceAt(const DirFd& path);
   static SystemMaybe<bool> readMemoryOomGroupAt(const DirFd& dirfd);
   static SystemMaybe<IOStat> readIostatAt(const DirFd& dirfd);
 
   static SystemMaybe<std::unordered_map<std::string, int64_t>> getVmstat(
       const std::string& path = "/proc/vmstat");
+  // Extracts only @param keys, stopping as soon as all of them are found
+  static SystemMaybe<Vmstat> parseVmstat(
+      std::string_view content,
+      Vmstat::KeySet keys);
+  static SystemMaybe<Vmstat> readVmstat(
+      Vmstat::KeySet keys,
+      const std::string& path = "/proc/vmstat");
 
   static SystemMaybe<std::unordered_map<std::string, int64_t>> getMeminfo(
       const std::string& path = "/proc/meminfo");
 
+  static SystemMaybe<SwapTotals> parseSwaps(std::string_view content);
+  static SystemMaybe<SwapTotals> getSwaps(
+      const std::string& path = "/proc/swaps");
+
   static SystemMaybe<std::unordered_map<std::string, int64_t>> getMemstatAt(
       const DirFd& dirfd);
 
@@ -269,6 +390,9 @@ class Fs {
       const DirFd& dirfd,
       const std::string& attr);
 
+  // Packs a device id in <major>:<minor> format into a dev_t
+  static std::optional<dev_t> parseDevId(std::string_view dev_id);
+
   // Return if device is SSD or HDD given its id in <major>:<minor> format
   static SystemMaybe<DeviceType> getDeviceType(
       const std::string& dev_id,
@@ -283,12 +407,12 @@ class Fs {
       const std::string& path = "/proc/sys/vm/swappiness");
 
  private:
-  static std::unordered_map<std::string, int64_t> getMemstatLikeFromLines(
-      const std::vector<std::string>& lines);
+  static SystemMaybe<int64_t> readMinMaxLowHighAt(
+      const DirFd& dirfd,
+      const char* name);
   static SystemMaybe<Unit> writeControlFileAt(
       SystemMaybe<Fd>&& fd,
       const std::string& content);
-  static SystemMaybe<DirEnts> readDirFromDIR(DIR* dir, int flags);
 };
 
 } // namespace Oomd
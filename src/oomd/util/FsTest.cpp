@@ -15,6 +15,13 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
 #include <optional>
 #include <utility>
 #include <vector>
@@ -29,6 +36,28 @@
 using namespace Oomd;
 using namespace testing;
 
+namespace {
+// Number of heap allocations made by this binary so far
+std::atomic<size_t> allocations{0};
+} // namespace
+
+void* operator new(size_t size) {
+  allocations++;
+  if (void* p = std::malloc(size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+// noinline keeps GCC from flagging free() on memory from operator new
+[[gnu::noinline]] void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
 class FsTest : public ::testing::Test {
  protected:
   void SetUp() override {
@@ -63,6 +92,20 @@ TEST_F(FsTest, FindDirectories) {
   EXPECT_THAT(de.dirs, Not(Contains(std::string("dir22"))));
 }
 
+TEST_F(FsTest, ReadDirAt) {
+  auto dirfd = ASSERT_SYS_OK(Fs::DirFd::open(fixture_.fsDataDir()));
+  auto de = ASSERT_SYS_OK(Fs::readDirAt(dirfd, Fs::DE_DIR | Fs::DE_FILE));
+  EXPECT_THAT(
+      de.dirs, UnorderedElementsAre("dir1", "dir2", "dir3", "wildcard"));
+  EXPECT_THAT(
+      de.files, UnorderedElementsAre("file1", "file2", "file3", "file4"));
+
+  // The fd is rewound, so reading it again sees everything again
+  auto de2 = ASSERT_SYS_OK(Fs::readDirAt(dirfd, Fs::DE_DIR));
+  EXPECT_THAT(de2.dirs, UnorderedElementsAreArray(de.dirs));
+  EXPECT_TRUE(de2.files.empty());
+}
+
 TEST_F(FsTest, IsDir) {
   auto dir = fixture_.fsDataDir();
   EXPECT_TRUE(Fs::isDir(dir + "/dir1"));
@@ -135,6 +178,98 @@ TEST_F(FsTest, Glob) {
   ASSERT_EQ(resolved.size(), 0);
 }
 
+TEST_F(FsTest, ResolveDirPatternAt) {
+  auto root = ASSERT_SYS_OK(Fs::DirFd::open(fixture_.fsDataDir()));
+  auto resolve = [&](const std::string& pattern) {
+    std::vector<std::string> paths;
+    auto dirs = Fs::resolveDirPatternAt(root, pattern);
+    if (!dirs) {
+      ADD_FAILURE() << pattern << ": " << dirs.error().what();
+      return paths;
+    }
+    for (const auto& dir : *dirs) {
+      std::string path;
+      for (const auto& part : dir.parts) {
+        path += (path.empty() ? "" : "/") + part;
+      }
+      // Returned fds are opened on the matching dir
+      auto expected = Fs::DirFd::open(fixture_.fsDataDir() + "/" + path);
+      EXPECT_TRUE(expected && dir.fd && dir.fd->inode());
+      if (expected && dir.fd && dir.fd->inode()) {
+        EXPECT_EQ(*dir.fd->inode(), *expected->inode()) << path;
+      }
+      paths.push_back(std::move(path));
+    }
+    return paths;
+  };
+
+  EXPECT_THAT(
+      resolve("wildcard/dir*"),
+      UnorderedElementsAre("wildcard/dir1", "wildcard/dir2"));
+  // Files never match
+  EXPECT_THAT(
+      resolve("/wildcard/*/"),
+      UnorderedElementsAre(
+          "wildcard/dir1", "wildcard/dir2", "wildcard/different_dir"));
+  EXPECT_THAT(
+      resolve("*/dir?"),
+      UnorderedElementsAre("wildcard/dir1", "wildcard/dir2"));
+  EXPECT_THAT(
+      resolve("{dir1,wildcard/diff*}"),
+      UnorderedElementsAre("dir1", "wildcard/different_dir"));
+  EXPECT_THAT(resolve("dir[23]"), UnorderedElementsAre("dir2", "dir3"));
+  EXPECT_THAT(resolve("dir1"), ElementsAre("dir1"));
+  EXPECT_THAT(resolve(""), ElementsAre(""));
+  EXPECT_THAT(resolve("file1"), IsEmpty());
+  EXPECT_THAT(resolve("not/a/valid/dir"), IsEmpty());
+  EXPECT_THAT(resolve("wildcard/nothing*"), IsEmpty());
+}
+
+/*
+ * Verify matches the caller doesn't want an fd for are still returned, but
+ * closed.
+ */
+TEST_F(FsTest, ResolveDirPatternAtWantFd) {
+  auto root = ASSERT_SYS_OK(Fs::DirFd::open(fixture_.fsDataDir()));
+  auto dirs = ASSERT_SYS_OK(Fs::resolveDirPatternAt(
+      root, "wildcard/dir*", [](const std::vector<std::string>& parts) {
+        return parts.back() == "dir1";
+      }));
+
+  ASSERT_EQ(dirs.size(), 2);
+  for (const auto& dir : dirs) {
+    ASSERT_EQ(dir.parts.size(), 2);
+    EXPECT_EQ(dir.fd.has_value(), dir.parts[1] == "dir1") << dir.parts[1];
+  }
+  dirs = ASSERT_SYS_OK(
+      Fs::resolveDirPatternAt(root, "", [](const auto&) { return false; }));
+  ASSERT_EQ(dirs.size(), 1);
+  EXPECT_FALSE(dirs[0].fd);
+}
+
+/*
+ * Verify only dirs that went away are skipped, and other errors fail the walk
+ * rather than silently dropping matches.
+ */
+TEST_F(FsTest, ResolveDirPatternAtError) {
+  auto root = ASSERT_SYS_OK(Fs::DirFd::open(fixture_.fsDataDir()));
+  // fds are allocated lowest first, so with the limit right above the lowest
+  // free one, the walk can open "wildcard" but none of its children
+  int lowest = ::open("/", O_RDONLY | O_CLOEXEC);
+  ASSERT_GE(lowest, 0);
+  ::close(lowest);
+  struct rlimit old_limit;
+  ASSERT_EQ(::getrlimit(RLIMIT_NOFILE, &old_limit), 0);
+  struct rlimit limit = old_limit;
+  limit.rlim_cur = lowest + 1;
+  ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &limit), 0);
+  auto dirs = Fs::resolveDirPatternAt(root, "wildcard/dir*");
+  ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &old_limit), 0);
+
+  ASSERT_FALSE(dirs);
+  EXPECT_EQ(dirs.error().code().value(), EMFILE);
+}
+
 TEST_F(FsTest, ReadFile) {
   auto file = fixture_.fsDataDir() + "/dir1/stuff";
   auto lines = ASSERT_SYS_OK(Fs::readFileByLine(file));
@@ -257,6 +392,38 @@ TEST_F(FsTest, ReadSwapMax) {
   EXPECT_EQ(swap_max, 12345);
 }
 
+TEST_F(FsTest, ScalarReadsDontAllocate) {
+  auto path = fixture_.cgroupDataDir();
+  auto dir = ASSERT_SYS_OK(Fs::DirFd::open(path));
+  // Warm up the thread local read buffer
+  ASSERT_SYS_OK(Fs::readMemcurrentAt(dir));
+
+  auto before = allocations.load();
+  auto memcurrent = Fs::readMemcurrentAt(dir);
+  auto memlow = Fs::readMemlowAt(dir);
+  auto memmin = Fs::readMemminAt(dir);
+  auto memhigh = Fs::readMemhighAt(dir);
+  auto memmax = Fs::readMemmaxAt(dir);
+  auto memhightmp = Fs::readMemhightmpAt(dir);
+  auto swap_current = Fs::readSwapCurrentAt(dir);
+  auto swap_max = Fs::readSwapMaxAt(dir);
+  auto nr_dying = Fs::getNrDyingDescendantsAt(dir);
+  auto pressure = Fs::readMempressureAt(dir);
+  auto after = allocations.load();
+
+  EXPECT_EQ(after - before, 0);
+  EXPECT_EQ(ASSERT_SYS_OK(memcurrent), 987654321);
+  EXPECT_EQ(ASSERT_SYS_OK(memlow), 333333);
+  EXPECT_EQ(ASSERT_SYS_OK(memmin), 666);
+  EXPECT_EQ(ASSERT_SYS_OK(memhigh), 1000);
+  EXPECT_EQ(ASSERT_SYS_OK(memmax), 654);
+  EXPECT_EQ(ASSERT_SYS_OK(memhightmp), 2000);
+  EXPECT_EQ(ASSERT_SYS_OK(swap_current), 321321);
+  EXPECT_EQ(ASSERT_SYS_OK(swap_max), 12345);
+  EXPECT_EQ(ASSERT_SYS_OK(nr_dying), 27);
+  EXPECT_FLOAT_EQ(ASSERT_SYS_OK(pressure).sec_10, 4.44);
+}
+
 TEST_F(FsTest, ReadControllers) {
   auto path = fixture_.cgroupDataDir();
   auto dir = ASSERT_SYS_OK(Fs::DirFd::open(path));
@@ -321,6 +488,48 @@ TEST_F(FsTest, ReadMemoryPressureSome) {
   EXPECT_FLOAT_EQ(pressure2.sec_300, 3.33);
 }
 
+TEST_F(FsTest, ParsePressureRecord) {
+  // v4.16+ upstream format
+  auto path = fixture_.cgroupDataDir();
+  auto dir = ASSERT_SYS_OK(Fs::DirFd::open(path));
+  auto content = ASSERT_SYS_OK(Fs::readFileAt(dir, "memory.pressure"));
+  auto record = ASSERT_SYS_OK(Fs::parsePressureRecord(content));
+
+  EXPECT_FLOAT_EQ(record.some.sec_10, 1.11);
+  EXPECT_FLOAT_EQ(record.some.sec_60, 2.22);
+  EXPECT_FLOAT_EQ(record.some.sec_300, 3.33);
+  EXPECT_EQ(record.some.total, std::chrono::microseconds(134829384400));
+  EXPECT_FLOAT_EQ(record.full.sec_10, 4.44);
+  EXPECT_FLOAT_EQ(record.full.sec_60, 5.55);
+  EXPECT_FLOAT_EQ(record.full.sec_300, 6.66);
+  EXPECT_EQ(record.full.total, std::chrono::microseconds(128544748770));
+
+  // old experimental format w/ debug info on
+  auto dir3 = ASSERT_SYS_OK(Fs::DirFd::open(path + "/service3.service"));
+  auto content3 = ASSERT_SYS_OK(Fs::readFileAt(dir3, "memory.pressure"));
+  auto record3 = ASSERT_SYS_OK(Fs::parsePressureRecord(content3));
+
+  EXPECT_FLOAT_EQ(record3.some.sec_10, 1.11);
+  EXPECT_FLOAT_EQ(record3.some.sec_300, 3.33);
+  EXPECT_FLOAT_EQ(record3.full.sec_10, 4.44);
+  EXPECT_FLOAT_EQ(record3.full.sec_300, 6.66);
+  EXPECT_EQ(record3.full.total, std::nullopt);
+
+  EXPECT_FLOAT_EQ(
+      ASSERT_SYS_OK(Fs::parsePressureRecord(
+                        "some avg10=0 avg60=10.5 avg300=0.125 total=1\n"
+                        "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n"))
+          .some.sec_300,
+      0.125);
+  EXPECT_FALSE(Fs::parsePressureRecord(""));
+  EXPECT_FALSE(Fs::parsePressureRecord(
+      "some avg10=1.x avg60=0.00 avg300=0.00 total=0\n"
+      "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n"));
+  EXPECT_FALSE(Fs::parsePressureRecord(
+      "some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n"
+      "full avg10=0.00 avg60=0.00\n"));
+}
+
 TEST_F(FsTest, GetVmstat) {
   auto vmstatfile = fixture_.fsVmstatFile();
   auto vmstat = ASSERT_SYS_OK(Fs::getVmstat(vmstatfile));
@@ -333,6 +542,59 @@ TEST_F(FsTest, GetVmstat) {
   EXPECT_EQ(vmstat["asdf"], 0);
 }
 
+TEST_F(FsTest, ParseVmstat) {
+  constexpr auto kContent =
+      "nr_free_pages 123\n"
+      "pswpin 10\n"
+      "pswpout 20\n"
+      "pgscan_kswapd 30\n"
+      "pgscan_direct 40\n"
+      "oom_kill 2\n";
+
+  Vmstat::KeySet keys;
+  keys.set(static_cast<size_t>(Vmstat::Key::PSWPOUT));
+  keys.set(static_cast<size_t>(Vmstat::Key::PGSCAN_DIRECT));
+  auto vmstat = ASSERT_SYS_OK(Fs::parseVmstat(kContent, keys));
+  EXPECT_EQ(vmstat.get(Vmstat::Key::PSWPOUT), 20);
+  EXPECT_EQ(vmstat.get(Vmstat::Key::PGSCAN_DIRECT), 40);
+  // Not asked for
+  EXPECT_EQ(vmstat.get(Vmstat::Key::PSWPIN), std::nullopt);
+  EXPECT_EQ(vmstat.get(Vmstat::Key::OOM_KILL), std::nullopt);
+
+  EXPECT_TRUE(ASSERT_SYS_OK(Fs::parseVmstat(kContent, {})).empty());
+  // Malformed lines are only an error if we care about them
+  keys.set(static_cast<size_t>(Vmstat::Key::PGMAJFAULT));
+  EXPECT_TRUE(Fs::parseVmstat("nr_free_pages x\npswpout 1\n", keys));
+  EXPECT_FALSE(Fs::parseVmstat("pswpout x\n", keys));
+
+  Vmstat prev;
+  prev.set(Vmstat::Key::PSWPOUT, 10);
+  EXPECT_EQ(
+      vmstat.rate(prev, Vmstat::Key::PSWPOUT, std::chrono::seconds(5)), 2.0);
+  EXPECT_EQ(
+      vmstat.rate(prev, Vmstat::Key::PGSCAN_DIRECT, std::chrono::seconds(5)),
+      std::nullopt);
+  EXPECT_DOUBLE_EQ(Vmstat::ewma(100, 200, 0.75), 125);
+}
+
+TEST_F(FsTest, ParseSwaps) {
+  auto swaps = ASSERT_SYS_OK(Fs::parseSwaps(
+      "Filename\t\t\t\tType\t\tSize\t\tUsed\t\tPriority\n"
+      "/dev/dm-1                partition\t8388604\t\t1024\t\t-2\n"
+      "/swap\\040file            file\t\t1024\t\t0\t\t-3\n"));
+  EXPECT_EQ(swaps.total, (8388604ULL + 1024) * 1024);
+  EXPECT_EQ(swaps.used, 1024 * 1024);
+
+  auto none = ASSERT_SYS_OK(
+      Fs::parseSwaps("Filename\t\t\t\tType\t\tSize\t\tUsed\t\tPriority\n"));
+  EXPECT_EQ(none.total, 0);
+  EXPECT_EQ(none.used, 0);
+
+  EXPECT_FALSE(Fs::parseSwaps(
+      "Filename\t\t\t\tType\t\tSize\t\tUsed\t\tPriority\n"
+      "/dev/dm-1\tpartition\n"));
+}
+
 TEST_F(FsTest, GetMeminfo) {
   auto meminfofile = fixture_.fsMeminfoFile();
   auto meminfo = ASSERT_SYS_OK(Fs::getMeminfo(meminfofile));
@@ -360,6 +622,47 @@ TEST_F(FsTest, GetMemstat) {
   EXPECT_EQ(meminfo["asdf"], 0);
 }
 
+TEST_F(FsTest, ParseMemstat) {
+  auto stat = ASSERT_SYS_OK(Fs::parseMemstat(
+      "anon 1294168064\n"
+      "file 3870687232\n"
+      "some_future_key 42\n"
+      "pgscan 5\n"
+      "bogus_value x\n"));
+
+  EXPECT_EQ(stat.size(), 4);
+  EXPECT_EQ(stat.get(MemoryStat::Key::ANON), 1294168064);
+  EXPECT_EQ(stat.get(MemoryStat::Key::FILE), 3870687232);
+  EXPECT_EQ(stat.get(MemoryStat::Key::PGSCAN), 5);
+  EXPECT_EQ(stat.get(MemoryStat::Key::ACTIVE_ANON), std::nullopt);
+  EXPECT_EQ(stat.get("pgscan"), 5);
+  EXPECT_EQ(stat.get("some_future_key"), 42);
+  EXPECT_EQ(stat.get("bogus_value"), std::nullopt);
+
+  EXPECT_EQ(
+      stat,
+      MemoryStat(
+          {{"some_future_key", 42},
+           {"pgscan", 5},
+           {"file", 3870687232},
+           {"anon", 1294168064}}));
+  EXPECT_NE(stat, MemoryStat({{"anon", 1294168064}}));
+  EXPECT_EQ(
+      stat.asMap(),
+      (std::unordered_map<std::string, int64_t>{
+          {"anon", 1294168064},
+          {"file", 3870687232},
+          {"some_future_key", 42},
+          {"pgscan", 5}}));
+
+  // Older kernel layout, keys not in MemoryStat::Key order
+  auto dir = ASSERT_SYS_OK(Fs::DirFd::open(fixture_.cgroupDataDir()));
+  auto content = ASSERT_SYS_OK(Fs::readFileAt(dir, "memory.stat"));
+  auto fixture_stat = ASSERT_SYS_OK(Fs::parseMemstat(content));
+  EXPECT_EQ(fixture_stat.size(), 29);
+  EXPECT_EQ(fixture_stat.get(MemoryStat::Key::PGLAZYFREE), 0);
+}
+
 TEST_F(FsTest, ReadIoPressure) {
   auto path = fixture_.cgroupDataDir();
   auto dir = ASSERT_SYS_OK(Fs::DirFd::open(path));
@@ -393,6 +696,31 @@ TEST_F(FsTest, ReadMemoryOomGroup) {
   EXPECT_EQ(oom_group2, false);
 }
 
+TEST_F(FsTest, ParseKillPreference) {
+  using namespace std::literals;
+  EXPECT_EQ(Fs::parseKillPreference(""), KillPreference::NORMAL);
+  EXPECT_EQ(
+      Fs::parseKillPreference("user.foo\0trusted.bar\0"sv),
+      KillPreference::NORMAL);
+  EXPECT_EQ(
+      Fs::parseKillPreference("user.foo\0user.oomd_avoid\0"sv),
+      KillPreference::AVOID);
+  EXPECT_EQ(
+      Fs::parseKillPreference("trusted.oomd_prefer\0"sv),
+      KillPreference::PREFER);
+  // Prefer wins regardless of order
+  EXPECT_EQ(
+      Fs::parseKillPreference("user.oomd_prefer\0trusted.oomd_avoid\0"sv),
+      KillPreference::PREFER);
+  EXPECT_EQ(
+      Fs::parseKillPreference("trusted.oomd_avoid\0user.oomd_prefer\0"sv),
+      KillPreference::PREFER);
+  // Prefix of a known name doesn't count
+  EXPECT_EQ(
+      Fs::parseKillPreference("user.oomd_prefer_not\0"sv),
+      KillPreference::NORMAL);
+}
+
 TEST_F(FsTest, IsUnderParentPath) {
   EXPECT_TRUE(Fs::isUnderParentPath("/sys/fs/cgroup/", "/sys/fs/cgroup/"));
   EXPECT_TRUE(Fs::isUnderParentPath("/sys/fs/cgroup/", "/sys/fs/cgroup/blkio"));
@@ -448,6 +776,81 @@ TEST_F(FsTest, ReadIostat) {
   EXPECT_EQ(stat1.dios, 7);
 }
 
+TEST_F(FsTest, ParseIostatFor) {
+  EXPECT_EQ(Fs::parseDevId("1:11"), makedev(1, 11));
+  EXPECT_EQ(Fs::parseDevId("259:0"), makedev(259, 0));
+  EXPECT_EQ(Fs::parseDevId("1"), std::nullopt);
+  EXPECT_EQ(Fs::parseDevId("1:x"), std::nullopt);
+  EXPECT_EQ(Fs::parseDevId("1:11 "), std::nullopt);
+  EXPECT_EQ(Fs::parseDevId("1:11:2"), std::nullopt);
+
+  auto path = fixture_.cgroupDataDir();
+  auto dir = ASSERT_SYS_OK(Fs::DirFd::open(path));
+  auto content = ASSERT_SYS_OK(Fs::readFileAt(dir, "io.stat"));
+
+  std::vector<IOCostDevice> devs = {
+      {.dev = makedev(1, 11), .coeffs = {.read_iops = 2}},
+      {.dev = makedev(8, 0), .coeffs = {.read_iops = 3}}};
+  auto io_stat = ASSERT_SYS_OK(Fs::parseIostatFor(content, devs));
+  ASSERT_EQ(io_stat.size(), 1);
+  EXPECT_EQ(io_stat[0].coeffs.read_iops, 2);
+  EXPECT_EQ(io_stat[0].rbytes, 2222222);
+  EXPECT_EQ(io_stat[0].wbytes, 3333333);
+  EXPECT_EQ(io_stat[0].rios, 44);
+  EXPECT_EQ(io_stat[0].wios, 55);
+  EXPECT_EQ(io_stat[0].dbytes, 6666666666);
+  EXPECT_EQ(io_stat[0].dios, 7);
+
+  EXPECT_TRUE(ASSERT_SYS_OK(Fs::parseIostatFor(content, {})).empty());
+  EXPECT_FALSE(Fs::parseIostatFor("1:11 rbytes=1\n", devs));
+}
+
+TEST_F(FsTest, RefillsDontAllocate) {
+  auto fs_dir = ASSERT_SYS_OK(Fs::DirFd::open(fixture_.fsDataDir()));
+  auto cgroup_dir = ASSERT_SYS_OK(Fs::DirFd::open(fixture_.cgroupDataDir()));
+  auto content = std::string(
+      ASSERT_SYS_OK(Fs::readFileAt(cgroup_dir, Fs::kIoStatFile)));
+  std::vector<IOCostDevice> devs = {{.dev = makedev(1, 11), .coeffs = {}}};
+
+  Fs::DirEnts de;
+  IOStat io_stat;
+  std::vector<BoundDeviceIOStat> io_cost_stat;
+  ASSERT_SYS_OK(Fs::readDirAt(fs_dir, Fs::DE_DIR | Fs::DE_FILE, de));
+  ASSERT_SYS_OK(Fs::parseIostat(content, io_stat));
+  ASSERT_SYS_OK(Fs::parseIostatFor(content, devs, io_cost_stat));
+
+  // Second time around everything fits in what the first one allocated
+  auto before = allocations.load();
+  auto de_ret = Fs::readDirAt(fs_dir, Fs::DE_DIR | Fs::DE_FILE, de);
+  auto io_stat_ret = Fs::parseIostat(content, io_stat);
+  auto io_cost_stat_ret = Fs::parseIostatFor(content, devs, io_cost_stat);
+  auto after = allocations.load();
+
+  EXPECT_EQ(after - before, 0);
+  ASSERT_SYS_OK(de_ret);
+  ASSERT_SYS_OK(io_stat_ret);
+  ASSERT_SYS_OK(io_cost_stat_ret);
+  EXPECT_THAT(
+      de.dirs, UnorderedElementsAre("dir1", "dir2", "dir3", "wildcard"));
+  EXPECT_THAT(
+      de.files, UnorderedElementsAre("file1", "file2", "file3", "file4"));
+  ASSERT_EQ(io_stat.size(), 2);
+  EXPECT_EQ(io_stat[1].dev_id, "1:11");
+  EXPECT_EQ(io_stat[1].rbytes, 2222222);
+  ASSERT_EQ(io_cost_stat.size(), 1);
+  EXPECT_EQ(io_cost_stat[0].rbytes, 2222222);
+
+  // Shorter listings drop the stale tail
+  ASSERT_SYS_OK(Fs::readDirAt(fs_dir, Fs::DE_DIR, de));
+  EXPECT_EQ(de.dirs.size(), 4);
+  EXPECT_TRUE(de.files.empty());
+  ASSERT_SYS_OK(Fs::parseIostat(
+      "1:10 rbytes=1 wbytes=2 rios=3 wios=4 dbytes=5 dios=6\n", io_stat));
+  ASSERT_EQ(io_stat.size(), 1);
+  EXPECT_EQ(io_stat[0].dev_id, "1:10");
+  EXPECT_EQ(io_stat[0].dios, 6);
+}
+
 TEST_F(FsTest, WriteMemoryHigh) {
   using F = Fixture;
   auto path = fixture_.cgroupDataDir() + "/write_test";
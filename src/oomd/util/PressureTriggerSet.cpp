@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "oomd/util/PressureTriggerSet.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+#include <vector>
+
+#include "oomd/Log.h"
+#include "oomd/util/Util.h"
+
+namespace Oomd {
+
+void PressureTriggerSet::update(const std::set<Trigger>& wanted) {
+  for (auto it = armed_.begin(); it != armed_.end();) {
+    it = wanted.count(it->first) ? std::next(it) : armed_.erase(it);
+  }
+
+  std::set<Trigger> failed;
+  for (const auto& trigger : wanted) {
+    if (armed_.count(trigger)) {
+      continue;
+    }
+    auto fd = Fs::openPressureTrigger(trigger.first, trigger.second);
+    if (fd) {
+      armed_.emplace(trigger, std::move(*fd));
+      continue;
+    }
+    if (!failed_.count(trigger)) {
+      OLOG << "Could not arm pressure trigger \"" << trigger.second << "\" on "
+           << trigger.first << ": " << fd.error().what();
+    }
+    failed.insert(trigger);
+  }
+  failed_ = std::move(failed);
+}
+
+std::set<PressureTriggerSet::Trigger> PressureTriggerSet::wait(
+    std::chrono::steady_clock::time_point deadline) {
+  std::vector<pollfd> fds;
+  std::vector<Trigger> triggers;
+  for (const auto& [trigger, fd] : armed_) {
+    fds.push_back(pollfd{.fd = fd.fd(), .events = events_, .revents = 0});
+    triggers.push_back(trigger);
+  }
+
+  while (true) {
+    auto timeout = std::chrono::ceil<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    auto ret = ::poll(
+        fds.data(), fds.size(), std::max<int64_t>(timeout.count(), 0));
+    if (ret == 0) {
+      return {};
+    }
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      OLOG << "Waiting for pressure triggers failed: " << Util::strerror_r();
+      /* sleep override */
+      std::this_thread::sleep_until(deadline);
+      return {};
+    }
+
+    std::set<Trigger> fired;
+    for (size_t i = 0; i < fds.size(); ++i) {
+      // Removed cgroups report POLLERR along with POLLPRI, so errors go first
+      // and leave the trigger to be rearmed by the next update
+      if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+        // Negative fds are skipped by poll()
+        fds[i].fd = -1;
+        armed_.erase(triggers[i]);
+      } else if (fds[i].revents & events_) {
+        fired.insert(triggers[i]);
+      }
+    }
+    if (fired.size()) {
+      return fired;
+    }
+  }
+}
+
+} // namespace Oomd
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#pragma once
+
+#include <poll.h>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "oomd/util/Fs.h"
+
+namespace Oomd {
+
+/*
+ * PSI triggers armed on pressure files, and waiting for any of them to fire.
+ * A trigger is identified by the path of its file and its trigger line.
+ */
+class PressureTriggerSet {
+ public:
+  using Trigger = std::pair<std::string, std::string>;
+
+  /*
+   * @param events is what poll() reports fired triggers with. Tests pass
+   * POLLIN, which plain files always report, to fake one firing.
+   */
+  explicit PressureTriggerSet(short events = POLLPRI) : events_(events) {}
+
+  /*
+   * Arms what's in @param wanted but not armed yet, and disarms what's armed
+   * but no longer wanted. Triggers failing to arm are logged once, then
+   * retried on every update.
+   */
+  void update(const std::set<Trigger>& wanted);
+
+  size_t size() const {
+    return armed_.size();
+  }
+
+  /*
+   * Waits until @param deadline, or until an armed trigger fires.
+   *
+   * @returns the triggers that fired, none on timeout. Triggers whose file
+   * went away, eg. with its cgroup, are disarmed rather than fired, and
+   * rearmed by the next update() that still wants them.
+   */
+  std::set<Trigger> wait(std::chrono::steady_clock::time_point deadline);
+
+ private:
+  // Test only
+  friend class TestHelper;
+
+
+  short events_;
+  std::map<Trigger, Fs::Fd> armed_;
+  std::set<Trigger> failed_;
+};
+
+} // namespace Oomd
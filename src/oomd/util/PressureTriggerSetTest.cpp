@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2018-present, Facebook, Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <string>
+
+#include "oomd/util/Fixture.h"
+#include "oomd/util/PressureTriggerSet.h"
+#include "oomd/util/TestHelper.h"
+
+using namespace Oomd;
+using namespace std::chrono_literals;
+
+/*
+ * Pressure files are faked with plain files on the temp dir's filesystem.
+ * They take trigger writes, but never poll POLLPRI.
+ */
+class PressureTriggerSetTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    tempdir_ = Fixture::mkdtempChecked();
+    Fixture::materialize(Fixture::makeDir(
+        tempdir_,
+        {Fixture::makeFile("memory.pressure"),
+         Fixture::makeFile("io.pressure")}));
+    mem_ = tempdir_ + "/memory.pressure";
+    io_ = tempdir_ + "/io.pressure";
+  }
+
+  void TearDown() override {
+    Fixture::rmrChecked(tempdir_);
+  }
+
+  static std::string read(const std::string& path) {
+    std::ifstream f(path);
+    return std::string(
+        std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+  }
+
+  std::string tempdir_;
+  std::string mem_;
+  std::string io_;
+};
+
+TEST_F(PressureTriggerSetTest, Update) {
+  PressureTriggerSet triggers;
+  triggers.update(
+      {{mem_, "full 100000 1000000"},
+       {io_, "full 500000 1000000"},
+       {tempdir_ + "/missing/memory.pressure", "full 100000 1000000"}});
+  EXPECT_EQ(triggers.size(), 2);
+  // Trigger lines are written with their NUL
+  EXPECT_EQ(read(mem_), std::string("full 100000 1000000", 20));
+
+  triggers.update({{mem_, "full 100000 1000000"}});
+  EXPECT_EQ(triggers.size(), 1);
+  triggers.update({});
+  EXPECT_EQ(triggers.size(), 0);
+}
+
+TEST_F(PressureTriggerSetTest, WaitTimesOut) {
+  PressureTriggerSet triggers;
+  triggers.update({{mem_, "full 100000 1000000"}});
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(triggers.wait(start + 50ms).empty());
+  EXPECT_GE(std::chrono::steady_clock::now() - start, 50ms);
+
+  // Nothing armed is a plain sleep
+  triggers.update({});
+  start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(triggers.wait(start + 50ms).empty());
+  EXPECT_GE(std::chrono::steady_clock::now() - start, 50ms);
+}
+
+TEST_F(PressureTriggerSetTest, WaitFires) {
+  // Plain files always poll POLLIN
+  PressureTriggerSet triggers(POLLIN);
+  triggers.update(
+      {{mem_, "full 100000 1000000"}, {io_, "full 500000 1000000"}});
+
+  auto start = std::chrono::steady_clock::now();
+  std::set<PressureTriggerSet::Trigger> expected = {
+      {mem_, "full 100000 1000000"}, {io_, "full 500000 1000000"}};
+  EXPECT_EQ(triggers.wait(start + 10s), expected);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+/*
+ * The pressure file of a removed cgroup polls POLLERR along with POLLPRI.
+ * Fake that with a pipe whose reader is gone, which polls POLLERR along with
+ * POLLOUT.
+ */
+TEST_F(PressureTriggerSetTest, CgroupRecreated) {
+  PressureTriggerSet triggers(POLLIN | POLLOUT);
+  const PressureTriggerSet::Trigger mem = {mem_, "full 100000 1000000"};
+  const PressureTriggerSet::Trigger io = {io_, "full 500000 1000000"};
+  triggers.update({mem, io});
+  ASSERT_EQ(triggers.size(), 2);
+
+  Fixture::rmrChecked(mem_);
+  int pipefd[2];
+  ASSERT_EQ(::pipe(pipefd), 0);
+  ::close(pipefd[0]);
+  TestHelper::getArmedFd(triggers, mem) = Fs::Fd(pipefd[1]);
+
+  // The dead trigger is disarmed, not fired
+  std::set<PressureTriggerSet::Trigger> expected = {io};
+  EXPECT_EQ(triggers.wait(std::chrono::steady_clock::now() + 10s), expected);
+  EXPECT_EQ(triggers.size(), 1);
+
+  // And rearmed once its cgroup is back
+  Fixture::materialize(
+      Fixture::makeDir(tempdir_, {Fixture::makeFile("memory.pressure")}));
+  triggers.update({mem, io});
+  EXPECT_EQ(triggers.size(), 2);
+  EXPECT_EQ(read(mem_), std::string("full 100000 1000000", 20));
+}
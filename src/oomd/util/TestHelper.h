@@ -18,6 +18,7 @@
 #pragma once
 
 #include "oomd/CgroupContext.h"
+#include "oomd/Oomd.h"
 #include "oomd/OomdContext.h"
 #include "oomd/PluginRegistry.h"
 #include "oomd/engine/BasePlugin.h"
@@ -44,11 +45,37 @@ namespace Oomd {
  */
 class TestHelper {
  public:
-  using CgroupData = CgroupContext::CgroupData;
+  /*
+   * Unpacked CgroupContext::CgroupData, so tests can spell out the fields
+   * they set with designated initializers, in OOMD_CGROUP_DATA_FIELDS order.
+   */
+#define OOMD_TEST_FIELD(type, name, ...) std::optional<type> name;
+  struct CgroupData {
+    OOMD_CGROUP_DATA_FIELDS(OOMD_TEST_FIELD, OOMD_TEST_FIELD)
+  };
+#undef OOMD_TEST_FIELD
   using CgroupArchivedData = CgroupContext::CgroupArchivedData;
+  static constexpr size_t kCgroupDataBytes =
+      sizeof(CgroupContext::CgroupData);
+  // Whether the cold fields of @param cgroup_ctx have been allocated
+  static bool hasColdData(const CgroupContext& cgroup_ctx) {
+    return cgroup_ctx.data_->cold != nullptr;
+  }
 
-  static CgroupData& getDataRef(const CgroupContext& cgroup_ctx) {
-    return *cgroup_ctx.data_;
+  // Copy of what @param cgroup_ctx has read so far, without reading more
+  static CgroupData getData(const CgroupContext& cgroup_ctx) {
+    const auto& packed = *cgroup_ctx.data_;
+    CgroupData data;
+#define OOMD_TEST_GET_SCALAR(type, name, field) \
+  data.name = packed.get(packed.name);
+#define OOMD_TEST_GET_COLD(type, name) \
+  if (packed.cold) {                   \
+    data.name = packed.cold->name;     \
+  }
+    OOMD_CGROUP_DATA_FIELDS(OOMD_TEST_GET_SCALAR, OOMD_TEST_GET_COLD)
+#undef OOMD_TEST_GET_SCALAR
+#undef OOMD_TEST_GET_COLD
+    return data;
   }
 
   static std::unordered_map<CgroupPath, CgroupContext>& getCgroupsRef(
@@ -56,6 +83,43 @@ class TestHelper {
     return ctx.cgroups_;
   }
 
+  static size_t getControlFdsInUse(const OomdContext& ctx) {
+    return ctx.control_fds_in_use_.value;
+  }
+
+  // Inotify watches taken, not counting references
+  static size_t getCgroupWatchCount(const OomdContext& ctx) {
+    return ctx.cgroup_watches_.size();
+  }
+
+  static const void* getPrefetchPool(const OomdContext& ctx) {
+    return ctx.prefetch_pool_.get();
+  }
+
+  static OomdContext& getContext(Oomd& oomd) {
+    return oomd.ctx_;
+  }
+
+  static PressureTriggerSet& getPressureTriggers(Oomd& oomd) {
+    return oomd.pressure_triggers_;
+  }
+
+  static Fs::Fd& getArmedFd(
+      PressureTriggerSet& triggers,
+      const PressureTriggerSet::Trigger& trigger) {
+    return triggers.armed_.at(trigger);
+  }
+
+  // One pass of Oomd::run() each
+  static void runInterval(Oomd& oomd) {
+    oomd.runInterval();
+  }
+  static void runTriggered(
+      Oomd& oomd,
+      const std::set<PressureTriggerSet::Trigger>& fired) {
+    oomd.runTriggered(fired);
+  }
+
   /*
    * Set the cgroup data of a CgroupContext in OomdContext.
    * This is a shortcut for setting up CgroupContext without creating control
@@ -70,14 +134,32 @@ class TestHelper {
       const std::optional<CgroupArchivedData>& archive = std::nullopt) {
     auto cgroup_ctx = CgroupContext::make(ctx, cgroup);
     if (cgroup_ctx.has_value()) {
-      auto& cached_ctx =
-          ctx.cgroups_.emplace(cgroup, std::move(*cgroup_ctx)).first->second;
-      *cached_ctx.data_ = data;
+      auto& cached_ctx = ctx.insertCgroup(std::move(*cgroup_ctx));
+      setData(*cached_ctx.data_, data);
       if (archive) {
         cached_ctx.archive_ = *archive;
       }
     }
   }
+
+ private:
+  static void setData(
+      CgroupContext::CgroupData& packed,
+      const CgroupData& data) {
+    packed = CgroupContext::CgroupData{};
+    // Unset scalars are left to be read
+#define OOMD_TEST_SET_SCALAR(type, name, field) \
+  if (data.name) {                              \
+    packed.set(packed.name, data.name);         \
+  }
+#define OOMD_TEST_SET_COLD(type, name) \
+  if (data.name) {                     \
+    packed.getCold().name = data.name; \
+  }
+    OOMD_CGROUP_DATA_FIELDS(OOMD_TEST_SET_SCALAR, OOMD_TEST_SET_COLD)
+#undef OOMD_TEST_SET_SCALAR
+#undef OOMD_TEST_SET_COLD
+  }
 };
 
 /*